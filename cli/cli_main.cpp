@@ -24,6 +24,7 @@ freely, subject to the following restrictions:
 #include <stdio.h>
 #include <signal.h>
 #include <string.h>
+#include <stdlib.h>
 #ifdef _WIN32
 #include <winsock2.h>
 #else
@@ -39,6 +40,13 @@ struct termios oldt;
 using namespace AngelCommunication;
 
 Persona user, bot, bot2;
+PersonaStore store;
+ReplayLog inputLog; // what the user typed and the bots' think turns, for --replay
+#define THINK_SECONDS 0.05 // time bots can spend on messages before checking for key presses again
+
+float thinkSeconds = THINK_SECONDS;
+ThinkScheduler scheduler;
+unsigned int botWeights[2] = { 1, 1 };
 
 void ANGELC_PrintMessage( const AngelCommunication::Conversation *con, const AngelCommunication::Persona *speaker, const char *message ) {
 	if ( !strncmp( message, "/me", 3 ) && ( message[3] == ' ' || message[3] == '\0' ) ) {
@@ -102,7 +110,126 @@ bool charAvailable( float waitInSeconds ) {
 	return 0;
 }
 
+// Repeat a log from --log. With the same seed, data, and config the bots
+// process the same messages in the same turns, so they give the same replies.
+bool replayLog( Conversation &room, const char *filename ) {
+	ReplayLog in;
+	String event, fields;
+
+	if ( !in.open( filename, false ) ) {
+		printf( "WARNING: Failed to open %s\n", filename );
+		return false;
+	}
+
+	while ( in.read( event, fields ) ) {
+		if ( event == "say" ) {
+			room.addMessage( &user, fields );
+		} else if ( event == "nick" ) {
+			user.tryNick( fields );
+		} else if ( event == "think" ) {
+			if ( !ReplayLog::ReplayThink( scheduler, fields ) ) {
+				printf( "WARNING: %s:%u: bad think event\n", filename, in.getLineNum() );
+			}
+		} else if ( event == "reload" ) {
+			printf( "WARNING: %s:%u: the data or config was reloaded, replies after this may be different\n", filename, in.getLineNum() );
+		} else {
+			printf( "WARNING: %s:%u: unknown event %s\n", filename, in.getLineNum(), event.c_str() );
+		}
+	}
+
+	return true;
+}
+
+/*
+	Read [cli] and the first two [bot name] sections from a config file, other
+	sections are for the IRC client. Names are only set at start up, after
+	that only think_seconds and the bots' inbox are changed. Nothing is
+	changed if there are any errors.
+*/
+bool loadConfig( const char *filename, bool startup, bool &twoBots ) {
+	static const char *cliKeys[] = { "think_seconds", NULL };
+	static const char *botKeys[] = { "fullname", "gender", "weight", "inbox_size", "inbox_policy", NULL };
+
+	Config config;
+	float newThinkSeconds = thinkSeconds;
+	const ConfigSection *botSections[2];
+	String fullNames[2];
+	int genders[2], weights[2], inboxSizes[2], inboxPolicies[2];
+	int numBots = 0;
+	bool okay = config.parseFile( filename );
+
+	for ( size_t i = 0; i < config.getNumSections(); i++ ) {
+		const ConfigSection &section = config.getSection( i );
+
+		if ( section.type == "cli" ) {
+			okay &= section.checkKeys( cliKeys );
+			okay &= section.getFloat( "think_seconds", newThinkSeconds, 0.001f, 10 );
+		} else if ( section.type == "bot" ) {
+			if ( numBots > 0 && botSections[0]->label == section.label ) {
+				printf( "WARNING: %s:%d: there is already a [bot %s]\n", filename, section.lineNum, section.label.c_str() );
+				okay = false;
+				continue;
+			}
+
+			if ( numBots == 2 ) {
+				printf( "WARNING: %s:%d: the CLI only has two bots, skipping %s\n", filename, section.lineNum, section.label.c_str() );
+				continue;
+			}
+
+			int b = numBots++;
+
+			botSections[b] = &section;
+			fullNames[b] = section.label;
+			genders[b] = GENDER_NONE;
+			weights[b] = 1;
+			inboxSizes[b] = Persona::DEFAULT_INBOX_SIZE;
+			inboxPolicies[b] = INBOX_PRIORITY_ADDRESSED;
+
+			okay &= section.checkKeys( botKeys );
+			okay &= section.getString( "fullname", fullNames[b] );
+			okay &= section.getChoice( "gender", genders[b], GenderNames );
+			okay &= section.getInt( "weight", weights[b], 1, 100 );
+			okay &= section.getInt( "inbox_size", inboxSizes[b], 1, 100000 );
+			okay &= section.getChoice( "inbox_policy", inboxPolicies[b], InboxPolicyNames );
+
+			if ( section.label.isEmpty() ) {
+				printf( "WARNING: %s:%d: bot needs a nick, [bot Name]\n", filename, section.lineNum );
+				okay = false;
+			}
+		}
+	}
+
+	if ( !okay ) {
+		printf( "WARNING: Not using %s because of errors.\n", filename );
+		return false;
+	}
+
+	thinkSeconds = newThinkSeconds;
+
+	for ( int b = 0; b < numBots; b++ ) {
+		Persona *persona = ( b == 0 ) ? &bot : &bot2;
+
+		if ( startup ) {
+			persona->updateNick( botSections[b]->label );
+			persona->setFullName( fullNames[b] );
+			persona->setGender( (Gender)genders[b] );
+		}
+
+		persona->setInbox( inboxSizes[b], (InboxPolicy)inboxPolicies[b] );
+		botWeights[b] = weights[b];
+		scheduler.setWeight( persona, weights[b] );
+	}
+
+	if ( startup && numBots == 2 ) {
+		twoBots = true;
+	}
+
+	return true;
+}
+
 void cliShutdown() {
+	store.close();
+	inputLog.close();
 	printf("\rQuiting Angel Communication\n");
 	fflush(stdout);
 #ifndef _WIN32
@@ -115,8 +242,65 @@ void sighandler( int signum ) {
 	exit( 1 );
 }
 
+#ifndef _WIN32
+volatile sig_atomic_t reloadData = 0;
+
+void reloadhandler( int signum ) {
+	reloadData = 1;
+}
+#endif
+
 int main( int argc, char **argv )
 {
+	const char *dataFile = NULL;
+	const char *stateFile = NULL;
+	const char *logFile = NULL;
+	const char *replayFile = NULL;
+	const char *configFile = NULL;
+	bool twoBots = false;
+	uint64_t seed = (uint64_t)time( NULL );
+
+	for ( int i = 1; i < argc; i++ ) {
+		if ( !strcmp( argv[i], "--two" ) ) {
+			twoBots = true;
+		} else if ( !strcmp( argv[i], "--data" ) && i + 1 < argc ) {
+			dataFile = argv[++i];
+		} else if ( !strcmp( argv[i], "--state" ) && i + 1 < argc ) {
+			stateFile = argv[++i];
+		} else if ( !strcmp( argv[i], "--seed" ) && i + 1 < argc ) {
+			seed = strtoull( argv[++i], NULL, 10 );
+		} else if ( !strcmp( argv[i], "--log" ) && i + 1 < argc ) {
+			logFile = argv[++i];
+		} else if ( !strcmp( argv[i], "--replay" ) && i + 1 < argc ) {
+			replayFile = argv[++i];
+		} else if ( !strcmp( argv[i], "--config" ) && i + 1 < argc ) {
+			configFile = argv[++i];
+		}
+	}
+
+	if ( dataFile && !WordData::Load( dataFile ) ) {
+		return 1;
+	}
+
+	bot.updateNick( "Angel" );
+	bot.setFullName( "Angelica Anarchy" );
+	bot.setGender( GENDER_FEMALE );
+
+	bot2.updateNick( "Sera" );
+	bot2.setFullName( "Seraph Anarchy" );
+	bot2.setGender( GENDER_FEMALE );
+
+	if ( configFile && !loadConfig( configFile, true, twoBots ) ) {
+		return 1;
+	}
+
+	if ( logFile ) {
+		if ( !inputLog.open( logFile, true ) ) {
+			printf( "WARNING: Failed to open %s\n", logFile );
+			return 1;
+		}
+	}
+
 #ifndef _WIN32
 	struct termios newt;
 
@@ -133,21 +317,28 @@ int main( int argc, char **argv )
 
 	printf("Angel Communication CLI\n");
 	printf("Type 'quit' to exit Angel Communication.\n");
+	printf("Random seed: %llu\n", (unsigned long long)seed );
 
 	signal(SIGINT, sighandler);
 	signal(SIGTERM, sighandler);
+#ifndef _WIN32
+	signal(SIGHUP, reloadhandler);
+#endif
 
 	Conversation room;
+	room.setName( "cli" );
 
-	bot.updateNick( "Angel" );
-	bot.setFullName( "Angelica Anarchy" );
-	bot.setGender( GENDER_FEMALE );
+	if ( stateFile ) {
+		store.open( stateFile );
+	}
+
+	bot.setRandomSeed( seed, 0 );
+	store.attach( &bot, bot.getNick() );
 	room.addPersona( &bot );
 
-	if ( argc >= 2 && !strcmp( argv[1], "--two" ) ) {
-		bot2.updateNick( "Sera" );
-		bot2.setFullName( "Seraph Anarchy" );
-		bot2.setGender( GENDER_FEMALE );
+	if ( twoBots ) {
+		bot2.setRandomSeed( seed, 1 );
+		store.attach( &bot2, bot2.getNick() );
 		room.addPersona( &bot2 );
 	}
 
@@ -156,24 +347,42 @@ int main( int argc, char **argv )
 	user.setAutoChat( false );
 	room.addPersona( &user );
 
+	scheduler.add( &bot, botWeights[0] );
+	if ( twoBots ) {
+		scheduler.add( &bot2, botWeights[1] );
+	}
+
+	if ( replayFile ) {
+		bool replayed = replayLog( room, replayFile );
+		cliShutdown();
+		return replayed ? 0 : 1;
+	}
 
 	std::string text;
 	int ch;
+	LexerStream typing;
+	Lexer typedLines;
+	String sentence;
+	String logEvent;
 
 	while (1)
 	{
-		// sleep until bots wants to think or key press.
-		float delay = -1, botDelay;
-
-		botDelay = bot.getSleepTime();
-		if ( delay < 0 || ( botDelay >= 0 && botDelay < delay ) ) {
-			delay = botDelay;
+#ifndef _WIN32
+		// reload word data on SIGHUP
+		if ( reloadData ) {
+			reloadData = 0;
+			if ( dataFile ) {
+				WordData::Load( dataFile );
+			}
+			if ( configFile ) {
+				loadConfig( configFile, false, twoBots );
+			}
+			inputLog.write( "reload" );
 		}
+#endif
 
-		botDelay = bot2.getSleepTime();
-		if ( delay < 0 || ( botDelay >= 0 && botDelay < delay ) ) {
-			delay = botDelay;
-		}
+		// sleep until bots wants to think or key press.
+		float delay = scheduler.getSleepTime();
 
 		if ( charAvailable( delay ) )
 			ch = getchar();
@@ -196,12 +405,24 @@ int main( int argc, char **argv )
 				fflush(stdout);
 
 				if ( !strncmp( text.c_str(), "/nick ", 6 ) ) {
+					logEvent.setValues( "nick ", &text[6] );
+					inputLog.write( logEvent );
 					user.tryNick( &text[6] );
 				} else {
-					room.addMessage( &user, text.c_str() );
+					logEvent.setValues( "say ", text.c_str() );
+					inputLog.write( logEvent );
+
+					typing.finish();
+					while ( typing.nextSentence( sentence ) ) {
+						typedLines.addToken( sentence );
+					}
+
+					room.addMessage( &user, text.c_str(), typedLines );
 				}
 
 				text.clear();
+				typing.reset();
+				typedLines.clear();
 			}
 		}
 		else if ( ch == 127 ) // Mac OS X 'delete' (usually called backspace)
@@ -210,16 +431,35 @@ int main( int argc, char **argv )
 				text.erase(text.size()-1);
 			printf( "\r%s \b", text.c_str() );
 			fflush(stdout);
+
+			// sentences may have changed, split again
+			typing.reset();
+			typedLines.clear();
+			typing.feed( text.c_str() );
+			while ( typing.nextSentence( sentence ) ) {
+				typedLines.addToken( sentence );
+			}
 		}
 		else if ( ch != EOF && ( ch > 32 || ch == ' ' ) )
 		{
+			char str[2] = { (char)ch, '\0' };
+
 			text.push_back(ch);
 			putchar(ch);
 			fflush(stdout);
+
+			// split sentences while typing instead of after pressing enter
+			typing.feed( str );
+			while ( typing.nextSentence( sentence ) ) {
+				typedLines.addToken( sentence );
+			}
 		}
 
-		bot.think();
-		bot2.think();
+		scheduler.think( thinkSeconds );
+		inputLog.writeThink( scheduler );
+
+		// save state changes from this update
+		store.update();
 	}
 
 	// never reached
@@ -0,0 +1,101 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "../framework/worddata.h"
+
+using namespace AngelCommunication;
+
+void usage( const char *program ) {
+	printf( "Usage: %s [-b] -o <output.dat> <input.txt>...\n", program );
+	printf( "  -b  include built-in word lists before input files\n" );
+}
+
+int main( int argc, char **argv )
+{
+	WordDataBuilder builder;
+	std::vector<char> data;
+	const char *output = NULL;
+	int numInputs = 0;
+	bool okay = true;
+
+	for ( int i = 1; i < argc; i++ ) {
+		if ( !strcmp( argv[i], "-o" ) && i + 1 < argc ) {
+			output = argv[++i];
+		} else if ( !strcmp( argv[i], "-b" ) ) {
+			builder.addBuiltin();
+		} else if ( argv[i][0] == '-' ) {
+			usage( argv[0] );
+			return 1;
+		} else {
+			okay = builder.parseFile( argv[i] ) && okay;
+			numInputs++;
+		}
+	}
+
+	if ( !output || !numInputs ) {
+		usage( argv[0] );
+		return 1;
+	}
+
+	if ( !okay ) {
+		printf( "Not writing %s because of errors\n", output );
+		return 1;
+	}
+
+	builder.compile( data );
+
+	// write to a new file and rename it over the old one. running bots may
+	// have the old file mapped, it must not change under them.
+	std::vector<char> tempName( output, output + strlen( output ) );
+	const char suffix[] = ".tmp";
+	tempName.insert( tempName.end(), suffix, suffix + sizeof ( suffix ) );
+
+	FILE *f = fopen( &tempName[0], "wb" );
+	if ( !f ) {
+		printf( "Failed to open %s for writing\n", &tempName[0] );
+		return 1;
+	}
+
+	if ( fwrite( &data[0], 1, data.size(), f ) != data.size() ) {
+		printf( "Failed to write %s\n", &tempName[0] );
+		fclose( f );
+		remove( &tempName[0] );
+		return 1;
+	}
+	fclose( f );
+
+#ifdef _WIN32
+	remove( output ); // rename doesn't replace files on Windows
+#endif
+	if ( rename( &tempName[0], output ) != 0 ) {
+		printf( "Failed to rename %s to %s\n", &tempName[0], output );
+		remove( &tempName[0] );
+		return 1;
+	}
+
+	printf( "Wrote %s (%d bytes)\n", output, (int)data.size() );
+	return 0;
+}
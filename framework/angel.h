@@ -25,8 +25,20 @@ freely, subject to the following restrictions:
 #include "string.h"
 #include "lexer.h"
 #include "sentence.h"
+#include "random.h"
+#include "metrics.h"
+#include "parsecache.h"
+#include "history.h"
+#include "symbols.h"
 #include "persona.h"
+#include "scheduler.h"
+#include "replaylog.h"
 #include "conversation.h"
+#include "worddata.h"
+#include "personastore.h"
+#include "replytemplate.h"
+#include "config.h"
+#include "log.h"
 
 // functions that must exist outside the framework (aka imported functions)
 void ANGELC_PrintMessage( const AngelCommunication::Conversation *con, const AngelCommunication::Persona *speaker, const char *message );
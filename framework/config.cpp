@@ -0,0 +1,322 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+
+#include "config.h"
+#include "log.h"
+
+namespace AngelCommunication
+{
+
+const ConfigSection::Setting *ConfigSection::find( const char *key ) const
+{
+	// last one wins if a key is set more than once
+	for ( size_t i = this->settings.size(); i > 0; i-- ) {
+		if ( this->settings[i-1].key == key ) {
+			return &this->settings[i-1];
+		}
+	}
+
+	return NULL;
+}
+
+bool ConfigSection::has( const char *key ) const
+{
+	return ( find( key ) != NULL );
+}
+
+bool ConfigSection::getString( const char *key, String &value ) const
+{
+	const Setting *setting = find( key );
+
+	if ( setting ) {
+		value = setting->value;
+	}
+
+	return true;
+}
+
+bool ConfigSection::getInt( const char *key, int &value, int min, int max ) const
+{
+	const Setting *setting = find( key );
+
+	if ( !setting ) {
+		return true;
+	}
+
+	char *end;
+	errno = 0;
+	long number = strtol( setting->value.c_str(), &end, 10 );
+
+	if ( setting->value.isEmpty() || *end != '\0' || errno == ERANGE || number < min || number > max ) {
+		Log::Printf( LOG_WARNING, "config", "WARNING: %s:%d: %s must be a whole number from %d to %d", this->filename.c_str(), setting->lineNum, key, min, max );
+		return false;
+	}
+
+	value = (int)number;
+	return true;
+}
+
+bool ConfigSection::getFloat( const char *key, float &value, float min, float max ) const
+{
+	const Setting *setting = find( key );
+
+	if ( !setting ) {
+		return true;
+	}
+
+	char *end;
+	double number = strtod( setting->value.c_str(), &end );
+
+	if ( setting->value.isEmpty() || *end != '\0' || !( number >= min && number <= max ) ) {
+		Log::Printf( LOG_WARNING, "config", "WARNING: %s:%d: %s must be a number from %g to %g", this->filename.c_str(), setting->lineNum, key, min, max );
+		return false;
+	}
+
+	value = (float)number;
+	return true;
+}
+
+bool ConfigSection::getChoice( const char *key, int &value, const char * const *choices ) const
+{
+	const Setting *setting = find( key );
+
+	if ( !setting ) {
+		return true;
+	}
+
+	for ( int i = 0; choices[i]; i++ ) {
+		if ( setting->value == choices[i] ) {
+			value = i;
+			return true;
+		}
+	}
+
+	String list;
+	for ( int i = 0; choices[i]; i++ ) {
+		list.appendValues( i ? ", " : "", choices[i] );
+	}
+
+	Log::Printf( LOG_WARNING, "config", "WARNING: %s:%d: %s must be one of %s", this->filename.c_str(), setting->lineNum, key, list.c_str() );
+	return false;
+}
+
+bool ConfigSection::getList( const char *key, std::vector<String> &values ) const
+{
+	const Setting *setting = find( key );
+
+	if ( !setting ) {
+		return true;
+	}
+
+	Config::SplitList( setting->value.c_str(), values );
+	return true;
+}
+
+bool ConfigSection::checkKeys( const char * const *known ) const
+{
+	bool okay = true;
+
+	for ( size_t i = 0; i < this->settings.size(); i++ ) {
+		int k;
+
+		for ( k = 0; known[k]; k++ ) {
+			if ( this->settings[i].key == known[k] ) {
+				break;
+			}
+		}
+
+		if ( !known[k] ) {
+			Log::Printf( LOG_WARNING, "config", "WARNING: %s:%d: unknown setting %s in [%s]", this->filename.c_str(), this->settings[i].lineNum, this->settings[i].key.c_str(), this->type.c_str() );
+			okay = false;
+		}
+	}
+
+	return okay;
+}
+
+void Config::clear()
+{
+	this->sections.clear();
+}
+
+bool Config::parseText( const char *text, const char *filename )
+{
+	int lineNum = 0;
+	bool okay = true;
+	const char *line = text;
+	std::vector<char> buf;
+
+	while ( *line ) {
+		const char *end = strchr( line, '\n' );
+
+		if ( !end ) {
+			end = line + strlen( line );
+		}
+
+		lineNum++;
+		buf.assign( line, end );
+		line = *end ? end + 1 : end;
+
+		// tabs and windows line endings are trimmed like spaces
+		for ( size_t i = 0; i < buf.size(); i++ ) {
+			if ( buf[i] == '\t' || buf[i] == '\r' ) {
+				buf[i] = ' ';
+			}
+		}
+		buf.push_back( '\0' );
+
+		String trimmed( &buf[0] );
+		trimmed.trim();
+
+		if ( trimmed.isEmpty() || trimmed[0] == '#' ) {
+			continue;
+		}
+
+		if ( trimmed[0] == '[' ) {
+			if ( trimmed[trimmed.getLen()-1] != ']' ) {
+				Log::Printf( LOG_WARNING, "config", "WARNING: %s:%d: missing ']'", filename, lineNum );
+				okay = false;
+				continue;
+			}
+
+			ConfigSection section;
+			String name = trimmed.subscript( 1, trimmed.getLen() - 2 );
+			name.trim();
+
+			const char *space = strchr( name.c_str(), ' ' );
+
+			if ( space ) {
+				size_t typeLen = space - name.c_str();
+
+				section.type = name.subscript( 0, typeLen - 1 );
+				section.label = name.subscript( typeLen + 1, name.getLen() - 1 );
+				section.label.trim();
+			} else {
+				section.type = name;
+			}
+
+			section.filename = filename;
+			section.lineNum = lineNum;
+			this->sections.push_back( section );
+			continue;
+		}
+
+		const char *equals = strchr( trimmed.c_str(), '=' );
+
+		if ( !equals || equals == trimmed.c_str() ) {
+			Log::Printf( LOG_WARNING, "config", "WARNING: %s:%d: expected key = value", filename, lineNum );
+			okay = false;
+			continue;
+		}
+
+		if ( this->sections.empty() ) {
+			Log::Printf( LOG_WARNING, "config", "WARNING: %s:%d: setting before the first [section]", filename, lineNum );
+			okay = false;
+			continue;
+		}
+
+		ConfigSection::Setting setting;
+		size_t keyLen = equals - trimmed.c_str();
+
+		setting.key = trimmed.subscript( 0, keyLen - 1 );
+		setting.key.trim();
+		if ( keyLen + 1 < trimmed.getLen() ) {
+			setting.value = trimmed.subscript( keyLen + 1, trimmed.getLen() - 1 );
+			setting.value.trim();
+		}
+		setting.lineNum = lineNum;
+
+		this->sections.back().settings.push_back( setting );
+	}
+
+	return okay;
+}
+
+bool Config::parseFile( const char *filename )
+{
+	std::ifstream input( filename, std::ios::in | std::ios::binary );
+	std::vector<char> text;
+
+	if ( !input.good() ) {
+		Log::Printf( LOG_WARNING, "config", "WARNING: Failed to open %s", filename );
+		return false;
+	}
+
+	text.assign( std::istreambuf_iterator<char>( input ), std::istreambuf_iterator<char>() );
+	text.push_back( '\0' );
+
+	return parseText( &text[0], filename );
+}
+
+void Config::SplitList( const char *text, std::vector<String> &values )
+{
+	values.clear();
+
+	for ( const char *p = text; *p; /**/ ) {
+		const char *end = strchr( p, ',' );
+		size_t len = end ? (size_t)( end - p ) : strlen( p );
+		String item;
+
+		if ( len > 0 ) {
+			memcpy( item.getBuffer( len ), p, len );
+			item.trim();
+		}
+
+		if ( !item.isEmpty() ) {
+			values.push_back( item );
+		}
+
+		p += len;
+		if ( *p == ',' ) {
+			p++;
+		}
+	}
+}
+
+size_t Config::getNumSections() const
+{
+	return this->sections.size();
+}
+
+const ConfigSection &Config::getSection( size_t index ) const
+{
+	return this->sections[index];
+}
+
+const ConfigSection *Config::findSection( const char *type, const char *label ) const
+{
+	for ( size_t i = 0; i < this->sections.size(); i++ ) {
+		if ( this->sections[i].type == type && ( !label || this->sections[i].label == label ) ) {
+			return &this->sections[i];
+		}
+	}
+
+	return NULL;
+}
+
+} // end namespace AngelCommunication
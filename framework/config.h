@@ -0,0 +1,103 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ANGEL_CONFIG_INCLUDED
+#define ANGEL_CONFIG_INCLUDED
+
+#include <vector>
+
+#include "string.h"
+
+namespace AngelCommunication
+{
+
+/*
+	ConfigSection class
+	One [type label] section of a config file. The getters only change value
+	if the key is set, so it can be initialized to the default. They print a
+	warning and return false if the value isn't valid.
+*/
+class ConfigSection
+{
+	private:
+		class Setting
+		{
+			public:
+				String	key;
+				String	value;
+				int		lineNum;
+		};
+
+		std::vector<Setting> settings;
+
+		const Setting *find( const char *key ) const;
+
+		friend class Config;
+
+	public:
+		String	filename;
+		int		lineNum;
+		String	type;
+		String	label;	// optional name after the type, e.g. [bot Angel]
+
+		bool has( const char *key ) const;
+		bool getString( const char *key, String &value ) const;
+		bool getInt( const char *key, int &value, int min, int max ) const;
+		bool getFloat( const char *key, float &value, float min, float max ) const;
+		bool getChoice( const char *key, int &value, const char * const *choices ) const; // value is the index, choices ends with NULL
+		bool getList( const char *key, std::vector<String> &values ) const; // comma separated
+
+		// warn about keys that aren't in known (ends with NULL), probably typos
+		bool checkKeys( const char * const *known ) const;
+};
+
+/*
+	Config class
+	Settings file made of sections with one "key = value" per line. Lines
+	starting with # are comments.
+
+	[irc]
+	connect_delay = 20
+	[bot Angel]
+	fullname = Angelica Anarchy
+*/
+class Config
+{
+	private:
+		std::vector<ConfigSection> sections;
+
+	public:
+		void clear();
+		bool parseText( const char *text, const char *filename );
+		bool parseFile( const char *filename );
+
+		size_t getNumSections() const;
+		const ConfigSection &getSection( size_t index ) const;
+		const ConfigSection *findSection( const char *type, const char *label = NULL ) const; // first match
+
+		// split a comma separated list, empty items are skipped
+		static void SplitList( const char *text, std::vector<String> &values );
+};
+
+} // end namespace AngelCommunication
+
+#endif // ANGEL_CONFIG_INCLUDED
@@ -23,40 +23,70 @@ freely, subject to the following restrictions:
 #include <cassert>
 #include "conversation.h"
 #include "persona.h"
+#include "phrasetrie.h"
+#include "parsecache.h"
 #include "angel.h" // include imported functions
 
 namespace AngelCommunication
 {
 
 Conversation::Conversation()
-	: messageNum( 0 )
+	: messageNum( 0 ), delivering( false )
 {
 }
 
+Conversation::~Conversation()
+{
+	// don't leave personas pointing at this
+	while ( !this->personas.empty() ) {
+		removePersona( this->personas.back() );
+	}
+}
+
+void Conversation::setName( const String &name ) {
+	this->name = name;
+}
+
+const String &Conversation::getName( ) const {
+	return this->name;
+}
+
 size_t Conversation::getMessageNum( ) {
 	return this->messageNum;
 }
 
+const ConversationHistory &Conversation::getHistory( ) const {
+	return this->history;
+}
+
+const ConversationStats &Conversation::getStats( ) const {
+	return this->stats;
+}
+
 size_t Conversation::numPersonas( ) {
 	return this->personas.size();
 }
 
-void Conversation::addPersona( Persona *persona )
+void Conversation::addPersona( Persona *persona, bool greet )
 {
 	assert( persona != NULL );
 
 	// check if already in list
-	for ( int i = 0; i < this->personas.size(); i++ )
+	if ( this->personaSlots.count( persona ) )
 	{
-		if ( this->personas[i] == persona )
-		{
-			return;
-		}
+		return;
 	}
 
 	// add to list
+	this->personaSlots[persona] = this->personas.size();
 	this->personas.push_back( persona );
-	this->lastAddressee.push_back( ""  );	// default will be *nobody or *anybody depending on number of personas in conversation
+	this->lastAddressee.push_back( SYM_NONE );	// default will be *nobody or *anybody depending on number of personas in conversation
+	addNick( persona, persona->getNick() );
+	persona->conversations.push_back( this );
+	updateListener( persona );
+
+	if ( !greet )
+		return;
 
 	// notify
 	for ( int i = 0; i < this->personas.size(); i++ )
@@ -70,26 +100,232 @@ void Conversation::addPersona( Persona *persona )
 
 void Conversation::removePersona( Persona *persona )
 {
-	for ( int i = 0; i < this->personas.size(); i++ )
+	std::unordered_map<const Persona*, size_t>::iterator it = this->personaSlots.find( persona );
+
+	if ( it == this->personaSlots.end() )
 	{
-		if ( this->personas[i] == persona )
+		return;
+	}
+
+	// move last persona into the free slot
+	size_t slot = it->second;
+	size_t last = this->personas.size() - 1;
+
+	this->personaSlots.erase( it );
+
+	if ( slot != last )
+	{
+		this->personas[slot] = this->personas[last];
+		this->lastAddressee[slot] = this->lastAddressee[last];
+		this->personaSlots[this->personas[slot]] = slot;
+	}
+
+	this->personas.pop_back();
+	this->lastAddressee.pop_back();
+	removeNick( persona, persona->getNick(), persona->nickSymbol );
+	persona->forgetObserved( this );
+
+	for ( size_t i = 0; i < this->listeners.size(); i++ )
+	{
+		if ( this->listeners[i] == persona )
+		{
+			this->listeners.erase( this->listeners.begin() + i );
+			break;
+		}
+	}
+
+	for ( size_t i = 0; i < persona->conversations.size(); i++ )
+	{
+		if ( persona->conversations[i] == this )
+		{
+			persona->conversations.erase( persona->conversations.begin() + i );
+			break;
+		}
+	}
+}
+
+void Conversation::renamePersona( Persona *persona, const String &oldNick, int oldNickSymbol )
+{
+	removeNick( persona, oldNick, oldNickSymbol );
+	addNick( persona, persona->getNick() );
+
+	// NOTE: lastAddressee isn't updated as IRC client reuses one persona for all users by renaming it.
+}
+
+void Conversation::updateListener( Persona *persona )
+{
+	bool listening = persona->autoChat && this->personaSlots.count( persona );
+
+	for ( size_t i = 0; i < this->listeners.size(); i++ )
+	{
+		if ( this->listeners[i] == persona )
 		{
-			this->personas.erase( this->personas.begin() + i );
-			this->lastAddressee.erase( this->lastAddressee.begin() + i );
+			if ( !listening )
+				this->listeners.erase( this->listeners.begin() + i );
+			return;
+		}
+	}
+
+	if ( listening )
+		this->listeners.push_back( persona );
+}
+
+void Conversation::addNick( Persona *persona, const String &nick )
+{
+	this->nicks[persona->nickSymbol].push_back( persona );
+
+	for ( unsigned int len = MIN_NICK_PREFIX; len < nick.getLen(); len++ )
+	{
+		this->nickPrefixes[nick.subscript( 0, len - 1 )].push_back( persona );
+	}
+}
+
+// remove persona from the list and remove the list if it's empty
+template<class Map>
+static void RemoveNickEntry( Map &map, const typename Map::key_type &key, Persona *persona )
+{
+	typename Map::iterator it = map.find( key );
+
+	if ( it == map.end() )
+	{
+		return;
+	}
+
+	std::vector<Persona*> &list = it->second;
+
+	for ( size_t i = 0; i < list.size(); i++ )
+	{
+		if ( list[i] == persona )
+		{
+			list.erase( list.begin() + i );
 			break;
 		}
 	}
+
+	if ( list.empty() )
+	{
+		map.erase( it );
+	}
+}
+
+void Conversation::removeNick( Persona *persona, const String &nick, int nickSymbol )
+{
+	RemoveNickEntry( this->nicks, nickSymbol, persona );
+
+	for ( unsigned int len = MIN_NICK_PREFIX; len < nick.getLen(); len++ )
+	{
+		RemoveNickEntry( this->nickPrefixes, nick.subscript( 0, len - 1 ), persona );
+	}
+}
+
+Persona *Conversation::findPersona( int nickSymbol ) const
+{
+	std::unordered_map<int, std::vector<Persona*> >::const_iterator it = this->nicks.find( nickSymbol );
+
+	if ( it == this->nicks.end() )
+	{
+		return NULL;
+	}
+
+	return it->second[0];
+}
+
+Persona *Conversation::findPersona( const String &nick, bool allowPrefix ) const
+{
+	// nick isn't added to symbols if it's not known
+	Persona *persona = findPersona( SymbolTable::Find( nick ) );
+
+	if ( persona )
+	{
+		return persona;
+	}
+
+	if ( allowPrefix && nick.getLen() >= MIN_NICK_PREFIX )
+	{
+		std::unordered_map<String, std::vector<Persona*>, NickHash, NickEqual>::const_iterator it = this->nickPrefixes.find( nick );
+
+		// don't guess if it's the start of multiple nicks
+		if ( it != this->nickPrefixes.end() && it->second.size() == 1 )
+		{
+			return it->second[0];
+		}
+	}
+
+	return NULL;
 }
 
 void Conversation::addMessage( Persona *speaker, const String & message )
 {
-	Lexer lines;
-	Lexer messageLine;
-	String addressee, greetingAddressee;
+	Outbound out;
+
+	out.speaker = speaker;
+	out.text = message;
+	out.lines.splitSentences( message );
+	queueMessage( out );
+}
+
+void Conversation::addMessage( Persona *speaker, const String & message, const Lexer &lines )
+{
+	Outbound out;
+
+	out.speaker = speaker;
+	out.text = message;
+	out.lines = lines;
+	queueMessage( out );
+}
+
+void Conversation::queueMessage( const Outbound &message )
+{
+	this->outbound.push_back( message );
+
+	// already delivering, message will be delivered by the loop below
+	if ( this->delivering ) {
+		return;
+	}
+
+	this->delivering = true;
+
+	while ( !this->outbound.empty() ) {
+		Outbound out = this->outbound.front();
+		this->outbound.pop_front();
+
+		deliverMessage( out.speaker, out.text, out.lines );
+	}
+
+	this->delivering = false;
+}
+
+// check if speaker said line recently (more than LOOP_REPEATS-1 times)
+bool Conversation::isRepeating( Persona *speaker, const String &line ) const
+{
+	unsigned int repeats = 0;
+	unsigned int lastId = this->history.getLastId();
+
+	for ( unsigned int id = lastId; id > 0 && lastId - id < LOOP_WINDOW; id-- ) {
+		const HistoryEntry *entry = this->history.get( id );
+
+		if ( !entry ) {
+			break;
+		}
+
+		if ( entry->speaker == speaker && !entry->text.icompareTo( line ) && ++repeats >= LOOP_REPEATS ) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void Conversation::deliverMessage( Persona *speaker, const String & message, const Lexer &lines )
+{
+	String greetingAddressee;
+	int addressee = SYM_NONE;
 
 	messageNum++;
 
-	lines.splitSentences( message );
+	if ( !speaker->autoChat ) {
+		this->stats.messagesIn++;
+	}
 
 	ANGELC_PrintMessage( this, speaker, message.c_str() );
 
@@ -98,7 +334,7 @@ void Conversation::addMessage( Persona *speaker, const String & message )
 	for ( int j = 0; j < lines.getNumTokens(); j++ ) {
 		String sentence;
 
-		sentence.snprintf( 1024, "Sentence %d: %s", j, lines[j].c_str() );
+		sentence.setValues( "Sentence ", j, ": ", lines[j] );
 
 		ANGELC_PrintMessage( this, speaker, sentence.c_str() );
 	}
@@ -113,20 +349,27 @@ void Conversation::addMessage( Persona *speaker, const String & message )
 	// TODO: try to detect cases where: Alice: Dave, I don't understand. Bob: Hi Alice. Alice: Hi. (Alice isn't talking to Dave)
 	//
 	for ( int j = 0; j < lines.getNumTokens(); j++ ) {
-		messageLine.clear();
-		messageLine.parse( lines[j].c_str() );
-
-		int greetingNum = Persona::GetGreetingAddressee( messageLine, greetingAddressee );
+		// parsed once here and shared by all personas. repeated lines are already parsed.
+		const ParsedLine *line = ParseCache::Lookup( lines[j] );
+		const ParsedLine *parsedLine = line;
+		const Lexer &messageLine = line->tokens;
+		int greetingNum = line->greetingNum;
+
+		// Ex: Hi Bob
+		greetingAddressee = "";
+		if ( greetingNum != -1 && line->greetingTokens < messageLine.getNumTokens() ) {
+			greetingAddressee = messageLine[line->greetingTokens];
+		}
 
 		if ( greetingNum != -1 ) {
 			if ( greetingAddressee.isEmpty() ) {
 				// Ex: "Hi"
 				// FIXME: if this greeting is a reply to someone elses greeting, should probably use "*nobody" so bot doesn't reply with a greeting
-				addressee = "*anybody";
+				addressee = SYM_ANYBODY;
 			} else {
 				// Ex: "Hi everyone"
 				if ( !greetingAddressee.icompareTo( "everyone" ) ) {
-					addressee = "*anybody";
+					addressee = SYM_ANYBODY;
 				}
 			}
 		} else {
@@ -135,15 +378,23 @@ void Conversation::addMessage( Persona *speaker, const String & message )
 
 			// Ex: Anyone know what's up?
 			if ( !greetingAddressee.icompareTo( "anyone" ) ) {
-				addressee = "*anybody";
+				addressee = SYM_ANYBODY;
 			}
 		}
 
 		if ( !greetingAddressee.isEmpty() ) {
-			for ( int i = 0; i < this->personas.size(); i++ ) {
-				if ( !this->personas[i]->getNick().icompareTo( greetingAddressee ) ) {
-					addressee = greetingAddressee;
-					break;
+			// Ex: "Bob: hi" or "Bob, hi"
+			bool nickLabel = ( greetingNum == -1 && ( messageLine[1] == ":" || messageLine[1] == "," ) );
+
+			// Ex: "Ang: hi" for Angel
+			Persona *addressed = findPersona( greetingAddressee, nickLabel );
+
+			if ( addressed ) {
+				addressee = addressed->nickSymbol;
+
+				// "Bob: hi" is parsed as "hi"
+				if ( nickLabel ) {
+					parsedLine = ParseCache::Lookup( messageLine.toString( 2 ) );
 				}
 			}
 
@@ -151,42 +402,119 @@ void Conversation::addMessage( Persona *speaker, const String & message )
 		}
 
 		// use last person they addressed or update last addressee
-		for ( int i = 0; i < this->personas.size(); i++ )
+		std::unordered_map<const Persona*, size_t>::const_iterator slot = this->personaSlots.find( speaker );
+
+		if ( slot != this->personaSlots.end() )
 		{
-			if ( this->personas[i] != speaker )
-				continue;
+			size_t i = slot->second;
 
-			if ( addressee.isEmpty() ) {
+			if ( addressee == SYM_NONE ) {
 				addressee = this->lastAddressee[i];
 
 				// default to nobody if it's a group chat, as bot may join a IRC channel and should not thank everyone is talking to it.
-				if ( addressee.isEmpty() ) {
+				if ( addressee == SYM_NONE ) {
 					if ( numPersonas() > 2 ) {
-						addressee = "*nobody";
+						addressee = SYM_NOBODY;
 					} else {
-						addressee = "*anybody";
+						addressee = SYM_ANYBODY;
 					}
 				}
 			} else {
 				this->lastAddressee[i] = addressee;
 			}
-			break;
 		}
 
 #if 0
 		// show addressee for debugging
 		String bigBrother;
-		bigBrother.snprintf( 1024, "Big Brother: Addressed to %s: %s", addressee.c_str(), lines[j].c_str() );
+		bigBrother.setValues( "Big Brother: Addressed to ", SymbolTable::GetName( addressee ), ": ", lines[j] );
 		ANGELC_PrintMessage( this, speaker, bigBrother.c_str() );
 #endif
 
-		// give message line to personas that it's addressed to
-		for ( int i = 0; i < this->personas.size(); i++ )
+		// don't let bots keep replying to each other with the same thing
+		bool botLoop = speaker->autoChat && isRepeating( speaker, lines[j] );
+
+		unsigned int historyId = this->history.add( messageNum, speaker, addressee, lines[j], parsedLine );
+
+		if ( parsedLine != line ) {
+			parsedLine->release();
+		}
+
+		// give message line to personas that it's addressed to.
+		// personas only reply to messages addressed to them, so others never see it.
+		Persona *receiver = NULL;
+
+		if ( botLoop )
+		{
+			// only people see it
+		}
+		else if ( addressee == SYM_ANYBODY )
+		{
+			Message *msg = NULL;
+
+			for ( size_t i = 0; i < this->listeners.size(); i++ )
+			{
+				if ( this->listeners[i] == speaker )
+					continue;
+
+				// only allocated if someone is listening
+				if ( !msg ) {
+					msg = new Message( this, speaker, lines[j], messageNum, addressee, historyId );
+				}
+
+				this->listeners[i]->receiveMessage( msg );
+			}
+
+			if ( msg ) {
+				msg->release();
+			}
+		}
+		else
 		{
-			if ( this->personas[i] == speaker )
-				continue;
+			Persona *listener = findPersona( addressee );
+
+			if ( listener && listener != speaker && listener->autoChat )
+			{
+				Message *msg = new Message( this, speaker, lines[j], messageNum, addressee, historyId );
+
+				listener->receiveMessage( msg );
+				msg->release();
+				receiver = listener;
+			}
+		}
+
+		// listeners that are talked about but not to only observe the line
+		if ( !botLoop && addressee != SYM_ANYBODY && this->listeners.size() > ( receiver ? 1 : 0 ) ) {
+			observeMentions( speaker, receiver, messageLine, historyId );
+		}
+
+		line->release();
+	}
+}
+
+// Ex: "I think Angel is cool" mentions Angel
+void Conversation::observeMentions( Persona *speaker, Persona *receiver, const Lexer &tokens, unsigned int historyId )
+{
+	uint64_t mentioned = 0; // bit for each persona slot
+
+	for ( int i = 0; i < tokens.getNumTokens(); i++ ) {
+		int symbol = SymbolTable::Find( tokens[i] );
+
+		if ( symbol == SYM_NONE ) {
+			continue;
+		}
+
+		Persona *persona = findPersona( symbol );
+
+		if ( !persona || persona == speaker || persona == receiver || !persona->autoChat ) {
+			continue;
+		}
+
+		size_t slot = this->personaSlots[persona];
 
-			this->personas[i]->receiveMessage( this, speaker, lines[j], messageNum, addressee );
+		if ( slot < 64 && !( mentioned & ( 1ULL << slot ) ) ) {
+			mentioned |= ( 1ULL << slot );
+			persona->observeMessage( this, historyId );
 		}
 	}
 }
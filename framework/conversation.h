@@ -22,32 +22,107 @@ freely, subject to the following restrictions:
 #ifndef ANGEL_ROOM_INCLUDED
 #define ANGEL_ROOM_INCLUDED
 
+#include <stdint.h>
+#include <deque>
 #include <vector>
+#include <unordered_map>
 #include "string.h"
+#include "lexer.h"
+#include "history.h"
+#include "symbols.h"
 
 namespace AngelCommunication
 {
 
 class Persona;
 
+class ConversationStats
+{
+	public:
+		unsigned int	messagesIn;		// said by personas without autoChat (users)
+
+		ConversationStats() : messagesIn( 0 )
+		{
+		}
+};
+
 // List of personas that can hear each other
 class Conversation
 {
 	private:
 		std::vector<Persona*> personas;
-		std::vector<String> lastAddressee;
+		std::vector<int> lastAddressee;	// symbol, SYM_NONE if they haven't addressed anyone
 		size_t	messageNum;
+		String	name;
+		ConversationHistory history;
+		ConversationStats stats;
+
+		// personas with autoChat, the only ones given messages
+		std::vector<Persona*> listeners;
+
+		// index of persona in personas and lastAddressee
+		std::unordered_map<const Persona*, size_t> personaSlots;
+
+		// personas by nick symbol and by start of nick (Ex: "Ang" for "Angel")
+		std::unordered_map<int, std::vector<Persona*> > nicks;
+		std::unordered_map<String, std::vector<Persona*>, NickHash, NickEqual> nickPrefixes;
+
+		class Outbound
+		{
+			public:
+				Persona	*speaker;
+				String	text;
+				Lexer	lines;	// text split into sentences
+		};
+
+		// messages waiting to be delivered. messages added while delivering
+		// are delivered after the current one instead of recursively.
+		std::deque<Outbound> outbound;
+		bool	delivering;
+
+		void queueMessage( const Outbound &out );
+		void deliverMessage( Persona *speaker, const String &message, const Lexer &lines );
+		bool isRepeating( Persona *speaker, const String &line ) const;
+		void observeMentions( Persona *speaker, Persona *receiver, const Lexer &tokens, unsigned int historyId );
+
+		void addNick( Persona *persona, const String &nick );
+		void removeNick( Persona *persona, const String &nick, int nickSymbol );
+
+		// not copyable, personas point to it
+		Conversation( const Conversation & );
+		Conversation &operator=( const Conversation & );
 
 	public:
+		// shortest start of nick that can be used to address a persona
+		static const unsigned int MIN_NICK_PREFIX = 3;
+
+		// a persona with autoChat saying the same line this many times in the
+		// last LOOP_WINDOW lines is assumed to be stuck replying to another bot
+		static const unsigned int LOOP_REPEATS = 2;
+		static const unsigned int LOOP_WINDOW = 8;
+
 		Conversation();
+		~Conversation();
+
+		void setName( const String &name );
+		const String &getName() const;
 
 		size_t getMessageNum();
+		const ConversationHistory &getHistory() const;
+		const ConversationStats &getStats() const;
 		size_t numPersonas();
 
-		void addPersona( Persona *persona );
+		void addPersona( Persona *persona, bool greet = true ); // greet lets the others say hello to a new person
 		void removePersona( Persona *persona );
+		void renamePersona( Persona *persona, const String &oldNick, int oldNickSymbol );
+		void updateListener( Persona *persona ); // autoChat changed
+
+		// NULL if no persona has nick. allowPrefix also checks if nick is the start of exactly one persona's nick
+		Persona *findPersona( const String &nick, bool allowPrefix = false ) const;
+		Persona *findPersona( int nickSymbol ) const;
 
 		void addMessage( Persona *speaker, const String & message );
+		void addMessage( Persona *speaker, const String & message, const Lexer &lines ); // message already split using LexerStream or Lexer::splitSentences
 };
 
 }
@@ -0,0 +1,202 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <cstring>
+
+#include "history.h"
+#include "lexer.h"
+#include "phrasetrie.h"
+#include "worddata.h"
+
+namespace AngelCommunication
+{
+
+ConversationHistory::ConversationHistory()
+{
+	clear();
+}
+
+ConversationHistory::~ConversationHistory()
+{
+	clear();
+}
+
+void ConversationHistory::clear()
+{
+	for ( int i = 0; i < HISTORY_SIZE; i++ ) {
+		if ( this->entries[i].parsed ) {
+			this->entries[i].parsed->release();
+		}
+
+		this->entries[i] = HistoryEntry();
+	}
+
+	memset( this->index, 0, sizeof( this->index ) );
+	this->lastId = 0;
+}
+
+unsigned int ConversationHistory::IndexKey( IndexKeyType type, const char *text )
+{
+	// mix in type so the same word is a different key for each type
+	return PhraseTrie::HashToken( text ) ^ ( ( type + 1 ) * 0x9e3779b9u );
+}
+
+unsigned int ConversationHistory::IndexKey( IndexKeyType type, const Persona *speaker )
+{
+	size_t p = (size_t)speaker;
+
+	return (unsigned int)( p ^ ( p >> 16 ) ) * 16777619u ^ ( ( type + 1 ) * 0x9e3779b9u );
+}
+
+void ConversationHistory::addIndex( unsigned int key, unsigned int id )
+{
+	IndexSlot &slot = this->index[key & ( INDEX_SIZE - 1 )];
+
+	if ( slot.key != key ) {
+		// replace whatever was using this slot
+		memset( &slot, 0, sizeof( slot ) );
+		slot.key = key;
+	}
+
+	// a line may add the same keyword more than once
+	if ( slot.ids[0] == id ) {
+		return;
+	}
+
+	memmove( &slot.ids[1], &slot.ids[0], sizeof( slot.ids[0] ) * ( INDEX_DEPTH - 1 ) );
+	slot.ids[0] = id;
+}
+
+const HistoryEntry *ConversationHistory::findIndex( unsigned int key, unsigned int beforeId ) const
+{
+	const IndexSlot &slot = this->index[key & ( INDEX_SIZE - 1 )];
+
+	if ( slot.key != key ) {
+		return NULL;
+	}
+
+	for ( int i = 0; i < INDEX_DEPTH; i++ ) {
+		if ( beforeId && slot.ids[i] >= beforeId ) {
+			continue;
+		}
+
+		// stops at unused ids and lines that were replaced
+		return get( slot.ids[i] );
+	}
+
+	return NULL;
+}
+
+unsigned int ConversationHistory::add( size_t messageNum, Persona *speaker, int addressee, const String &text, const ParsedLine *parsed )
+{
+	const WordData *words = WordData::Current();
+	unsigned int id = ++this->lastId;
+
+	if ( id == 0 ) {
+		// wrapped around, ids can't be told apart anymore
+		clear();
+		id = ++this->lastId;
+	}
+
+	HistoryEntry &entry = this->entries[id % HISTORY_SIZE];
+
+	entry.id = id;
+	entry.messageNum = messageNum;
+	entry.speaker = speaker;
+	entry.addressee = addressee;
+	entry.text = text;
+	parsed->addRef();
+	if ( entry.parsed ) {
+		entry.parsed->release();
+	}
+	entry.parsed = parsed;
+	entry.subject = "";
+
+	for ( size_t i = 0; i < parsed->sentence.parts.size(); i++ ) {
+		const SentencePart &part = parsed->sentence.parts[i];
+		Lexer subject( part.subject );
+		Lexer predicate( part.predicate );
+		unsigned int first;
+		bool usable = true;
+
+		for ( first = 0; first < subject.getNumTokens(); first++ ) {
+			if ( !words->inList( WL_FILLER, subject[first] ) ) {
+				break;
+			}
+		}
+
+		for ( unsigned int t = first; t < subject.getNumTokens(); t++ ) {
+			if ( words->inList( WL_PRONOUN, subject[t] ) || words->inList( WL_PUNCTUATION, subject[t] ) ) {
+				usable = false;
+			} else if ( !words->inList( WL_FILLER, subject[t] ) ) {
+				addIndex( IndexKey( HK_KEYWORD, subject.getTokenText( t ) ), id );
+			}
+		}
+
+		for ( unsigned int t = 0; t < predicate.getNumTokens(); t++ ) {
+			if ( !words->inList( WL_FILLER, predicate[t] ) && !words->inList( WL_PUNCTUATION, predicate[t] )
+				&& !words->inList( WL_PRONOUN, predicate[t] ) ) {
+				addIndex( IndexKey( HK_KEYWORD, predicate.getTokenText( t ) ), id );
+			}
+		}
+
+		// "you" or "it" doesn't mean anything later
+		if ( usable && first < subject.getNumTokens() && entry.subject.isEmpty() ) {
+			entry.subject = subject.toString( first );
+			addIndex( IndexKey( HK_SUBJECT, entry.subject.c_str() ), id );
+			addIndex( IndexKey( HK_SPEAKER_SUBJECT, speaker ), id );
+		}
+	}
+
+	return id;
+}
+
+const HistoryEntry *ConversationHistory::get( unsigned int id ) const
+{
+	if ( id == 0 || id > this->lastId || this->lastId - id >= HISTORY_SIZE ) {
+		return NULL;
+	}
+
+	return &this->entries[id % HISTORY_SIZE];
+}
+
+unsigned int ConversationHistory::getLastId() const
+{
+	return this->lastId;
+}
+
+const HistoryEntry *ConversationHistory::findKeyword( const String &keyword, unsigned int beforeId ) const
+{
+	return findIndex( IndexKey( HK_KEYWORD, keyword.c_str() ), beforeId );
+}
+
+const HistoryEntry *ConversationHistory::findSubject( const String &subject, unsigned int beforeId ) const
+{
+	return findIndex( IndexKey( HK_SUBJECT, subject.c_str() ), beforeId );
+}
+
+const HistoryEntry *ConversationHistory::findSpeakerSubject( const Persona *speaker, unsigned int beforeId ) const
+{
+	return findIndex( IndexKey( HK_SPEAKER_SUBJECT, speaker ), beforeId );
+}
+
+} // end namespace AngelCommunication
@@ -0,0 +1,113 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ANGEL_HISTORY_INCLUDED
+#define ANGEL_HISTORY_INCLUDED
+
+#include "string.h"
+#include "sentence.h"
+#include "parsecache.h"
+
+namespace AngelCommunication
+{
+
+class Persona;
+
+class HistoryEntry
+{
+	public:
+		unsigned int	id;			// 0 if unused
+		size_t			messageNum;
+		Persona			*speaker;
+		int				addressee;	// symbol
+		String			text;		// one sentence line of the message
+		const ParsedLine *parsed;	// text without leading "Nick:" and its sentence, has a reference
+		String			subject;	// first subject without filler words or pronouns, may be empty
+
+		HistoryEntry() : id( 0 ), messageNum( 0 ), speaker( NULL ), addressee( 0 ), parsed( NULL ) { }
+};
+
+/*
+	ConversationHistory class
+	Keeps the last HISTORY_SIZE lines said in a conversation along with their
+	parsed sentences so personas can look back at what was being talked about.
+
+	Keywords and subjects are added to a fixed size hash index that maps them
+	to the ids of the most recent lines they were in. Looking something up
+	doesn't depend on how long the conversation has gone on and old lines
+	are replaced instead of using more memory.
+*/
+class ConversationHistory
+{
+	public:
+		enum {
+			HISTORY_SIZE = 64,	// lines kept
+			INDEX_SIZE = 256,	// index slots, must be power of two
+			INDEX_DEPTH = 4		// line ids kept per index slot
+		};
+
+	private:
+		enum IndexKeyType {
+			HK_KEYWORD,
+			HK_SUBJECT,
+			HK_SPEAKER_SUBJECT	// lines by a speaker that have a subject
+		};
+
+		class IndexSlot
+		{
+			public:
+				unsigned int	key;
+				unsigned int	ids[INDEX_DEPTH];	// most recent first, 0 if unused
+		};
+
+		HistoryEntry	entries[HISTORY_SIZE];
+		IndexSlot		index[INDEX_SIZE];
+		unsigned int	lastId;
+
+		static unsigned int IndexKey( IndexKeyType type, const char *text );
+		static unsigned int IndexKey( IndexKeyType type, const Persona *speaker );
+
+		void addIndex( unsigned int key, unsigned int id );
+		const HistoryEntry *findIndex( unsigned int key, unsigned int beforeId ) const;
+
+	public:
+		ConversationHistory();
+		~ConversationHistory();
+
+		void clear();
+
+		// returns id of the line, use get() to access it
+		unsigned int add( size_t messageNum, Persona *speaker, int addressee, const String &text, const ParsedLine *parsed );
+
+		// NULL if id was never added or is no longer kept
+		const HistoryEntry *get( unsigned int id ) const;
+		unsigned int getLastId() const;
+
+		// Most recent line before beforeId (0 for any) that has keyword/subject.
+		const HistoryEntry *findKeyword( const String &keyword, unsigned int beforeId = 0 ) const;
+		const HistoryEntry *findSubject( const String &subject, unsigned int beforeId = 0 ) const;
+		const HistoryEntry *findSpeakerSubject( const Persona *speaker, unsigned int beforeId = 0 ) const;
+};
+
+} // end namespace AngelCommunication
+
+#endif // ANGEL_HISTORY_INCLUDED
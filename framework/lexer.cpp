@@ -20,16 +20,17 @@ freely, subject to the following restrictions:
 */
 
 #include <cctype>
+#include <cstring>
 #include "lexer.h"
 
 namespace AngelCommunication
 {
 
-Lexer::Lexer()
+Lexer::Lexer() : firstToken( 0 )
 {
 }
 
-Lexer::Lexer(const String &text)
+Lexer::Lexer(const String &text) : firstToken( 0 )
 {
     parse( text );
 }
@@ -41,8 +42,11 @@ Lexer::~Lexer()
 
 void Lexer::clear()
 {
-	this->tokens.clear();
-	this->spaceAfterToken.clear();
+	this->chars.clear();
+	this->tokenOffset.clear();
+	this->tokenLength.clear();
+	this->tokenFlags.clear();
+	this->firstToken = 0;
 }
 
 static bool incharset( char c, const char *charset ) {
@@ -124,6 +128,9 @@ void Lexer::parse(const String &text)
 	bool marks;
 	const char punctuation[] = ".!?"; // sentence punctuation
 
+	// there can't be more token text and '\0's than twice the text
+	this->chars.reserve( this->chars.size() + text.getLen() * 2 + 1 );
+
     for (size_t i = 0, len = text.getLen()+1; i < len; i++)
     {
 		if ( incharset( text[i], punctuation ) && !checkPunctSplit( text, i ) )
@@ -160,14 +167,12 @@ void Lexer::parse(const String &text)
         if ( isspace( text[i] ) || text[i] == '\0' || marks )
         {
             if (tokenStart != -1) {
-				this->spaceAfterToken.push_back( isspace( text[i] ) );
-				this->tokens.push_back(text.subscript(tokenStart, i - 1));
+				addTokenText( text.c_str() + tokenStart, i - tokenStart, isspace( text[i] ) );
 				tokenStart = -1;
 			}
 
 			if (marks) {
-				this->spaceAfterToken.push_back( ( i < len-1 && isspace( text[i+1] ) ) );
-				this->tokens.push_back(text.subscript(i, i));
+				addTokenText( text.c_str() + i, 1, ( i < len-1 && isspace( text[i+1] ) ) );
 			}
         }
         else
@@ -199,63 +204,73 @@ void Lexer::parse(const String &text)
 	TODO: Check if this handles emoticons correct.
 */
 void Lexer::splitSentences(const String &text) {
-	const char *dot, *p, *tokenStart;
-	const char *start = text.c_str();
-	const char punctuation[] = ".!?";
+	LexerStream stream;
+	String s;
 
-	p = dot = tokenStart = start;
-	while ( dot ) {
-		dot = strchrset( p, punctuation );
-		if ( !dot ) {
-			String s( text.subscript( (int)( tokenStart - start ), text.getLen() ) );
-			s.trim();
+	stream.feed( text );
+	stream.finish();
 
-			// make sure not to add an empty string.
-			if ( s.getLen() > 0 )
-				tokens.push_back( s );
+	while ( stream.nextSentence( s ) ) {
+		addToken( s );
+	}
+}
 
-			// NOTE: implicate ending that might be continued in next message
-			break;
-		}
+void Lexer::addTokenText( const char *text, unsigned int length, bool spaceAfter ) {
+	unsigned int offset = this->chars.size();
 
-		//
-		int numDots = 1;
-		while ( incharset( dot[numDots], punctuation ) ) {
-			numDots++;
-		}
-
-		// always end at blah..blah or blah...... or B.L.A.H..
-		if ( numDots == 1 && !checkPunctSplit( text, (int)( dot - start ) ) ) {
-			p = dot + 1;
-			continue;
-		}
+	this->chars.resize( offset + length + 1 );
+	if ( length > 0 ) {
+		memcpy( &this->chars[offset], text, length );
+	}
+	this->chars[offset + length] = '\0';
 
-		String s( text.subscript( (int)( tokenStart - start ), (int)( dot - start ) + numDots ) );
-		s.trim();
-		tokens.push_back( s );
+	this->tokenOffset.push_back( offset );
+	this->tokenLength.push_back( length );
+	this->tokenFlags.push_back( spaceAfter ? TOKEN_SPACE_AFTER : 0 );
+}
 
-		// skip to after this '.' (or group of ..s) to find the next.
-		p = tokenStart = dot + numDots;
-	}
+void Lexer::addToken( const String &token, bool spaceAfter ) {
+	addTokenText( token.c_str(), token.getLen(), spaceAfter );
 }
 
 void Lexer::removeToken(unsigned int index) {
-	if ( index >= this->tokens.size() ) {
+	if ( index >= getNumTokens() ) {
+		return;
+	}
+
+	if ( index == 0 ) {
+		this->firstToken++;
+
+		if ( this->firstToken == this->tokenOffset.size() ) {
+			clear();
+		}
 		return;
 	}
 
-	this->spaceAfterToken.erase( this->spaceAfterToken.begin() + index );
-	this->tokens.erase( this->tokens.begin() + index );
+	// the text stays in chars until clear()
+	index += this->firstToken;
+	this->tokenOffset.erase( this->tokenOffset.begin() + index );
+	this->tokenLength.erase( this->tokenLength.begin() + index );
+	this->tokenFlags.erase( this->tokenFlags.begin() + index );
 }
 
 String Lexer::getToken(unsigned int index) const
 {
-    if (index >= this->tokens.size())
+    String token;
+
+    if (index >= getNumTokens())
     {
-        return String();
+        return token;
     }
 
-    return this->tokens[index];
+    unsigned int length = this->tokenLength[this->firstToken + index];
+
+    if (length > 0)
+    {
+        memcpy(token.getBuffer(length), getTokenText(index), length);
+    }
+
+    return token;
 }
 
 String Lexer::operator[](unsigned int index) const
@@ -263,21 +278,31 @@ String Lexer::operator[](unsigned int index) const
     return getToken(index);
 }
 
+const char *Lexer::getTokenText( unsigned int index ) const
+{
+	if ( index >= getNumTokens() ) {
+		return "";
+	}
+
+	return &this->chars[this->tokenOffset[this->firstToken + index]];
+}
+
 size_t Lexer::getNumTokens() const
 {
-    return this->tokens.size();
+    return this->tokenOffset.size() - this->firstToken;
 }
 
 bool Lexer::isEmpty() const
 {
-	return ( this->tokens.size() == 0 );
+	return ( getNumTokens() == 0 );
 }
 
 int Lexer::findExact(const String &needle) const
 {
-	for (int i = 0; i < this->tokens.size(); ++i)
+	for (int i = 0; i < getNumTokens(); ++i)
 	{
-		if ( needle == this->tokens[i] )
+		if ( this->tokenLength[this->firstToken + i] == needle.getLen()
+			&& String::FoldCompare( needle.c_str(), getTokenText( i ), needle.getLen() ) == 0 )
 			return i;
 	}
 
@@ -286,36 +311,197 @@ int Lexer::findExact(const String &needle) const
 
 int Lexer::findPartial(const String &needle) const
 {
-	for (int i = 0; i < this->tokens.size(); ++i)
+	if ( needle.isEmpty() )
+		return -1;
+
+	for (int i = 0; i < getNumTokens(); ++i)
 	{
-		if ( this->tokens[i].findString(needle) )
+		if ( strstr( getTokenText( i ), needle.c_str() ) )
 			return i;
 	}
 
 	return -1;
 }
 
+// Returns true if tokens first through last are the same as all of phrase's tokens (case-insensitive)
+bool Lexer::matchTokens( const Lexer &phrase, unsigned int first, unsigned int last ) const
+{
+	if ( first > last || last >= getNumTokens() || last - first + 1 != phrase.getNumTokens() ) {
+		return false;
+	}
+
+	for ( unsigned int i = first; i <= last; ++i ) {
+		unsigned int length = this->tokenLength[this->firstToken + i];
+
+		if ( length != phrase.tokenLength[phrase.firstToken + i - first]
+			|| String::FoldCompare( getTokenText( i ), phrase.getTokenText( i - first ), length ) ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Copies the tokens into a String sized for all of them at once.
 String Lexer::toString( unsigned int first, unsigned int last, bool forceSpaces ) const
 {
-	if ( getNumTokens() == 0 )
+	size_t numTokens = getNumTokens();
+
+	if ( first >= numTokens )
 		return String();
 
-	String s(this->tokens[first]);
+	if ( last > numTokens - 1 )
+	{
+		last = numTokens - 1;
+	}
+
+	if ( last < first )
+	{
+		last = first;
+	}
+
+	const unsigned int *lengths = &this->tokenLength[this->firstToken];
+	const unsigned char *flags = &this->tokenFlags[this->firstToken];
+	unsigned int total = 0;
 
-	if ( last > this->tokens.size()-1 )
+	for ( unsigned int i = first; i <= last; ++i )
 	{
-		last = this->tokens.size()-1;
+		total += lengths[i];
+
+		if ( i > first && ( forceSpaces || ( flags[i - 1] & TOKEN_SPACE_AFTER ) ) )
+			total++;
 	}
 
-	for (int i = first+1; i <= last; ++i)
+	String s;
+	char *dest = s.getBuffer( total );
+
+	if ( dest == NULL )
+		return s;
+
+	for ( unsigned int i = first; i <= last; ++i )
 	{
-		if ( forceSpaces || this->spaceAfterToken.size() < i || this->spaceAfterToken[i - 1] == true )
-			s.append(" ");
-		s.append(this->tokens[i]);
+		if ( i > first && ( forceSpaces || ( flags[i - 1] & TOKEN_SPACE_AFTER ) ) )
+			*dest++ = ' ';
+
+		memcpy( dest, getTokenText( i ), lengths[i] );
+		dest += lengths[i];
 	}
 
 	return s;
 }
 
+LexerStream::LexerStream()
+{
+	reset();
+}
+
+void LexerStream::reset()
+{
+	this->pending = "";
+	this->start = 0;
+	this->scanned = 0;
+	this->finished = false;
+}
+
+void LexerStream::feed( const String &text )
+{
+	this->pending.append( text );
+}
+
+void LexerStream::finish()
+{
+	this->finished = true;
+}
+
+const String &LexerStream::getPending() const
+{
+	return this->pending;
+}
+
+// Find the first sentence end in pending (see Lexer::splitSentences for rules).
+// Sentence punctuation at the end of pending might have more added to it so
+// it doesn't end a sentence until there is more text or finish() is called.
+bool LexerStream::split( String &sentence )
+{
+	const char *dot, *p;
+	const char *text = this->pending.c_str();
+	const char punctuation[] = ".!?";
+
+	p = text + this->scanned;
+	while ( ( dot = strchrset( p, punctuation ) ) ) {
+		int numDots = 1;
+		while ( incharset( dot[numDots], punctuation ) ) {
+			numDots++;
+		}
+
+		if ( dot[numDots] == '\0' && !this->finished ) {
+			// check this again when there is more text
+			this->scanned = dot - text;
+			return false;
+		}
+
+		// always end at blah..blah or blah...... or B.L.A.H..
+		if ( numDots == 1 && !checkPunctSplit( this->pending, (int)( dot - text ) ) ) {
+			p = dot + 1;
+			continue;
+		}
+
+		// NOTE: includes the character after the punctuation, it's usually a space that is trimmed
+		size_t end = ( dot - text ) + numDots;
+
+		sentence = this->pending.subscript( this->start, end );
+		sentence.trim();
+
+		// keep the token the next sentence starts in, checkPunctSplit looks at the whole token
+		size_t keep = end;
+		while ( keep > 0 && text[keep - 1] != ' ' ) {
+			keep--;
+		}
+
+		this->pending = this->pending.subscript( keep, this->pending.getLen() );
+		this->start = end - keep;
+		this->scanned = this->start;
+		return true;
+	}
+
+	this->scanned = this->pending.getLen();
+	return false;
+}
+
+bool LexerStream::nextSentence( String &sentence )
+{
+	if ( split( sentence ) ) {
+		return true;
+	}
+
+	if ( !this->finished ) {
+		return false;
+	}
+
+	// NOTE: implicate ending that might be continued in next message
+	sentence = this->pending.subscript( this->start, this->pending.getLen() );
+	sentence.trim();
+	reset();
+	this->finished = true;
+
+	// make sure not to add an empty string.
+	return ( sentence.getLen() > 0 );
+}
+
+void LexerStream::getCompleteTokens( Lexer &tokens ) const
+{
+	size_t end = this->pending.getLen();
+
+	while ( end > this->start && !isspace( this->pending[end - 1] ) ) {
+		end--;
+	}
+
+	tokens.clear();
+
+	if ( end > this->start ) {
+		tokens.parse( this->pending.subscript( this->start, end - 1 ) );
+	}
+}
+
 } // end namespace AngelCommunication
 
@@ -32,12 +32,24 @@ namespace AngelCommunication
 /*
     Lexer class
     Parse and store a string of text as tokens.
+    The token text is kept in one buffer, each token followed by a '\0',
+    with the offset, length, and flags of each token in separate arrays.
+    Removing the first token only moves firstToken.
 */
 class Lexer
 {
     private:
-        std::vector<String> tokens;
-        std::vector<bool> spaceAfterToken;
+        enum {
+            TOKEN_SPACE_AFTER = 1
+        };
+
+        std::vector<char> chars; // text of all tokens
+        std::vector<unsigned int> tokenOffset; // start of each token in chars
+        std::vector<unsigned int> tokenLength;
+        std::vector<unsigned char> tokenFlags;
+        unsigned int firstToken; // tokens before this were removed
+
+        void addTokenText( const char *text, unsigned int length, bool spaceAfter );
 
     public:
         Lexer(void);
@@ -46,18 +58,51 @@ class Lexer
         void clear(void);
         void parse(const String &text); // split words
 		void splitSentences( const String &text ); // split sentences
+		void addToken( const String &token, bool spaceAfter = true );
 		void removeToken( unsigned int index );
 		bool isEmpty() const;
         size_t getNumTokens(void) const;
         String getToken(unsigned int index) const;
         String operator[](unsigned int index) const;
+		const char *getTokenText( unsigned int index ) const; // doesn't copy the token
 
 		int findExact(const String &needle) const;
 		int findPartial(const String &needle) const;
+		bool matchTokens( const Lexer &phrase, unsigned int first, unsigned int last ) const;
 
 		String toString(unsigned int first = 0, unsigned int last = -1, bool forceSpaces = false) const;
 };
 
+/*
+    LexerStream class
+    Splits text into sentences as it arrives, such as a line being typed.
+    A sentence is returned as soon as it can't be changed by more text.
+    Only the text after the last complete sentence is kept.
+*/
+class LexerStream
+{
+    private:
+        String pending; // text after the last returned sentence, starting with the whole token it's in
+        size_t start; // start of next sentence in pending
+        size_t scanned; // pending before this doesn't have a sentence end
+        bool finished;
+
+        bool split( String &sentence );
+
+    public:
+        LexerStream();
+
+        void reset();
+        void feed( const String &text );
+        void finish(); // no more text is coming, the rest is a sentence
+
+        // Returns true and sets sentence if a sentence is complete.
+        bool nextSentence( String &sentence );
+
+        // Tokens of pending text that are followed by a space, so won't change.
+        void getCompleteTokens( Lexer &tokens ) const;
+        const String &getPending() const;
+};
 
 } // end namespace AngelCommunication
 
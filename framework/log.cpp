@@ -0,0 +1,324 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+
+#include <chrono>
+#include <stdarg.h>
+#include <string.h>
+
+#include "log.h"
+#include "string.h"
+
+namespace AngelCommunication
+{
+
+const char * const LogLevelNames[] = { "debug", "info", "notice", "warning", "error", NULL };
+const char * const LogFormatNames[] = { "text", "json", NULL };
+
+Log::Log()
+	: ring( NULL ), writePos( 0 ), addPos( 0 ), running( false ), minLevel( LOG_INFO ), format( LOG_TEXT ),
+	dropped( 0 ), reportedDropped( 0 )
+{
+}
+
+Log::~Log()
+{
+	Stop();
+}
+
+Log &Log::Get()
+{
+	static Log log;
+
+	return log;
+}
+
+double Log::TimeSeconds()
+{
+	std::chrono::duration<double> now = std::chrono::system_clock::now().time_since_epoch();
+
+	return now.count();
+}
+
+void Log::Start()
+{
+	Log &log = Get();
+
+	if ( log.running ) {
+		return;
+	}
+
+	if ( !log.ring ) {
+		log.ring = new Entry[RING_SIZE];
+	}
+
+	for ( size_t i = 0; i < RING_SIZE; i++ ) {
+		log.ring[i].sequence.store( i, std::memory_order_relaxed );
+	}
+
+	log.writePos = 0;
+	log.addPos.store( 0, std::memory_order_relaxed );
+	log.running = true;
+	log.writer = std::thread( &Log::writerThread, &log );
+}
+
+void Log::Stop()
+{
+	Log &log = Get();
+
+	if ( !log.running ) {
+		return;
+	}
+
+	log.running = false;
+	log.wake.notify_one();
+	log.writer.join();
+}
+
+void Log::SetLevel( LogLevel level )
+{
+	Get().minLevel.store( level, std::memory_order_relaxed );
+}
+
+void Log::SetFormat( LogFormat format )
+{
+	Get().format.store( format, std::memory_order_relaxed );
+}
+
+bool Log::Enabled( LogLevel level )
+{
+	return level >= Get().minLevel.load( std::memory_order_relaxed );
+}
+
+uint64_t Log::GetDropped()
+{
+	return Get().dropped.load( std::memory_order_relaxed );
+}
+
+/*
+	The ring is a bounded queue where each entry's sequence says whose turn
+	it is: sequence == position means it's free to add a line at position,
+	position + 1 means the line is ready to be written out. Lines can be
+	added from any thread by claiming a position with compare and swap.
+*/
+Log::Entry *Log::reserve()
+{
+	size_t pos = this->addPos.load( std::memory_order_relaxed );
+
+	while ( 1 ) {
+		Entry *entry = &this->ring[pos & ( RING_SIZE - 1 )];
+		size_t sequence = entry->sequence.load( std::memory_order_acquire );
+		intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+
+		if ( diff == 0 ) {
+			if ( this->addPos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) ) {
+				return entry;
+			}
+		} else if ( diff < 0 ) {
+			// writer hasn't written out this entry yet
+			this->dropped.fetch_add( 1, std::memory_order_relaxed );
+			return NULL;
+		} else {
+			pos = this->addPos.load( std::memory_order_relaxed );
+		}
+	}
+}
+
+void Log::commit( Entry *entry )
+{
+	size_t pos = entry->sequence.load( std::memory_order_relaxed );
+
+	entry->sequence.store( pos + 1, std::memory_order_release );
+	this->wake.notify_one();
+}
+
+// returns false if there isn't a line ready
+bool Log::writeNext( FILE *out )
+{
+	Entry *entry = &this->ring[this->writePos & ( RING_SIZE - 1 )];
+
+	if ( entry->sequence.load( std::memory_order_acquire ) != this->writePos + 1 ) {
+		return false;
+	}
+
+	WriteLine( out, (LogFormat)this->format.load( std::memory_order_relaxed ), entry->time, entry->level, entry->category, entry->text );
+
+	// free for the line RING_SIZE positions later
+	entry->sequence.store( this->writePos + RING_SIZE, std::memory_order_release );
+	this->writePos++;
+
+	return true;
+}
+
+void Log::writerThread()
+{
+	while ( 1 ) {
+		bool wrote = false;
+
+		// checked before writing, so lines added before Stop() are written before exiting
+		bool stopping = !this->running;
+
+		while ( writeNext( stdout ) ) {
+			wrote = true;
+		}
+
+		uint64_t numDropped = this->dropped.load( std::memory_order_relaxed );
+
+		if ( numDropped != this->reportedDropped ) {
+			char message[64];
+
+			snprintf( message, sizeof ( message ), "WARNING: Dropped %llu log lines", (unsigned long long)( numDropped - this->reportedDropped ) );
+			WriteLine( stdout, (LogFormat)this->format.load( std::memory_order_relaxed ), TimeSeconds(), LOG_WARNING, "log", message );
+
+			this->reportedDropped = numDropped;
+			wrote = true;
+		}
+
+		if ( wrote ) {
+			fflush( stdout );
+			continue;
+		}
+
+		if ( stopping ) {
+			break;
+		}
+
+		// lines added while not waiting are picked up after the timeout
+		std::unique_lock<std::mutex> lock( this->wakeMutex );
+		int waitMs = WRITER_WAIT_MS;
+		this->wake.wait_for( lock, std::chrono::milliseconds( waitMs ) );
+	}
+}
+
+static void WriteJsonString( FILE *out, const char *str )
+{
+	fputc( '"', out );
+
+	for ( const unsigned char *c = (const unsigned char *)str; *c; c++ ) {
+		if ( *c == '"' || *c == '\\' ) {
+			fputc( '\\', out );
+			fputc( *c, out );
+		} else if ( *c == '\n' ) {
+			fputs( "\\n", out );
+		} else if ( *c < 0x20 ) {
+			fprintf( out, "\\u%04x", *c );
+		} else {
+			fputc( *c, out );
+		}
+	}
+
+	fputc( '"', out );
+}
+
+void Log::WriteLine( FILE *out, LogFormat format, double time, LogLevel level, const char *category, const char *message )
+{
+	if ( format == LOG_JSON ) {
+		// text lines start with the level, Ex: "WARNING: ", it's already in "level"
+		const char *text = message;
+		size_t levelLen = strlen( LogLevelNames[level] );
+
+		while ( *text == ' ' ) {
+			text++;
+		}
+
+		if ( !String::FoldCompare( text, LogLevelNames[level], levelLen ) && text[levelLen] == ':' && text[levelLen+1] == ' ' ) {
+			message = text + levelLen + 2;
+		}
+
+		fprintf( out, "{\"time\":%.3f,\"level\":\"%s\",\"category\":", time, LogLevelNames[level] );
+		WriteJsonString( out, category );
+		fputs( ",\"message\":", out );
+		WriteJsonString( out, message );
+		fputs( "}\n", out );
+	} else {
+		fputs( message, out );
+		fputc( '\n', out );
+	}
+}
+
+void Log::Write( LogLevel level, const char *category, const char *message )
+{
+	Log &log = Get();
+
+	if ( !Enabled( level ) ) {
+		return;
+	}
+
+	if ( !log.running ) {
+		WriteLine( stdout, (LogFormat)log.format.load( std::memory_order_relaxed ), TimeSeconds(), level, category, message );
+		return;
+	}
+
+	Entry *entry = log.reserve();
+
+	if ( !entry ) {
+		return;
+	}
+
+	entry->time = TimeSeconds();
+	entry->level = level;
+	entry->category = category;
+	strncpy( entry->text, message, sizeof ( entry->text ) - 1 );
+	entry->text[sizeof ( entry->text ) - 1] = 0;
+
+	log.commit( entry );
+}
+
+void Log::Printf( LogLevel level, const char *category, const char *format, ... )
+{
+	Log &log = Get();
+	va_list args;
+
+	if ( !Enabled( level ) ) {
+		return;
+	}
+
+	if ( !log.running ) {
+		char message[sizeof ( log.ring->text )];
+
+		va_start( args, format );
+		vsnprintf( message, sizeof ( message ), format, args );
+		va_end( args );
+
+		WriteLine( stdout, (LogFormat)log.format.load( std::memory_order_relaxed ), TimeSeconds(), level, category, message );
+		return;
+	}
+
+	Entry *entry = log.reserve();
+
+	if ( !entry ) {
+		return;
+	}
+
+	entry->time = TimeSeconds();
+	entry->level = level;
+	entry->category = category;
+
+	// formatted straight into the ring, long lines are cut off
+	va_start( args, format );
+	vsnprintf( entry->text, sizeof ( entry->text ), format, args );
+	va_end( args );
+
+	log.commit( entry );
+}
+
+} // end namespace AngelCommunication
@@ -0,0 +1,144 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+
+#ifndef ANGEL_LOG_INCLUDED
+#define ANGEL_LOG_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <thread>
+
+namespace AngelCommunication
+{
+
+enum LogLevel
+{
+	LOG_DEBUG,		// only compiled in with ANGEL_DEBUG_LOG, see ANGEL_LOG_DEBUG
+	LOG_INFO,
+	LOG_NOTICE,
+	LOG_WARNING,
+	LOG_ERROR,
+
+	LOG_MAX
+};
+
+enum LogFormat
+{
+	LOG_TEXT,		// message only, the same as printing it
+	LOG_JSON,		// one JSON object per line with time, level, category, and message
+
+	LOG_FORMAT_MAX
+};
+
+// names for config files, in enum order and ending with NULL
+extern const char * const LogLevelNames[];
+extern const char * const LogFormatNames[];
+
+/*
+	Log class
+	Lines are written to stdout by a writer thread after Start(), so a slow
+	terminal or pipe doesn't stall the bots. Adding a line is lock-free and
+	never waits; if the writer falls RING_SIZE lines behind new lines are
+	dropped and counted. Before Start() (and after Stop()) lines are printed
+	right away, so programs that don't start it print like they used to.
+
+	category must be a string constant, it's kept until the line is written.
+*/
+class Log
+{
+	private:
+		class Entry
+		{
+			public:
+				std::atomic<size_t> sequence; // ring position this entry is ready to be written or read for
+				double		time;
+				LogLevel	level;
+				const char	*category;
+				char		text[512];
+		};
+
+		Entry				*ring;
+		size_t				writePos;		// next entry for the writer thread to write out
+		std::atomic<size_t>	addPos;			// next entry for a new line
+		std::atomic<bool>	running;
+		std::atomic<int>	minLevel;
+		std::atomic<int>	format;
+		std::atomic<uint64_t> dropped;
+		uint64_t			reportedDropped;
+
+		std::thread			writer;
+		std::mutex			wakeMutex;
+		std::condition_variable wake;
+
+		Log();
+		~Log();
+
+		static Log &Get();
+		static double TimeSeconds();
+
+		Entry *reserve();
+		void commit( Entry *entry );
+		bool writeNext( FILE *out );
+		void writerThread();
+
+		static void WriteLine( FILE *out, LogFormat format, double time, LogLevel level, const char *category, const char *message );
+
+		// not copyable
+		Log( const Log & );
+		Log &operator=( const Log & );
+
+	public:
+		static const size_t RING_SIZE = 1024; // must be a power of 2
+		static const int WRITER_WAIT_MS = 20; // longest a new line waits to be written
+
+		static void Start();
+		static void Stop(); // write out all lines and stop the writer thread
+
+		static void SetLevel( LogLevel level ); // lines below level are skipped
+		static void SetFormat( LogFormat format );
+		static bool Enabled( LogLevel level );
+		static uint64_t GetDropped();
+
+		// message doesn't need a new line
+		static void Write( LogLevel level, const char *category, const char *message );
+		static void Printf( LogLevel level, const char *category, const char *format, ... )
+#ifdef __GNUC__
+			__attribute__ (( format( printf, 3, 4 ) ))
+#endif
+			;
+};
+
+} // end namespace AngelCommunication
+
+// debug lines are checked by the compiler but removed unless built with ANGEL_DEBUG_LOG
+#ifdef ANGEL_DEBUG_LOG
+#define ANGEL_LOG_DEBUG( ... ) AngelCommunication::Log::Printf( AngelCommunication::LOG_DEBUG, __VA_ARGS__ )
+#else
+#define ANGEL_LOG_DEBUG( ... ) do { if ( 0 ) AngelCommunication::Log::Printf( AngelCommunication::LOG_DEBUG, __VA_ARGS__ ); } while ( 0 )
+#endif
+
+#endif // ANGEL_LOG_INCLUDED
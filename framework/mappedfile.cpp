@@ -0,0 +1,133 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <fstream>
+#include <iterator>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mappedfile.h"
+
+namespace AngelCommunication
+{
+
+MappedFile::MappedFile()
+	: data( NULL ), size( 0 ), mapped( false )
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+/*
+	open
+	Returns false if the file couldn't be opened. An empty file is opened
+	with NULL data.
+*/
+bool MappedFile::open( const char *filename )
+{
+	close();
+
+#ifdef _WIN32
+	std::ifstream input( filename, std::ios::in | std::ios::binary );
+
+	if ( !input.good() ) {
+		return false;
+	}
+
+	this->storage.assign( std::istreambuf_iterator<char>( input ), std::istreambuf_iterator<char>() );
+	this->data = this->storage.empty() ? NULL : &this->storage[0];
+	this->size = this->storage.size();
+#else
+	struct stat st;
+	int fd = ::open( filename, O_RDONLY );
+
+	if ( fd == -1 ) {
+		return false;
+	}
+
+	if ( fstat( fd, &st ) == -1 ) {
+		::close( fd );
+		return false;
+	}
+
+	if ( st.st_size > 0 ) {
+		// shared mapping, so all processes using the file share the pages
+		void *p = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+
+		if ( p == MAP_FAILED ) {
+			::close( fd );
+			return false;
+		}
+
+		this->data = (const char *)p;
+		this->size = st.st_size;
+		this->mapped = true;
+	}
+
+	::close( fd );
+#endif
+
+	return true;
+}
+
+void MappedFile::assign( std::vector<char> &contents )
+{
+	close();
+
+	this->storage.swap( contents );
+	this->data = this->storage.empty() ? NULL : &this->storage[0];
+	this->size = this->storage.size();
+}
+
+void MappedFile::close()
+{
+#ifndef _WIN32
+	if ( this->mapped ) {
+		munmap( (void *)this->data, this->size );
+	}
+#endif
+
+	this->storage.clear();
+	this->data = NULL;
+	this->size = 0;
+	this->mapped = false;
+}
+
+const char *MappedFile::getData() const
+{
+	return this->data;
+}
+
+size_t MappedFile::getSize() const
+{
+	return this->size;
+}
+
+} // end namespace AngelCommunication
@@ -0,0 +1,62 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ANGEL_MAPPEDFILE_INCLUDED
+#define ANGEL_MAPPEDFILE_INCLUDED
+
+#include <vector>
+#include <cstdlib>
+
+namespace AngelCommunication
+{
+
+/*
+	MappedFile class
+	Read-only file contents. Memory mapped where supported, otherwise read
+	into memory.
+*/
+class MappedFile
+{
+	private:
+		const char			*data;
+		size_t				size;
+		bool				mapped;
+		std::vector<char>	storage;
+
+		MappedFile( const MappedFile &file ); // not copyable
+		MappedFile &operator=( const MappedFile &file );
+
+	public:
+		MappedFile();
+		~MappedFile();
+
+		bool open( const char *filename );
+		void assign( std::vector<char> &contents ); // takes contents instead of a file
+		void close();
+
+		const char *getData() const;
+		size_t getSize() const;
+};
+
+} // end namespace AngelCommunication
+
+#endif // ANGEL_MAPPEDFILE_INCLUDED
@@ -0,0 +1,131 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+
+#include "metrics.h"
+
+namespace AngelCommunication
+{
+
+const double Histogram::BucketBounds[Histogram::NUM_BUCKETS] = {
+	0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+	0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+};
+
+Histogram::Histogram() : count( 0 ), sum( 0 )
+{
+	for ( size_t i = 0; i <= NUM_BUCKETS; i++ ) {
+		this->buckets[i] = 0;
+	}
+}
+
+void Histogram::add( double seconds )
+{
+	size_t i;
+
+	for ( i = 0; i < NUM_BUCKETS; i++ ) {
+		if ( seconds <= BucketBounds[i] ) {
+			break;
+		}
+	}
+
+	this->buckets[i]++;
+	this->count++;
+	this->sum += seconds;
+}
+
+void MetricsWriter::type( const char *name, const char *type, const char *help )
+{
+	this->text.appendValues( "# HELP ", name, " ", help, "\n# TYPE ", name, " ", type, "\n" );
+}
+
+// name{labels} followed by the value
+void MetricsWriter::series( const char *name, const char *suffix, const String &labels )
+{
+	this->text.appendValues( name, suffix );
+
+	if ( !labels.isEmpty() ) {
+		this->text.appendValues( "{", labels, "}" );
+	}
+}
+
+void MetricsWriter::value( const char *name, const String &labels, double value )
+{
+	series( name, "", labels );
+	this->text.append_snprintf( 64, " %.9g\n", value );
+}
+
+void MetricsWriter::value( const char *name, const String &labels, uint64_t value )
+{
+	series( name, "", labels );
+	this->text.append_snprintf( 64, " %llu\n", (unsigned long long)value );
+}
+
+// buckets are cumulative in the text format
+void MetricsWriter::histogram( const char *name, const String &labels, const Histogram &histogram )
+{
+	const char *comma = labels.isEmpty() ? "" : ",";
+	uint64_t total = 0;
+
+	for ( size_t i = 0; i < Histogram::NUM_BUCKETS; i++ ) {
+		total += histogram.buckets[i];
+		this->text.appendValues( name, "_bucket{", labels, comma );
+		this->text.append_snprintf( 64, "le=\"%g\"} %llu\n", Histogram::BucketBounds[i], (unsigned long long)total );
+	}
+	this->text.appendValues( name, "_bucket{", labels, comma );
+	this->text.append_snprintf( 64, "le=\"+Inf\"} %llu\n", (unsigned long long)histogram.count );
+
+	series( name, "_sum", labels );
+	this->text.append_snprintf( 64, " %.9g\n", histogram.sum );
+	series( name, "_count", labels );
+	this->text.append_snprintf( 64, " %llu\n", (unsigned long long)histogram.count );
+}
+
+const String &MetricsWriter::getText() const
+{
+	return this->text;
+}
+
+// escapes backslash, quote, and new line in value
+void MetricsWriter::addLabel( String &labels, const char *name, const String &value )
+{
+	if ( !labels.isEmpty() ) {
+		labels.append( "," );
+	}
+
+	labels.appendValues( name, "=\"" );
+
+	for ( const char *c = value.c_str(); *c; c++ ) {
+		if ( *c == '\\' || *c == '"' ) {
+			labels.append( '\\' );
+			labels.append( *c );
+		} else if ( *c == '\n' ) {
+			labels.append( "\\n" );
+		} else {
+			labels.append( *c );
+		}
+	}
+
+	labels.append( "\"" );
+}
+
+} // end namespace AngelCommunication
@@ -0,0 +1,80 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+
+#ifndef ANGEL_METRICS_INCLUDED
+#define ANGEL_METRICS_INCLUDED
+
+#include <cstddef>
+#include <stdint.h>
+
+#include "string.h"
+
+namespace AngelCommunication
+{
+
+/*
+	Histogram class
+	Counts durations in seconds using fixed buckets from 0.1 milliseconds to
+	10 seconds, so adding one is cheap and nothing is allocated.
+*/
+class Histogram
+{
+	public:
+		static const size_t NUM_BUCKETS = 16;
+		static const double BucketBounds[NUM_BUCKETS]; // upper bound of each bucket
+
+		uint64_t	buckets[NUM_BUCKETS + 1]; // last is more than the last bound
+		uint64_t	count;
+		double		sum;
+
+		Histogram();
+
+		void add( double seconds );
+};
+
+/*
+	MetricsWriter class
+	Builds Prometheus text format. Write each metric's type, then all of its
+	values. Labels are built with addLabel(), Ex: bot="Angel",network="wizard".
+*/
+class MetricsWriter
+{
+	private:
+		String text;
+
+		void series( const char *name, const char *suffix, const String &labels );
+
+	public:
+		void type( const char *name, const char *type, const char *help );
+		void value( const char *name, const String &labels, double value );
+		void value( const char *name, const String &labels, uint64_t value );
+		void histogram( const char *name, const String &labels, const Histogram &histogram );
+
+		const String &getText() const;
+
+		static void addLabel( String &labels, const char *name, const String &value );
+};
+
+} // end namespace AngelCommunication
+
+#endif // ANGEL_METRICS_INCLUDED
@@ -0,0 +1,153 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <cassert>
+
+#include "parsecache.h"
+#include "persona.h"
+#include "worddata.h"
+
+namespace AngelCommunication
+{
+
+ParsedLine::ParsedLine( const String &t )
+	: refCount( 1 ), text( t ), tokens( t )
+{
+	this->sentence.parse( t.c_str(), false );
+	Persona::MatchRules( this->tokens, this->greetingNum, this->greetingTokens, this->statementNum );
+}
+
+ParsedLine::~ParsedLine()
+{
+}
+
+void ParsedLine::addRef() const
+{
+	const_cast<ParsedLine*>( this )->refCount++;
+}
+
+void ParsedLine::release() const
+{
+	assert( this->refCount > 0 );
+
+	if ( --const_cast<ParsedLine*>( this )->refCount == 0 ) {
+		delete this;
+	}
+}
+
+bool ParseCache::ExactEqual::operator()( const String &a, const String &b ) const
+{
+	return a.getLen() == b.getLen() && !a.compareTo( b );
+}
+
+ParseCache::ParseCache()
+	: maxLines( DEFAULT_SIZE ), generation( 0 )
+{
+}
+
+ParseCache::~ParseCache()
+{
+	evict( 0 );
+}
+
+ParseCache &ParseCache::Get()
+{
+	static ParseCache cache;
+
+	return cache;
+}
+
+// drop least recently used lines until there are only keep
+void ParseCache::evict( size_t keep )
+{
+	while ( this->lines.size() > keep ) {
+		ParsedLine *line = this->lines.back();
+
+		this->index.erase( line->text );
+		this->lines.pop_back();
+		line->release();
+		this->stats.evictions++;
+	}
+}
+
+const ParsedLine *ParseCache::Lookup( const String &text )
+{
+	ParseCache &cache = Get();
+	unsigned int generation = WordData::Current()->getGeneration();
+
+	if ( cache.generation != generation ) {
+		Clear();
+		cache.generation = generation;
+	}
+
+	std::unordered_map<String, LineList::iterator, NickHash, ExactEqual>::iterator it = cache.index.find( text );
+
+	if ( it != cache.index.end() ) {
+		// move to front
+		cache.lines.splice( cache.lines.begin(), cache.lines, it->second );
+		cache.stats.hits++;
+
+		ParsedLine *line = *it->second;
+		line->addRef();
+		return line;
+	}
+
+	cache.stats.misses++;
+
+	// may clear the cache if the statement rules need to be compiled
+	double startTime = Persona::ClockSeconds();
+	ParsedLine *line = new ParsedLine( text );
+	cache.stats.parseTime.add( Persona::ClockSeconds() - startTime );
+
+	cache.lines.push_front( line );
+	cache.index[line->text] = cache.lines.begin();
+	cache.evict( cache.maxLines );
+
+	line->addRef();
+	return line;
+}
+
+void ParseCache::Clear()
+{
+	ParseCache &cache = Get();
+	unsigned int evictions = cache.stats.evictions;
+
+	cache.evict( 0 );
+
+	// only count lines dropped to make room
+	cache.stats.evictions = evictions;
+}
+
+void ParseCache::SetSize( size_t maxLines )
+{
+	ParseCache &cache = Get();
+
+	cache.maxLines = ( maxLines > 0 ) ? maxLines : 1;
+	cache.evict( cache.maxLines );
+}
+
+const ParseCacheStats &ParseCache::GetStats()
+{
+	return Get().stats;
+}
+
+} // end namespace AngelCommunication
@@ -0,0 +1,128 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ANGEL_PARSECACHE_INCLUDED
+#define ANGEL_PARSECACHE_INCLUDED
+
+#include <list>
+#include <unordered_map>
+
+#include "string.h"
+#include "lexer.h"
+#include "sentence.h"
+#include "symbols.h"
+#include "metrics.h"
+
+namespace AngelCommunication
+{
+
+/*
+	ParsedLine class
+	Tokens, parsed sentence, and greeting and statement rules matched for a
+	line of text. Shared by everything that looks up the same text, so it
+	can't be changed. Use addRef() when keeping a pointer to it and release()
+	when done with it.
+*/
+class ParsedLine
+{
+	private:
+		int refCount;
+
+		ParsedLine( const String &text );
+		~ParsedLine();
+
+		// not copyable
+		ParsedLine( const ParsedLine & );
+		ParsedLine &operator=( const ParsedLine & );
+
+		friend class ParseCache;
+
+	public:
+		String		text;
+		Lexer		tokens;
+		Sentence	sentence;
+		int			greetingNum;	// greeting at start of the line, -1 if none
+		int			greetingTokens;	// number of tokens in the greeting
+		int			statementNum;	// statement rule the whole line matches, -1 if none
+
+		void addRef() const;
+		void release() const;
+};
+
+class ParseCacheStats
+{
+	public:
+		unsigned int	hits;
+		unsigned int	misses;
+		unsigned int	evictions;
+		Histogram		parseTime;	// seconds to parse each miss
+
+		ParseCacheStats() : hits( 0 ), misses( 0 ), evictions( 0 )
+		{
+		}
+};
+
+/*
+	ParseCache class
+	Chat repeats the same lines a lot ("hi", "lol", bots replying to each
+	other) so parsed lines are kept by text and the least recently used are
+	dropped when there are too many. Text is compared exactly because replies
+	repeat parts of it, the hash ignores case so it can use String's cached
+	hash. Everything is dropped when the word data or statement rules change.
+*/
+class ParseCache
+{
+	private:
+		class ExactEqual
+		{
+			public:
+				bool operator()( const String &a, const String &b ) const;
+		};
+
+		typedef std::list<ParsedLine*> LineList;	// most recently used first
+
+		LineList		lines;
+		std::unordered_map<String, LineList::iterator, NickHash, ExactEqual> index;
+		size_t			maxLines;
+		unsigned int	generation;	// word data generation lines were parsed with
+		ParseCacheStats	stats;
+
+		ParseCache();
+		~ParseCache();
+
+		static ParseCache &Get();
+
+		void evict( size_t keep );
+
+	public:
+		static const size_t DEFAULT_SIZE = 512;
+
+		// returns with a reference added, release() it when done
+		static const ParsedLine *Lookup( const String &text );
+		static void Clear();
+		static void SetSize( size_t maxLines );
+		static const ParseCacheStats &GetStats();
+};
+
+} // end namespace AngelCommunication
+
+#endif // ANGEL_PARSECACHE_INCLUDED
@@ -22,23 +22,41 @@ freely, subject to the following restrictions:
 #include <stdio.h>
 #include <cstring>
 #include <ctype.h>
+#include <chrono>
 
 #include "angel.h"
 #include "persona.h"
 #include "wordtypes.h"
+#include "phrasetrie.h"
+#include "worddata.h"
+#include "personastore.h"
+#include "replytemplate.h"
+#include "parsecache.h"
 
 namespace AngelCommunication
 {
 
+const char * const GenderNames[] = { "none", "female", "male", NULL };
+const char * const InboxPolicyNames[] = { "drop_oldest", "coalesce_speaker", "priority_addressed", NULL };
+
 Persona::Persona()
 {
 	this->nick = "unknown";
+	this->nickSymbol = SymbolTable::Intern( this->nick );
 	this->fullName = "unknown";
 	this->gender = GENDER_NONE;
 	this->autoChat = true;
 	this->funReplies = true;
+	this->store = NULL;
+	this->inboxSize = DEFAULT_INBOX_SIZE;
+	this->inboxPolicy = INBOX_PRIORITY_ADDRESSED;
+	this->numObserved = 0;
 
 	this->nextUpdateTime = std::time( NULL ) + 2;
+
+	// unique stream so personas don't all say the same thing until seeded
+	static uint64_t numPersonas = 0;
+	this->random.seed( 0, numPersonas++ );
 }
 
 void Persona::tryNick( const String &nick )
@@ -52,29 +70,106 @@ void Persona::tryNick( const String &nick )
 	}
 }
 
+Persona::~Persona()
+{
+	for ( size_t i = 0; i < this->messages.size(); i++ ) {
+		this->messages[i]->release();
+	}
+
+	// not removed from store, they're still expected next time
+	for ( size_t i = 0; i < this->expectations.size(); i++ ) {
+		delete this->expectations[i];
+	}
+
+	while ( !this->conversations.empty() ) {
+		this->conversations.back()->removePersona( this );
+	}
+}
+
 void Persona::updateNick( const String &nick )
 {
+	String oldNick = this->nick;
+	int oldNickSymbol = this->nickSymbol;
+
 	this->nick = nick;
+	this->nickSymbol = SymbolTable::Intern( nick );
 	this->nickPossesive = nick;
 	if ( this->nick[this->nick.getLen()-1] == 's' )
 		this->nickPossesive.append( "'" );
 	else
 		this->nickPossesive.append( "'s" );
+
+	for ( size_t i = 0; i < this->conversations.size(); i++ ) {
+		this->conversations[i]->renamePersona( this, oldNick, oldNickSymbol );
+	}
+
+	if ( this->store )
+		this->store->savePersona( this );
 }
 
 void Persona::setFullName( const String &fullName )
 {
 	this->fullName = fullName;
+
+	if ( this->store )
+		this->store->savePersona( this );
 }
 
 void Persona::setGender( Gender gender )
 {
 	this->gender = gender;
+
+	if ( this->store )
+		this->store->savePersona( this );
 }
 
 void Persona::setAutoChat( bool autoChat )
 {
 	this->autoChat = autoChat;
+
+	for ( size_t i = 0; i < this->conversations.size(); i++ ) {
+		this->conversations[i]->updateListener( this );
+	}
+}
+
+void Persona::setRandomSeed( uint64_t seed, uint64_t stream )
+{
+	this->random.seed( seed, stream );
+}
+
+void Persona::setInbox( size_t maxMessages, InboxPolicy policy )
+{
+	this->inboxSize = ( maxMessages > 0 ) ? maxMessages : 1;
+	this->inboxPolicy = policy;
+
+	while ( this->messages.size() > this->inboxSize ) {
+		dropMessage( findMessageToDrop( NULL ) );
+	}
+}
+
+const InboxStats &Persona::getInboxStats( void ) const
+{
+	return this->inboxStats;
+}
+
+const ThinkStats &Persona::getThinkStats( void ) const
+{
+	return this->thinkStats;
+}
+
+size_t Persona::getInboxCount( void ) const
+{
+	return this->messages.size();
+}
+
+size_t Persona::getNumExpectations( void ) const
+{
+	return this->expectations.size();
+}
+
+double Persona::ClockSeconds()
+{
+	return std::chrono::duration<double>( std::chrono::steady_clock::now().time_since_epoch() ).count();
 }
 
 const String &Persona::getNick( void ) const
@@ -82,6 +177,11 @@ const String &Persona::getNick( void ) const
 	return this->nick;
 }
 
+int Persona::getNickSymbol( void ) const
+{
+	return this->nickSymbol;
+}
+
 const String &Persona::getFullName( void ) const
 {
 	return this->fullName;
@@ -92,16 +192,16 @@ void Persona::personaConnect( Conversation *con, Persona *persona ) {
 		return;
 
 	String s;
-	s = "Hi "; // TODO: use random greeting select here.
-	s.append( persona->nick );
-	s.append( "." );
+	// TODO: use random greeting select here.
+	ReplyTemplate::Format( RT_CONNECT, s, ReplyArgs().set( RS_NICK, persona->nick ) );
 
 	// FIXME: disabled so bots don't get stuck replying to each other from the get go.
 	if ( !persona->autoChat )
 		con->addMessage( this, s );
 }
 
-void Persona::receiveMessage( Conversation *con, Persona *speaker, const String &text, int messageNum, const String &addressee )
+// Conversation only gives messages to personas with autoChat that are addressed
+void Persona::receiveMessage( Message *message )
 {
 	if ( !this->autoChat )
 		return;
@@ -113,7 +213,108 @@ void Persona::receiveMessage( Conversation *con, Persona *speaker, const String
 		this->nextUpdateTime = time( NULL ) + 2;
 	}
 
-	this->messages.push_back( new Message( con, speaker, text, messageNum, addressee ) );
+	this->inboxStats.received++;
+
+	// inbox is full, make room or drop this message
+	if ( this->messages.size() >= this->inboxSize ) {
+		size_t index = findMessageToDrop( message );
+
+		if ( index == this->messages.size() ) {
+			this->inboxStats.dropped++;
+			return;
+		}
+
+		if ( this->inboxPolicy == INBOX_COALESCE_SPEAKER && this->messages[index]->from == message->from
+			&& this->messages[index]->con == message->con ) {
+			this->inboxStats.coalesced++;
+		}
+
+		dropMessage( index );
+	}
+
+	message->addRef();
+	this->messages.push_back( message );
+}
+
+// cheap record of lines about this persona, for learning without replying
+void Persona::observeMessage( Conversation *con, unsigned int historyId )
+{
+	Observation &o = this->observed[this->numObserved % OBSERVE_SIZE];
+
+	o.con = con;
+	o.historyId = historyId;
+	this->numObserved++;
+}
+
+void Persona::forgetObserved( const Conversation *con )
+{
+	for ( size_t i = 0; i < OBSERVE_SIZE; i++ ) {
+		if ( this->observed[i].con == con ) {
+			this->observed[i].con = NULL;
+		}
+	}
+}
+
+const Observation *Persona::getObserved( size_t age ) const
+{
+	if ( age >= OBSERVE_SIZE || age >= this->numObserved ) {
+		return NULL;
+	}
+
+	const Observation *o = &this->observed[( this->numObserved - 1 - age ) % OBSERVE_SIZE];
+
+	if ( !o->con ) {
+		return NULL;
+	}
+
+	return o;
+}
+
+void Persona::dropMessage( size_t index )
+{
+	this->messages[index]->release();
+	this->messages.erase( this->messages.begin() + index );
+	this->inboxStats.dropped++;
+}
+
+// returns messages.size() to drop incoming instead. incoming may be NULL.
+size_t Persona::findMessageToDrop( const Message *incoming ) const
+{
+	size_t numMessages = this->messages.size();
+
+	switch ( this->inboxPolicy ) {
+		case INBOX_COALESCE_SPEAKER:
+			if ( !incoming )
+				break;
+
+			// older line from the same speaker. lines in the same message are all kept.
+			for ( size_t i = 0; i < numMessages; i++ ) {
+				const Message *m = this->messages[i];
+
+				if ( m->from == incoming->from && m->con == incoming->con && m->messageNum != incoming->messageNum ) {
+					return i;
+				}
+			}
+			break;
+
+		case INBOX_PRIORITY_ADDRESSED:
+			for ( size_t i = 0; i < numMessages; i++ ) {
+				if ( this->messages[i]->addressee != this->nickSymbol ) {
+					return i;
+				}
+			}
+
+			// everything waiting is addressed to me
+			if ( incoming && incoming->addressee != this->nickSymbol ) {
+				return numMessages;
+			}
+			break;
+
+		default:
+			break;
+	}
+
+	return 0;
 }
 
 float Persona::getSleepTime() {
@@ -121,145 +322,239 @@ float Persona::getSleepTime() {
 
 	// waiting for new messages. doesn't care when next update is.
 	if ( currentTime >= this->nextUpdateTime )
-		return -1;
+		return this->messages.empty() ? -1 : 0;
 
 	return this->nextUpdateTime - currentTime;
 }
 
-#define GTF_SPECIAL 1 // one does not just say Merry Christmas whenever.
-#define GTF_BYE		2
-#define GTF_NIGHT	4
-struct greetingType_s {
-	const char	*text;
-	int			subjectStartToken;
-	int			flags;
-} greetingTypes[] = {
-	{ "Hi",				1,	0 },
-	{ "Hello",			1,	0 },
-	{ "'ello",			1,	0 },
-	{ "ello",			1,	0 },
-	{ "Hey",			1,	0 }, // not always a greeting...
-	{ "ohai",			1,	0 },
-	{ "ohayou",			1,	0 }, // Ohayou Gozaimasu
-	{ "I acknowledge your existence", 4, 0 },
-	{ "Bye",			1,	GTF_BYE },
-	{ "Good bye",		2,	GTF_BYE },
-	{ "Goodbye",		1,	GTF_BYE },
-	{ "Good night",		2,	GTF_NIGHT },
-	{ "gn",				1,	GTF_NIGHT },
-	{ "sleep",			1,	GTF_NIGHT },
-	{ "sleep time",		2,	GTF_NIGHT },
-	{ "sleep taim",		2,	GTF_NIGHT },
-	{ "Welcome",		1,	GTF_SPECIAL }, // not really special but don't want saying a lot
-	{ "Good morning",	2,	GTF_SPECIAL },
-	{ "Good afternoon",	2,	GTF_SPECIAL },
-	{ "Good evening",	2,	GTF_SPECIAL },
-	{ "Merry Christmas",2,	GTF_SPECIAL },
-
-	{ NULL, 0, 0 } // for random, NULL means repeat whatever greeting person said (including special ones).
+class StatementRule
+{
+	public:
+		String	msg, reply;
+		bool	random;
 };
 
+// rule tables compiled into tries from the word data
+static PhraseTrie greetingTrie;
+static PhraseTrie statementTrie;
+static std::vector<StatementRule> statementRules;
+static std::vector<StatementRule> addedStatementRules; // from AddStatement, kept when word data is reloaded
+static unsigned int phraseTablesGeneration = 0;
+
+static void AddStatementRule( const StatementRule &rule )
+{
+	if ( statementTrie.addPhrase( rule.msg, (int)statementRules.size() ) ) {
+		statementRules.push_back( rule );
+	}
+}
+
+// recompile if there is new word data
+static void CompilePhraseTables()
+{
+	const WordData *words = WordData::Current();
+
+	if ( phraseTablesGeneration == words->getGeneration() ) {
+		return;
+	}
+
+	phraseTablesGeneration = words->getGeneration();
+
+	// cached lines have rule numbers from the old tables
+	ParseCache::Clear();
+
+	greetingTrie.clear();
+	statementTrie.clear();
+	statementRules.clear();
+
+	for ( size_t i = 0; i < words->getNumEntries( WL_GREETINGS ); ++i ) {
+		greetingTrie.addPhrase( words->getString( WL_GREETINGS, i, 0 ), (int)i );
+	}
+
+	for ( size_t i = 0; i < words->getNumEntries( WL_STATEMENTS ); ++i ) {
+		StatementRule rule;
+
+		rule.msg = words->getString( WL_STATEMENTS, i, 0 );
+		rule.reply = words->getString( WL_STATEMENTS, i, 1 );
+		rule.random = !!words->getInt( WL_STATEMENTS, i, 2 );
+
+		AddStatementRule( rule );
+	}
+
+	for ( size_t i = 0; i < addedStatementRules.size(); ++i ) {
+		AddStatementRule( addedStatementRules[i] );
+	}
+}
+
+/*
+	AddStatement
+	Add a rule to reply to msg with reply. Random statements may also be said
+	by a bot (expecting reply back) when it doesn't know what else to say.
+*/
+void Persona::AddStatement( const String &msg, const String &reply, bool random )
+{
+	StatementRule rule;
+
+	CompilePhraseTables();
+
+	rule.msg = msg;
+	rule.reply = reply;
+	rule.random = random;
+
+	addedStatementRules.push_back( rule );
+	AddStatementRule( rule );
+
+	// cached lines may match the new rule
+	ParseCache::Clear();
+}
+
 int Persona::GetGreetingAddressee( const Lexer &messageTokens, String &messageAddressee )
 {
-	String full = messageTokens.toString(); // this kind of sucks.
+	int numGreetingTokens;
+	int greetingNum;
+
+	CompilePhraseTables();
 
 	messageAddressee = "";
 
-	for (int i = 0; greetingTypes[i].text != NULL; ++i )
+	greetingNum = greetingTrie.matchPrefix( messageTokens, &numGreetingTokens );
+
+	// Ex: Hi Bob
+	if ( greetingNum != -1 && numGreetingTokens < messageTokens.getNumTokens() ) {
+		messageAddressee = messageTokens[numGreetingTokens];
+	}
+
+	return greetingNum;
+}
+
+// Returns the last token to match against, skipping ending punctuation.
+static int LastPhraseToken( const Lexer &tokens ) {
+	int last;
+
+	last = tokens.getNumTokens()-1;
+	if ( tokens[last] == "?" || tokens[last] == "!" || tokens[last] == "." )
 	{
-		if ( full.icompareTo( greetingTypes[i].text, strlen(greetingTypes[i].text) ) == 0 )
-		{
-			// Ex: Hi Bob
-			if ( greetingTypes[i].subjectStartToken < messageTokens.getNumTokens() ) {
-				messageAddressee = messageTokens[greetingTypes[i].subjectStartToken];
-			}
+		last--;
+	}
 
-			return i;
-		}
+	return last;
+}
+
+static int MatchStatement( const Lexer &tokens ) {
+	int last = LastPhraseToken( tokens );
+
+	if ( last < 0 ) {
+		return -1;
 	}
 
-	return -1;
-}
-
-struct statement_s {
-	const char	*msg, *reply;
-	bool		random;
-} statements[] = {
-	//{ "Yes", "No", true },
-	//{ "No", "Yes", true },
-	{ "Marco", "Polo", true },
-	{ "Thanks", "Don't mention it", false },
-	{ "Thank you", "Don't mention it", false },
-	{ "Dumb", "No you", false },
-	{ "Your stupid", "*You're stupid. >.>", false },
-	{ "You're stupid", "It's not my fault.", false },
-	{ "Your dumb", "*You're dumb. <.<", false },
-	{ "You're dumb", "It's not my fault.", false },
-	{ "Dummy", "It's not my fault.", false },
-	{ "Stupid", "It's not my fault.", false },
-	{ "make", "You need to quit before you can rebuild", false },
-	{ "Can I ask a question", "Don't ask to ask. Just ask your question.", false },
-	{ "Can I ask you a question", "Don't ask to ask. Just ask your question.", false },
-	{ NULL, NULL, false }
-};
+	return statementTrie.matchExact( tokens, 0, last );
+}
+
+void Persona::MatchRules( const Lexer &tokens, int &greetingNum, int &greetingTokens, int &statementNum )
+{
+	CompilePhraseTables();
 
-void Persona::think() {
+	greetingTokens = 0;
+	greetingNum = greetingTrie.matchPrefix( tokens, &greetingTokens );
+	statementNum = MatchStatement( tokens );
+}
+
+bool Persona::think( unsigned int maxMessages, double maxSeconds ) {
 	if ( !this->autoChat ) {
 		// TODO: drop messages and expectations?
-		return;
+		return false;
 	}
 
 	if ( getSleepTime() > 0 ) {
-		return;
+		return false;
 	}
 
-	// TODO: limit how fast to process messages?
+	double startTime = ClockSeconds();
 	size_t numMessages = this->messages.size();
+	size_t numProcessed = 0, numKept = 0, i;
+
+	// processed messages are removed by moving the rest down once at the end.
+	// replies are only delivered to other personas, so messages isn't changed by processMessage.
+	for ( i = 0; i < numMessages; i++ ) {
+		if ( maxMessages && numProcessed >= maxMessages ) {
+			break;
+		}
+
+		if ( maxSeconds > 0 && numProcessed > 0 && ClockSeconds() - startTime >= maxSeconds ) {
+			break;
+		}
 
-	for ( size_t i = 0; i < numMessages; /**/ ) {
-		if ( processMessage( this->messages[i] ) ) {
-			delete this->messages[i];
-			this->messages.erase( this->messages.begin() + i );
-			--numMessages;
+		Message *message = this->messages[i];
+
+		if ( processMessage( message ) ) {
+			double latency = ClockSeconds() - message->saidTime;
+
+			this->thinkStats.processed++;
+			this->thinkStats.totalLatency += latency;
+			this->thinkStats.latency.add( latency );
+			if ( latency > this->thinkStats.maxLatency ) {
+				this->thinkStats.maxLatency = latency;
+			}
+
+			message->release();
+			numProcessed++;
 		} else {
-			++i;
+			this->messages[numKept++] = message;
 		}
 	}
+
+	bool outOfBudget = ( i < numMessages );
+
+	for ( /**/; i < this->messages.size(); i++ ) {
+		this->messages[numKept++] = this->messages[i];
+	}
+
+	this->messages.resize( numKept );
+
+	if ( outOfBudget ) {
+		this->thinkStats.deferred++;
+	}
+
+	return outOfBudget;
+}
+
+void Persona::flush( unsigned int maxMessages ) {
+	if ( !this->autoChat ) {
+		return;
+	}
+
+	this->nextUpdateTime = 0;
+	think( maxMessages );
 }
 
 bool matchPrase( const Lexer &tokens, const String &expect ) {
-	int last;
+	int last = LastPhraseToken( tokens );
 
-	last = tokens.getNumTokens()-1;
-	if ( tokens[last] == "?" || tokens[last] == "!" || tokens[last] == "." )
-	{
-		last--;
+	if ( last < 0 ) {
+		return false;
 	}
 
-	if ( !tokens.toString( 0, last ).icompareTo( expect ) )
-		return true;
-
-	return false;
+	return tokens.matchTokens( Lexer( expect ), 0, last );
 }
 
 bool Persona::processMessage( Message *message )
 {
 	Conversation *con = message->con;
 	Persona *from = message->from;
-	String full( message->text );
-	int messageNum = message->messageNum;
-	String addressee = message->addressee;
-	bool isAddressedToAnyone = !addressee.icompareTo( "*anybody" );
-	bool isAddressedToMe = !this->nick.icompareTo( addressee ) || ( isAddressedToAnyone && con->numPersonas() == 2 );
+	bool isAddressedToAnyone = ( message->addressee == SYM_ANYBODY );
+	bool isAddressedToMe = ( message->addressee == this->nickSymbol ) || ( isAddressedToAnyone && con->numPersonas() == 2 );
 	bool isAddressee = ( isAddressedToAnyone || isAddressedToMe );
-	Lexer tokens( full );
 
-	// hmm... these message might be useful for learning about people.
-	// all this funtion does is reply so ignore messages not addressed to this bot for now.
+	// all this funtion does is reply so ignore messages not addressed to this bot.
+	// Conversation doesn't give them out, but the nick may have changed since.
+	// lines only mentioning this bot are in observed, they might be useful for learning about people.
 	if ( !isAddressee ) {
 		return true;
 	}
 
+	String full( message->text );
+	int messageNum = message->messageNum;
+	Lexer tokens( full );
+
 	if ( tokens[0] == this->nick ) {
 		bool tookAction = false;
 		bool enable = false;
@@ -281,12 +576,13 @@ bool Persona::processMessage( Message *message )
 			if ( tokens[2] == "fun" ) {
 				this->funReplies = enable;
 				tookAction = true;
+
+				if ( this->store )
+					this->store->savePersona( this );
 			}
 
 			if ( tookAction ) {
-				s.append( " " );
-				s.append( tokens.toString( 2 ) );
-				s.append( " as you requested." );
+				ReplyTemplate::Format( RT_TOGGLE_DONE, s, ReplyArgs().set( RS_TEXT, String( s ) ).set( RS_VALUE, tokens.toString( 2 ) ) );
 				con->addMessage( this, s );
 			} else {
 				con->addMessage( this, "Hmm? I don't understand" );
@@ -311,11 +607,7 @@ bool Persona::processMessage( Message *message )
 			}
 
 			if ( tookAction ) {
-				s.append( "Set " );
-				s.append( tokens[2] );
-				s.append( " to " );
-				s.append( tokens.toString( 3 ) );
-				s.append( " as you requested." );
+				ReplyTemplate::Format( RT_SET_DONE, s, ReplyArgs().set( RS_TEXT, tokens[2] ).set( RS_VALUE, tokens.toString( 3 ) ) );
 				con->addMessage( this, s );
 				return true;
 			} else {
@@ -347,8 +639,7 @@ bool Persona::processMessage( Message *message )
 	size_t numExp = this->expectations.size();
 	for ( size_t i = 0; i < numExp; /**/ ) {
 
-		// compare pointers
-		if ( this->expectations[i]->con == con && this->expectations[i]->from == from )
+		if ( this->expectations[i]->matches( con, from ) )
 		{
 			WaitReply waitReply = this->expectations[i]->waitForReply;
 			bool freeExp = true;
@@ -393,7 +684,7 @@ bool Persona::processMessage( Message *message )
 				} else if ( type & (WT_CANCEL_QUEST|WT_FILLER) ) {
 					con->addMessage( this, "Are you listening to me?" );
 					// mutate the expectation
-					this->expectations[i]->waitForReply = WR_LISTENING_TO_ME;
+					setExpectationWait( i, WR_LISTENING_TO_ME );
 					freeExp = false;
 				} else {
 					con->addMessage( this, "Guess not..." );
@@ -410,12 +701,12 @@ bool Persona::processMessage( Message *message )
 				} else if ( type & WT_TRUE ) {
 					con->addMessage( this, "Good, now answer my previous question." );
 					// mutate the expectation
-					this->expectations[i]->waitForReply = WR_AM_I_RIGHT; // HARD CODE HACK
+					setExpectationWait( i, WR_AM_I_RIGHT ); // HARD CODE HACK
 					freeExp = false;
 					return true;
 				} else if ( type & (WT_CANCEL_QUEST|WT_FILLER) ) {
-					String s(from->getNick());
-					s.append(", answer me.");
+					String s;
+					ReplyTemplate::Format( RT_ANSWER_ME, s, ReplyArgs().set( RS_NICK, from->getNick() ) );
 					con->addMessage( this, s );
 					// press harder! (don't release expectation)
 					freeExp = false;
@@ -434,8 +725,7 @@ bool Persona::processMessage( Message *message )
 			}
 
 			if ( freeExp ) {
-				delete this->expectations[i];
-				this->expectations.erase( this->expectations.begin() + i );
+				removeExpectation( i );
 				--numExp;
 			} else {
 				++i;
@@ -452,55 +742,60 @@ bool Persona::processMessage( Message *message )
 		}
 	}
 
-	for (int i = 0; statements[i].msg != NULL; ++i )
-	{
-		if ( matchPrase( tokens, statements[i].msg ) )
-		{
-			con->addMessage( this, statements[i].reply );
-			return true;
-		}
+	// rules were matched when the line was parsed, the same lines are said a lot
+	const ParsedLine *line = ParseCache::Lookup( full );
+	int statementNum = line->statementNum;
+	int greetingNum = line->greetingNum;
+	line->release();
+
+	if ( statementNum != -1 ) {
+		con->addMessage( this, statementRules[statementNum].reply );
+		return true;
 	}
 
-	// FIXME: bot doesn't actually care about greeting addressee here (but reuses code to get greeting num),
-	//		  Conversation::addMessage put addressee in message->addressee which improves handling a lot vs just deciding based on *this* message.
-	String greetingAddressee;
-	int greetingNum = GetGreetingAddressee( full, greetingAddressee );
+	// NOTE: bot doesn't care about greeting addressee here,
+	//		 Conversation::addMessage put addressee in message->addressee which improves handling a lot vs just deciding based on *this* message.
 	if ( greetingNum != -1 && !isAddressee ) {
 		// greeted someone else
 		return true;
 	}
 	else if ( greetingNum != -1 && isAddressee ) {
 		// greeted us or /everyone/
+		const WordData *words = WordData::Current();
+		int numGreetings = (int)words->getNumEntries( WL_GREETINGS );
 		int i = greetingNum;
-		bool bye = !!( greetingTypes[i].flags & GTF_BYE );
-		bool night = !!( greetingTypes[i].flags & GTF_NIGHT );
+		int flags = words->getInt( WL_GREETINGS, i, 1 );
+		bool bye = !!( flags & GTF_BYE );
+		bool night = !!( flags & GTF_NIGHT );
 
-		if ( ( greetingTypes[i].flags & GTF_SPECIAL ) && rand() & 1 ) {
+		if ( ( flags & GTF_SPECIAL ) && this->random.chance( 2 ) ) {
 			// repeat whatever they said, which could be a special greeting.
-			con->addMessage( this, greetingTypes[i].text );
+			con->addMessage( this, words->getString( WL_GREETINGS, i, 0 ) );
 		}
 		else
 		{
-			for ( int n = 0; n < ARRAY_LEN( greetingTypes ); n++ ) {
-				int r = rand() / (float)RAND_MAX * ARRAY_LEN( greetingTypes )-1;
-				if ( greetingTypes[r].flags & GTF_SPECIAL )
+			// one extra for repeating whatever greeting person said (including special ones).
+			for ( int n = 0; n < numGreetings + 1; n++ ) {
+				int r = this->random.range( numGreetings + 1 );
+				int rflags = words->getInt( WL_GREETINGS, r, 1 );
+				if ( rflags & GTF_SPECIAL )
 					continue;
-				if ( !!( greetingTypes[r].flags & GTF_NIGHT ) != night )
+				if ( !!( rflags & GTF_NIGHT ) != night )
 					continue;
-				if ( !!( greetingTypes[r].flags & GTF_BYE ) != bye )
+				if ( !!( rflags & GTF_BYE ) != bye )
 					continue;
 
 				String s;
+				const char *greeting;
 
-				if ( greetingTypes[r].text == NULL ) {
+				if ( r == numGreetings ) {
 					// repeat whatever they said, which could be a special greeting.
-					s = greetingTypes[i].text;
+					greeting = words->getString( WL_GREETINGS, i, 0 );
 				} else {
-					s = greetingTypes[r].text;
+					greeting = words->getString( WL_GREETINGS, r, 0 );
 				}
 
-				s.append( " " );
-				s.append( from->getNick() );
+				ReplyTemplate::Format( RT_GREETING, s, ReplyArgs().set( RS_TEXT, greeting ).set( RS_NICK, from->getNick() ) );
 				con->addMessage( this, s );
 				break;
 			}
@@ -510,7 +805,17 @@ bool Persona::processMessage( Message *message )
 	}
 
 
-	Sentence sentence( full.c_str() );
+	// use the conversation's parsed sentence if it's still in the history and the text wasn't changed above.
+	// copied as replying adds to the history.
+	const HistoryEntry *entry = con->getHistory().get( message->historyId );
+	Sentence sentence;
+
+	if ( entry && !entry->parsed->text.compareTo( full ) ) {
+		sentence = entry->parsed->sentence;
+	} else {
+		sentence.parse( full.c_str() );
+	}
+
 	for ( int i = 0; i < sentence.parts.size(); ++i )
 	{
 		// rename these!
@@ -593,9 +898,8 @@ bool Persona::processMessage( Message *message )
 						s.append( "That explains everything." );
 					}
 				} else {
-					s.append( "I don't know what " );
-					s.append( predicate.toString( predicateSkipFiller ) ); // skip filler words
-					s.append( " means, so maybe you are." );
+					// skip filler words
+					ReplyTemplate::Format( RT_I_AM, s, ReplyArgs().set( RS_PREDICATE, predicate.toString( predicateSkipFiller ) ) );
 				}
 
 				con->addMessage( this, s );
@@ -606,29 +910,30 @@ bool Persona::processMessage( Message *message )
 				//       instead of force all cases where there is a word after you to mineB
 				if ( meB && !hadPredicate ) {
 					String s;
+					String verb = linkingVerb[ linkSkipFiller ];
+					ReplyArgs args;
 
-					s.append( "I " );
-					s.append( linkingVerb[ linkSkipFiller ] );
-					s.append( " you too" );
+					args.set( RS_VERB, verb );
 					if ( function == SentencePart::SF_QUESTION ) {
-						s.append( "?" );
+						args.set( RS_END, "?" );
 					} else {
-						s.append( "." );
+						args.set( RS_END, "." );
 					}
 
-					if ( rand() % 3 == 0 ) {
-						s.append( " >_<" );
+					if ( this->random.chance( 3 ) ) {
+						args.set( RS_EXTRA, " >_<" );
 					}
 
+					ReplyTemplate::Format( RT_LIKE_ME, s, args );
+
 					con->addMessage( this, s );
 					return true;
 				} else if ( mineB || meB ) {
 					// Ex: I like your cat
 					// nothing after 'your'?
 					if ( !hadPredicate ) {
-						String s( "You ");
-						s.append( linkingVerb[ linkSkipFiller ] );
-						s.append( " my what?" );
+						String s;
+						ReplyTemplate::Format( RT_LIKE_MINE_WHAT, s, ReplyArgs().set( RS_VERB, linkingVerb[ linkSkipFiller ] ) );
 						con->addMessage( this, s );
 						// create expectation (save message text)
 						addExpectation( con, from, WR_COMPLETE_LAST, full );
@@ -639,11 +944,10 @@ bool Persona::processMessage( Message *message )
 						} else {
 							// Ex: I like your face
 							//if ( !complimentItem( tokens.toString( subject, last ) )) {
-								String s( "I might ");
-								s.append( linkingVerb[ linkSkipFiller ] );
-								s.append( " my " );
-								s.append( predicate.toString( predicateSkipFiller ) ); // skip filler words
-								s.append( " if I knew what it was." );
+								String s;
+								// skip filler words
+								ReplyTemplate::Format( RT_LIKE_MINE, s, ReplyArgs().set( RS_VERB, linkingVerb[ linkSkipFiller ] )
+															.set( RS_PREDICATE, predicate.toString( predicateSkipFiller ) ) );
 								con->addMessage( this, s );
 							//}
 						}
@@ -663,15 +967,11 @@ bool Persona::processMessage( Message *message )
 					if ( function == SentencePart::SF_QUESTION ) {
 						s.append( "I don't know." );
 					} else {
-						s.append( "/me gives " );
-						s.append( from->nick );
-						s.append( " " );
-						s.append( predicate.toString( predicateSkipFiller ) ); // skip filler words
-						s.append( " that " );
-						s.append( from->gender == GENDER_MALE ? "he" : "she" );
-						s.append( " " );
-						s.append( linkingVerb[ linkSkipFiller ] ); // like
-						s.append( "s" ); // append s to like (likes)
+						// skip filler words, template appends s to like (likes)
+						ReplyTemplate::Format( RT_LIKE_GIFT, s, ReplyArgs().set( RS_NICK, from->nick )
+													.set( RS_PREDICATE, predicate.toString( predicateSkipFiller ) )
+													.set( RS_PRONOUN, from->gender == GENDER_MALE ? "he" : "she" )
+													.set( RS_VERB, linkingVerb[ linkSkipFiller ] ) );
 					}
 
 					con->addMessage( this, s );
@@ -680,8 +980,18 @@ bool Persona::processMessage( Message *message )
 			}
 		}
 
-		// TODO: try to figure out subject from previous messages (by sender / this persona)
+		// Ex: The sky is blue. ... Is green?
 		if ( !hadSubject ) {
+			String recent;
+
+			if ( recentSubject( con, from, message->historyId, recent ) ) {
+				String s;
+				ReplyTemplate::Format( RT_RECENT_SUBJECT, s, ReplyArgs().set( RS_SUBJECT, recent ) );
+				con->addMessage( this, s );
+				addExpectation( con, from, WR_AM_I_RIGHT );
+				return true;
+			}
+
 			con->addMessage( this, "What are you talking about?" );
 			// create expectation (save message text)
 			addExpectation( con, from, WR_COMPLETE_LAST, full );
@@ -787,86 +1097,74 @@ bool Persona::processMessage( Message *message )
 
 		// The catch all case
 		// Ex: I was the turkey all along!
-		String s;
 		const bool cheekyResponse = ( this->funReplies && !( mine || mineB || me || meB ) );
+		const char *owner = NULL, *link = NULL;
+		String subjectText, predicateText;
+		ReplyArgs args;
+		ReplyId reply;
 
 		if ( cheekyResponse ) {
-			s = "Let's talk about me instead of";
-			if ( rand() % 3 == 0 ) {
-				s.append( " boring old" );
+			reply = RT_TALK_ABOUT_ME;
+			if ( this->random.chance( 3 ) ) {
+				args.set( RS_EXTRA, "boring old" );
 			}
-		} else {
+		} else if ( function == SentencePart::SF_QUESTION ) {
 			// Ask user if parsed subject correctly
-			if ( function == SentencePart::SF_QUESTION ) {
-				s = "Are you asking about";
-			} else {
-				s = "Are you talking about";
-			}
+			reply = RT_ASKING_ABOUT;
+		} else {
+			reply = RT_TALKING_ABOUT;
 		}
 
 		//
-		// Add subject
+		// Subject
 		//
 		if ( mine || ( me && !subject.isEmpty() ) ) {
-			s.append( " my" );
+			owner = "my";
 		} else if ( me ) {
-			s.append( " me" );
+			owner = "me";
 		} else if ( belongsToSender || ( sender && !subject.isEmpty() ) ) {
-			s.append( " your" );
+			owner = "your";
 		} else if ( sender ) {
-			s.append( " you" );
+			owner = "you";
 		} else if ( !predicate.isEmpty() && sentence.parts[i].linkingVerb == "is" && subjectSkipFiller == 0 ) { // if 'is' and no filler words.
-			s.append( ( predicate.toString() == "it" ) ? " the" : " a" );
+			owner = ( predicate.toString() == "it" ) ? "the" : "a";
 		}
 
 		if ( !subject.isEmpty() ) {
-			s.append( " " );
-			s.append( subject.toString( subjectSkipFiller ) ); // skip filler words
+			subjectText = subject.toString( subjectSkipFiller ); // skip filler words
 		}
 
 		//
-		// Add predicate
+		// Predicate
 		//
 		if ( meB ) {
-			s.append( " me" );
-			if ( !predicate.isEmpty() ) {
-				s.append( " being" );
-			}
+			link = predicate.isEmpty() ? "me" : "me being";
 		} else if ( mineB ) {
-			s.append( " my" );
+			link = "my";
 		} else if ( senderB ) {
-			s.append( " you" );
-			if ( !predicate.isEmpty() ) {
-				s.append( " being" );
-			}
+			link = predicate.isEmpty() ? "you" : "you being";
 		} else if ( belongsToSenderB ) {
-			s.append( " your" );
+			link = "your";
 		} else if ( !predicate.isEmpty() && !( me || mine || sender || belongsToSender ) ) {
-			s.append( " being" );
+			link = "being";
 		}
 
 		// Ex: What time is it?
 		// Ex: You are it?
 		if ( predicate.toString() == "it" ) {
 			// replace 'it' with...
-			if ( me || mine || sender || belongsToSender ) {
-				s.append( " being" );
-			} else {
-				s.append( " of" );
-			}
-			s.append( " something" );
+			predicateText = ( me || mine || sender || belongsToSender ) ? "being something" : "of something";
 		} else if ( !predicate.isEmpty() ) {
-			s.append( " " );
-			s.append( predicate.toString( predicateSkipFiller ) ); // skip filler words
+			predicateText = predicate.toString( predicateSkipFiller ); // skip filler words
 		}
 
-		if ( cheekyResponse ) {
-			s.append( "! :)" );
-			con->addMessage( this, s );
-		} else {
-			s.append( "?" );
-			con->addMessage( this, s );
+		String s;
+
+		args.set( RS_OWNER, owner ).set( RS_SUBJECT, subjectText ).set( RS_LINK, link ).set( RS_PREDICATE, predicateText );
+		ReplyTemplate::Format( reply, s, args );
+		con->addMessage( this, s );
 
+		if ( !cheekyResponse ) {
 			// create expectation (don't save message text)
 			addExpectation( con, from, WR_AM_I_RIGHT );
 		}
@@ -874,13 +1172,13 @@ bool Persona::processMessage( Message *message )
 	}
 
 	if ( isAddressedToMe && !didStatementGame && this->funReplies ) {
-		for ( int i = 0; i < ARRAY_LEN( statements ); i++ ) {
+		for ( size_t i = 0; i < statementRules.size(); i++ ) {
 			// fail to find anything to say, so just mess with them.
-			int st = rand() / (float)RAND_MAX * ARRAY_LEN( statements )-1;
-			if ( !statements[st].random )
+			int st = this->random.range( (int)statementRules.size() );
+			if ( !statementRules[st].random )
 				continue;
-			con->addMessage( this, statements[st].msg );
-			addExpectation( con, from, WR_SPECIFIED, statements[st].reply );
+			con->addMessage( this, statementRules[st].msg );
+			addExpectation( con, from, WR_SPECIFIED, statementRules[st].reply );
 			return true;
 		}
 	}
@@ -889,11 +1187,11 @@ bool Persona::processMessage( Message *message )
 		String s;
 
 		if ( !isAddressedToAnyone ) {
-			s.append( from->getNick() );
-			s.append( ", " );
+			ReplyTemplate::Format( RT_CANT_PARSE_ADDRESSED, s, ReplyArgs().set( RS_NICK, from->getNick() ) );
+		} else {
+			ReplyTemplate::Format( RT_CANT_PARSE, s, ReplyArgs() );
 		}
 
-		s.append( "I don't know how to parse that statement." );
 		con->addMessage( this, s );
 	}
 	return true;
@@ -902,11 +1200,63 @@ bool Persona::processMessage( Message *message )
 void Persona::addExpectation( Conversation *c, Persona *f, WaitReply wr )
 {
 	this->expectations.push_back( new Expectation( c, f, c->getMessageNum(), wr ) );
+
+	if ( this->store )
+		this->store->addExpectation( this, this->expectations.back() );
 }
 
 void Persona::addExpectation( Conversation *c, Persona *f, WaitReply wr, const String &str )
 {
 	this->expectations.push_back( new Expectation( c, f, c->getMessageNum(), wr, str ) );
+
+	if ( this->store )
+		this->store->addExpectation( this, this->expectations.back() );
+}
+
+void Persona::removeExpectation( size_t index )
+{
+	if ( this->store )
+		this->store->removeExpectation( this, this->expectations[index] );
+
+	delete this->expectations[index];
+	this->expectations.erase( this->expectations.begin() + index );
+}
+
+void Persona::setExpectationWait( size_t index, WaitReply wr )
+{
+	this->expectations[index]->waitForReply = wr;
+
+	if ( this->store )
+		this->store->updateExpectation( this, this->expectations[index] );
+}
+
+// Find what the sender was talking about in the last few lines.
+// Replies from personas aren't used as their subjects are usually from the message they replied to.
+bool Persona::recentSubject( Conversation *con, Persona *from, unsigned int historyId, String &subject )
+{
+	const HistoryEntry *entry = con->getHistory().findSpeakerSubject( from, historyId );
+
+	if ( !entry || historyId - entry->id > ConversationHistory::HISTORY_SIZE / 4 ) {
+		return false;
+	}
+
+	subject = entry->subject;
+	return true;
+}
+
+// compare pointers, or names for expectations restored by PersonaStore
+bool Expectation::matches( Conversation *c, Persona *f )
+{
+	if ( this->con == NULL && this->from == NULL ) {
+		if ( this->conName.isEmpty() || c->getName().icompareTo( this->conName ) || f->getNick().icompareTo( this->fromNick ) ) {
+			return false;
+		}
+
+		this->con = c;
+		this->from = f;
+	}
+
+	return ( this->con == c && this->from == f );
 }
 
 } // end namespace AngelCommunication
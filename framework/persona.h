@@ -27,6 +27,8 @@ freely, subject to the following restrictions:
 #include "string.h"
 #include "lexer.h"
 #include "conversation.h"
+#include "random.h"
+#include "metrics.h"
 
 namespace AngelCommunication
 {
@@ -49,29 +51,122 @@ enum WaitReply
 	WR_MAX
 };
 
+// what to drop when a persona's inbox is full
+enum InboxPolicy
+{
+	INBOX_DROP_OLDEST,			// oldest message
+	INBOX_COALESCE_SPEAKER,		// speaker's older message in the same conversation, they probably moved on
+	INBOX_PRIORITY_ADDRESSED,	// oldest message not addressed to this persona
+
+	INBOX_MAX
+};
+
+// names for config files, in enum order and ending with NULL
+extern const char * const GenderNames[];
+extern const char * const InboxPolicyNames[];
+
+class InboxStats
+{
+	public:
+		unsigned int	received;
+		unsigned int	dropped;	// removed without being processed, includes coalesced
+		unsigned int	coalesced;	// replaced by a newer message from the same speaker
+
+		InboxStats() : received( 0 ), dropped( 0 ), coalesced( 0 )
+		{
+		}
+};
+
+// processing latency is from when a message was said until it's processed,
+// including the delay before replying
+class ThinkStats
+{
+	public:
+		unsigned int	processed;
+		unsigned int	deferred;		// times think() ran out of budget with messages waiting
+		double			totalLatency;	// seconds
+		double			maxLatency;
+		Histogram		latency;
+
+		ThinkStats() : processed( 0 ), deferred( 0 ), totalLatency( 0 ), maxLatency( 0 )
+		{
+		}
+
+		double averageLatency() const
+		{
+			return processed ? totalLatency / processed : 0;
+		}
+};
+
 class Expectation;
 class Message;
 
+// a line that mentioned a persona without being addressed to it
+class Observation
+{
+	public:
+		Conversation	*con;
+		unsigned int	historyId;	// line in con's history
+};
+class PersonaStore;
+
 class Persona
 {
 	private:
 		bool   autoChat;
 		String nick;
+		int    nickSymbol;
 		String nickPossesive;
 		String fullName;
 		Gender gender;
 		bool funReplies;
 
 		std::vector<Expectation*> expectations; // expected reply information
-		std::vector<Message*> messages; // unprocessed messages
+		std::vector<Message*> messages; // unprocessed messages, each has a reference
+		size_t		inboxSize;		// max unprocessed messages
+		InboxPolicy	inboxPolicy;
+		InboxStats	inboxStats;
+		ThinkStats	thinkStats;
+
+		// lines mentioning this persona that weren't given to it, newest at (numObserved - 1) % OBSERVE_SIZE
+		static const size_t OBSERVE_SIZE = 8;
+		Observation	observed[OBSERVE_SIZE];
+		size_t		numObserved;
 
 		std::time_t nextUpdateTime;
+		Random random; // only used for this persona's replies, so replies can be reproduced
+
+		PersonaStore *store; // saves state changes, if set
+		std::vector<Conversation*> conversations; // conversations this persona is in, updated by Conversation
+
+		void observeMessage( Conversation *con, unsigned int historyId );
+		void forgetObserved( const Conversation *con );
+		void dropMessage( size_t index );
+		size_t findMessageToDrop( const Message *incoming ) const;
+		void removeExpectation( size_t index );
+		void setExpectationWait( size_t index, WaitReply wr );
+		bool recentSubject( Conversation *con, Persona *from, unsigned int historyId, String &subject );
+
+		friend class PersonaStore;
+		friend class Conversation;
+
+		// not copyable, conversations point to it
+		Persona( const Persona & );
+		Persona &operator=( const Persona & );
 
 	public:
+		static const size_t DEFAULT_INBOX_SIZE = 32;
+
 		Persona();
+		~Persona();
 
+		// 0 if there are messages ready, -1 if waiting for messages
 		float getSleepTime();
-		void think();
+
+		// process up to maxMessages or for about maxSeconds, 0 is no limit.
+		// returns true if messages are left for the next call.
+		bool think( unsigned int maxMessages = 0, double maxSeconds = 0 );
+		void flush( unsigned int maxMessages = 0 ); // process messages now ignoring the reply delay, 0 is all
 		bool processMessage( Message *message );
 
 		void tryNick( const String &name ); // try to rename
@@ -80,12 +175,24 @@ class Persona
 		void setFullName( const String &fullName );
 		void setGender( Gender gender );
 		void setAutoChat( bool autoChat );
+		void setRandomSeed( uint64_t seed, uint64_t stream );
+		void setInbox( size_t maxMessages, InboxPolicy policy );
+		const InboxStats &getInboxStats( void ) const;
+		const ThinkStats &getThinkStats( void ) const;
+		size_t getInboxCount( void ) const; // unprocessed messages
+		size_t getNumExpectations( void ) const;
+
+		static double ClockSeconds(); // steady clock for latency, not the time of day
+
+		// age 0 is the newest. NULL if there isn't one that old.
+		const Observation *getObserved( size_t age ) const;
 
 		const String &getNick( void ) const;
+		int getNickSymbol( void ) const;
 		const String &getFullName( void ) const;
 
 		// Conversation communication
-		void receiveMessage( Conversation *con, Persona *speaker, const String &text, int messageNum, const String &addressee );
+		void receiveMessage( Message *message );
 		void personaConnect( Conversation *con, Persona *persona );
 
 		void addExpectation( Conversation *c, Persona *f, WaitReply wr );
@@ -93,6 +200,8 @@ class Persona
 
 		// static functions
 		static int	GetGreetingAddressee( const Lexer &messageTokens, String &greetingAddressee );
+		static void	AddStatement( const String &msg, const String &reply, bool random );
+		static void	MatchRules( const Lexer &tokens, int &greetingNum, int &greetingTokens, int &statementNum ); // used by ParseCache
 };
 
 class Expectation
@@ -104,52 +213,81 @@ class Expectation
 		WaitReply		waitForReply;	// expectation type
 		String			expstr;			// varies by expectation type
 
+		// restored expectations don't have con and from until a message from them is seen
+		unsigned int	storeId;		// PersonaStore id, 0 if not stored
+		String			conName;
+		String			fromNick;
+
 		// NOTE: putting things in ": blah(b), blah(b)" list is magical,
 		//       just assigning vars doesn't work correct, causes con to be NULL and from to be wrong
 		//       when storing in a vector<type*>.
 		//       FIXME: Why???
 		Expectation( Conversation *c, Persona *f, int num, WaitReply wr )
-			: con( c ), from ( f ), messageNum( num ), waitForReply( wr ), expstr()
+			: con( c ), from ( f ), messageNum( num ), waitForReply( wr ), expstr(), storeId( 0 )
 		{
 		}
 
 		Expectation( Conversation *c, Persona *f, int num, WaitReply wr, const String &str )
-			: con( c ), from ( f ), messageNum( num ), waitForReply( wr ), expstr( str )
+			: con( c ), from ( f ), messageNum( num ), waitForReply( wr ), expstr( str ), storeId( 0 )
 		{
 		}
 
+		bool matches( Conversation *c, Persona *f );
+
 		Expectation operator=(const Expectation &e)
 		{
 			this->con = e.con;
 			this->from = e.from;
 			this->waitForReply = e.waitForReply;
 			this->expstr = e.expstr;
+			this->storeId = e.storeId;
+			this->conName = e.conName;
+			this->fromNick = e.fromNick;
 			return *this;
 		}
 };
 
+/*
+	Message class
+	A line said in a conversation. One is shared by all personas that receive
+	it, so it can't be changed after it's created. Use addRef() when keeping
+	a pointer to it and release() when done with it.
+*/
 class Message
 {
+	private:
+		int				refCount;
+
+		~Message() { }
+
+		// not copyable
+		Message( const Message & );
+		Message &operator=( const Message & );
+
 	public:
-		Conversation	*con;
-		Persona			*from;
-		String			text; // unprocessed message tokens.
-		int				messageNum;
-		String			addressee;
+		Conversation	*const con;
+		Persona			*const from;
+		const String	text; // unprocessed message tokens.
+		const int		messageNum;
+		const int		addressee;	// symbol of addressed persona's nick, SYM_ANYBODY, or SYM_NOBODY
+		const unsigned int historyId;	// line in con's history
+		const double	saidTime;	// Persona::ClockSeconds()
+
+		Message( Conversation *c, Persona *f, const String & t, int num, int a, unsigned int h )
+			: refCount( 1 ), con( c ), from( f ), text( t ), messageNum( num ), addressee( a ), historyId( h ),
+			saidTime( Persona::ClockSeconds() )
+		{
+		}
 
-		Message( Conversation *c, Persona *f, const String & t, int num, const String & a )
-			: con( c ), from( f ), text( t ), messageNum( num ), addressee( a )
+		void addRef()
 		{
+			this->refCount++;
 		}
 
-		Message operator=(const Message &m)
+		void release()
 		{
-			this->con = m.con;
-			this->from = m.from;
-			this->text = m.text;
-			this->messageNum = m.messageNum;
-			this->addressee = m.addressee;
-			return *this;
+			if ( --this->refCount == 0 )
+				delete this;
 		}
 };
 
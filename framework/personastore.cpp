@@ -0,0 +1,705 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <stdio.h> // fopen
+#include <cstring>
+#ifndef _WIN32
+#include <unistd.h> // fsync
+#endif
+
+#include "personastore.h"
+#include "persona.h"
+#include "mappedfile.h"
+#include "log.h"
+
+namespace AngelCommunication
+{
+
+/*
+	Log and snapshot records (native byte order)
+
+	record:		payloadSize, checksum, payload
+	payload:	sequence, type, key, type specific fields
+
+	Ints are 32-bit unsigned, strings are a length followed by the characters.
+	The snapshot file is "ANGS", version, sequence, followed by records for the
+	whole state. Log records with a sequence at or before the snapshot's are
+	already in the snapshot.
+*/
+#define PERSONASTORE_MAGIC		"ANGS"
+#define PERSONASTORE_VERSION	1
+
+enum StoreRecordType
+{
+	PSR_PERSONA = 1,		// nick, fullName, gender, funReplies
+	PSR_EXPECTATION,		// id, conName, fromNick, waitForReply, expstr (added or changed)
+	PSR_REMOVE_EXPECTATION	// id
+};
+
+static unsigned int Checksum( const char *data, size_t size )
+{
+	unsigned int hash = 2166136261u;
+
+	for ( size_t i = 0; i < size; i++ ) {
+		hash ^= (unsigned char)data[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static void PutInt( std::vector<char> &out, unsigned int value )
+{
+	const char *p = (const char *)&value;
+	out.insert( out.end(), p, p + sizeof ( value ) );
+}
+
+static void PutString( std::vector<char> &out, const String &str )
+{
+	PutInt( out, str.getLen() );
+	out.insert( out.end(), str.c_str(), str.c_str() + str.getLen() );
+}
+
+class RecordReader
+{
+	public:
+		const char	*p, *end;
+		bool		okay;
+
+		RecordReader( const char *data, size_t size ) : p( data ), end( data + size ), okay( true ) { }
+
+		unsigned int readInt()
+		{
+			unsigned int value = 0;
+
+			if ( end - p < (long)sizeof ( value ) ) {
+				okay = false;
+				return 0;
+			}
+
+			memcpy( &value, p, sizeof ( value ) );
+			p += sizeof ( value );
+			return value;
+		}
+
+		String readString()
+		{
+			unsigned int len = readInt();
+			std::vector<char> buf;
+
+			if ( !okay || (unsigned long)( end - p ) < len ) {
+				okay = false;
+				return String();
+			}
+
+			buf.assign( p, p + len );
+			buf.push_back( '\0' );
+			p += len;
+			return String( &buf[0] );
+		}
+};
+
+PersonaStore::StoredState::StoredState()
+	: sequence( 0 ), nextExpectationId( 1 )
+{
+}
+
+PersonaStore::StoredPersona *PersonaStore::StoredState::findPersona( const String &key, bool create )
+{
+	for ( size_t i = 0; i < this->personas.size(); i++ ) {
+		if ( !this->personas[i].key.compareTo( key ) ) {
+			return &this->personas[i];
+		}
+	}
+
+	if ( !create ) {
+		return NULL;
+	}
+
+	StoredPersona sp;
+
+	sp.key = key;
+	sp.hasState = false;
+	sp.gender = GENDER_NONE;
+	sp.funReplies = true;
+	sp.persona = NULL;
+
+	this->personas.push_back( sp );
+	return &this->personas.back();
+}
+
+/*
+	replay
+	Apply records to the stored state. Returns the size of the valid records,
+	a record cut off by a crash and anything after it is ignored.
+*/
+size_t PersonaStore::StoredState::replay( const char *data, size_t size, unsigned int minSequence )
+{
+	size_t offset = 0;
+
+	while ( size - offset >= 8 ) {
+		unsigned int payloadSize, checksum;
+
+		memcpy( &payloadSize, data + offset, sizeof ( payloadSize ) );
+		memcpy( &checksum, data + offset + 4, sizeof ( checksum ) );
+
+		if ( payloadSize > size - offset - 8 || Checksum( data + offset + 8, payloadSize ) != checksum ) {
+			break;
+		}
+
+		RecordReader reader( data + offset + 8, payloadSize );
+		unsigned int seq = reader.readInt();
+		unsigned int type = reader.readInt();
+		String key = reader.readString();
+
+		if ( !reader.okay ) {
+			break;
+		}
+
+		offset += 8 + payloadSize;
+
+		if ( seq > this->sequence ) {
+			this->sequence = seq;
+		}
+
+		if ( seq < minSequence ) {
+			continue;
+		}
+
+		StoredPersona *sp = findPersona( key, true );
+
+		if ( type == PSR_PERSONA ) {
+			String nick = reader.readString();
+			String fullName = reader.readString();
+			int gender = reader.readInt();
+			bool funReplies = !!reader.readInt();
+
+			if ( reader.okay ) {
+				sp->hasState = true;
+				sp->nick = nick;
+				sp->fullName = fullName;
+				sp->gender = gender;
+				sp->funReplies = funReplies;
+			}
+		} else if ( type == PSR_EXPECTATION || type == PSR_REMOVE_EXPECTATION ) {
+			StoredExpectation se;
+			size_t i;
+
+			se.id = reader.readInt();
+
+			if ( type == PSR_EXPECTATION ) {
+				se.conName = reader.readString();
+				se.fromNick = reader.readString();
+				se.waitForReply = reader.readInt();
+				se.expstr = reader.readString();
+			}
+
+			if ( !reader.okay ) {
+				continue;
+			}
+
+			if ( se.id >= this->nextExpectationId ) {
+				this->nextExpectationId = se.id + 1;
+			}
+
+			for ( i = 0; i < sp->expectations.size(); i++ ) {
+				if ( sp->expectations[i].id == se.id ) {
+					break;
+				}
+			}
+
+			if ( type == PSR_REMOVE_EXPECTATION ) {
+				if ( i < sp->expectations.size() ) {
+					sp->expectations.erase( sp->expectations.begin() + i );
+				}
+			} else if ( i < sp->expectations.size() ) {
+				sp->expectations[i] = se;
+			} else {
+				sp->expectations.push_back( se );
+			}
+		}
+	}
+
+	return offset;
+}
+
+PersonaStore::PersonaStore()
+	: opened( false ), log( NULL ), logSize( 0 ), stopWriter( false )
+{
+}
+
+PersonaStore::~PersonaStore()
+{
+	close();
+}
+
+PersonaStore::StoredPersona *PersonaStore::findPersona( const Persona *persona )
+{
+	for ( size_t i = 0; i < this->state.personas.size(); i++ ) {
+		if ( this->state.personas[i].persona == persona ) {
+			return &this->state.personas[i];
+		}
+	}
+
+	return NULL;
+}
+
+void PersonaStore::beginRecord( std::vector<char> &out, int type, const String &key )
+{
+	PutInt( out, 0 ); // payload size
+	PutInt( out, 0 ); // checksum
+	PutInt( out, ( &out == &this->pending ) ? ++this->state.sequence : 0 );
+	PutInt( out, type );
+	PutString( out, key );
+}
+
+void PersonaStore::endRecord( std::vector<char> &out, size_t start )
+{
+	unsigned int size = (unsigned int)( out.size() - start - 8 );
+	unsigned int checksum = Checksum( &out[start + 8], size );
+
+	memcpy( &out[start], &size, sizeof ( size ) );
+	memcpy( &out[start + 4], &checksum, sizeof ( checksum ) );
+}
+
+void PersonaStore::writePersonaRecord( std::vector<char> &out, const StoredPersona &sp )
+{
+	size_t start = out.size();
+
+	beginRecord( out, PSR_PERSONA, sp.key );
+	PutString( out, sp.nick );
+	PutString( out, sp.fullName );
+	PutInt( out, sp.gender );
+	PutInt( out, sp.funReplies );
+	endRecord( out, start );
+}
+
+void PersonaStore::writeExpectationRecord( std::vector<char> &out, const StoredPersona &sp, const StoredExpectation &se )
+{
+	size_t start = out.size();
+
+	beginRecord( out, PSR_EXPECTATION, sp.key );
+	PutInt( out, se.id );
+	PutString( out, se.conName );
+	PutString( out, se.fromNick );
+	PutInt( out, se.waitForReply );
+	PutString( out, se.expstr );
+	endRecord( out, start );
+}
+
+bool PersonaStore::open( const char *path )
+{
+	MappedFile file;
+	String snapName( path ), logName( path );
+	unsigned int snapSequence = 0;
+	size_t validSize;
+
+	close();
+
+	this->path = path;
+	snapName.append( ".snap" );
+	logName.append( ".log" );
+
+	if ( file.open( snapName.c_str() ) && file.getSize() > 0 ) {
+		const char *data = file.getData();
+		unsigned int version = 0;
+
+		if ( file.getSize() >= 12 ) {
+			memcpy( &version, data + 4, sizeof ( version ) );
+			memcpy( &snapSequence, data + 8, sizeof ( snapSequence ) );
+		}
+
+		if ( file.getSize() < 12 || memcmp( data, PERSONASTORE_MAGIC, 4 ) || version != PERSONASTORE_VERSION ) {
+			Log::Printf( LOG_WARNING, "store", "WARNING: %s is not a persona snapshot", snapName.c_str() );
+			this->state = StoredState();
+			return false;
+		}
+
+		this->state.replay( data + 12, file.getSize() - 12, 0 );
+		this->state.sequence = snapSequence;
+	}
+
+	if ( file.open( logName.c_str() ) ) {
+		validSize = this->state.replay( file.getData(), file.getSize(), snapSequence + 1 );
+
+		if ( validSize != file.getSize() ) {
+			// drop the partial record so new records are appended after valid ones
+			std::vector<char> valid( file.getData(), file.getData() + validSize );
+			FILE *f;
+
+			Log::Printf( LOG_WARNING, "store", "WARNING: Ignoring %d bytes at end of %s", (int)( file.getSize() - validSize ), logName.c_str() );
+
+			file.close();
+			f = fopen( logName.c_str(), "wb" );
+			if ( f ) {
+				if ( !valid.empty() ) {
+					fwrite( &valid[0], 1, valid.size(), f );
+				}
+				fclose( f );
+			}
+		}
+
+		this->logSize = validSize;
+		file.close();
+	}
+
+	this->log = fopen( logName.c_str(), "ab" );
+	if ( !this->log ) {
+		Log::Printf( LOG_WARNING, "store", "WARNING: Failed to open %s for writing", logName.c_str() );
+		this->state = StoredState();
+		this->logSize = 0;
+		return false;
+	}
+
+	// nothing is attached yet, so the copy doesn't point at any personas
+	this->written = this->state;
+	this->stopWriter = false;
+	this->writer = std::thread( &PersonaStore::writerThread, this );
+	this->opened = true;
+
+	Log::Printf( LOG_INFO, "store", "Opened persona store %s (%d personas)", path, (int)this->state.personas.size() );
+	return true;
+}
+
+void PersonaStore::close()
+{
+	if ( !this->opened ) {
+		return;
+	}
+
+	update();
+
+	{
+		std::lock_guard<std::mutex> lock( this->queueMutex );
+		this->stopWriter = true;
+	}
+	this->wake.notify_one();
+	this->writer.join();
+
+	for ( size_t i = 0; i < this->state.personas.size(); i++ ) {
+		if ( this->state.personas[i].persona ) {
+			this->state.personas[i].persona->store = NULL;
+		}
+	}
+
+	if ( this->log ) {
+		fclose( this->log );
+		this->log = NULL;
+	}
+	this->logSize = 0;
+	this->opened = false;
+	this->state = StoredState();
+	this->written = StoredState();
+	this->pending.clear();
+}
+
+bool PersonaStore::isOpen() const
+{
+	return this->opened;
+}
+
+void PersonaStore::attach( Persona *persona, const String &key )
+{
+	StoredPersona *sp;
+
+	if ( !this->opened ) {
+		return;
+	}
+
+	sp = this->state.findPersona( key, true );
+	sp->persona = persona;
+
+	// don't save changes while restoring
+	persona->store = NULL;
+
+	if ( sp->hasState ) {
+		persona->updateNick( sp->nick );
+		persona->setFullName( sp->fullName );
+		persona->setGender( (Gender)sp->gender );
+		persona->funReplies = sp->funReplies;
+
+		for ( size_t i = 0; i < sp->expectations.size(); i++ ) {
+			const StoredExpectation &se = sp->expectations[i];
+			Expectation *exp = new Expectation( NULL, NULL, 0, (WaitReply)se.waitForReply, se.expstr );
+
+			// conversation and persona are found by name when they're next seen
+			exp->storeId = se.id;
+			exp->conName = se.conName;
+			exp->fromNick = se.fromNick;
+			persona->expectations.push_back( exp );
+		}
+	}
+
+	persona->store = this;
+
+	if ( !sp->hasState ) {
+		savePersona( persona );
+	}
+}
+
+void PersonaStore::detach( Persona *persona )
+{
+	StoredPersona *sp = findPersona( persona );
+
+	if ( sp ) {
+		sp->persona = NULL;
+	}
+
+	persona->store = NULL;
+}
+
+/*
+	update
+	Give the records from all changes since the last update to the writer
+	thread. They're written together, along with any from earlier updates the
+	writer thread hasn't gotten to yet.
+*/
+void PersonaStore::update()
+{
+	if ( !this->opened || this->pending.empty() ) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock( this->queueMutex );
+
+		if ( this->queued.empty() ) {
+			this->queued.swap( this->pending );
+		} else {
+			this->queued.insert( this->queued.end(), this->pending.begin(), this->pending.end() );
+		}
+	}
+
+	this->pending.clear();
+	this->wake.notify_one();
+}
+
+void PersonaStore::writerThread()
+{
+	std::vector<char> records;
+
+	while ( 1 ) {
+		bool stopping;
+
+		{
+			std::unique_lock<std::mutex> lock( this->queueMutex );
+
+			while ( this->queued.empty() && !this->stopWriter ) {
+				this->wake.wait( lock );
+			}
+
+			// close() queues its last records before stopping, so they're taken here too
+			records.swap( this->queued );
+			stopping = this->stopWriter;
+		}
+
+		if ( !records.empty() ) {
+			writeRecords( records );
+			records.clear();
+		}
+
+		if ( stopping ) {
+			break;
+		}
+	}
+}
+
+void PersonaStore::writeRecords( const std::vector<char> &records )
+{
+	this->written.replay( &records[0], records.size(), 0 );
+
+	// log couldn't be reopened after the last snapshot, these records only get saved by a new snapshot
+	if ( !this->log ) {
+		snapshot();
+		return;
+	}
+
+	if ( fwrite( &records[0], 1, records.size(), this->log ) != records.size() ) {
+		Log::Write( LOG_WARNING, "store", "WARNING: Failed to write to persona store log" );
+	}
+	fflush( this->log );
+#ifndef _WIN32
+	fsync( fileno( this->log ) );
+#endif
+
+	this->logSize += records.size();
+
+	if ( this->logSize >= SNAPSHOT_LOG_SIZE ) {
+		snapshot();
+	}
+}
+
+/*
+	snapshot
+	Write the state as of the last written record to the snapshot file and
+	start a new log. Called by the writer thread.
+*/
+bool PersonaStore::snapshot()
+{
+	std::vector<char> out;
+	String snapName( this->path ), tempName, logName( this->path );
+	FILE *f;
+
+	snapName.append( ".snap" );
+	tempName = snapName;
+	tempName.append( ".tmp" );
+	logName.append( ".log" );
+
+	out.insert( out.end(), PERSONASTORE_MAGIC, PERSONASTORE_MAGIC + 4 );
+	PutInt( out, PERSONASTORE_VERSION );
+	PutInt( out, this->written.sequence );
+
+	for ( size_t i = 0; i < this->written.personas.size(); i++ ) {
+		const StoredPersona &sp = this->written.personas[i];
+
+		if ( !sp.hasState ) {
+			continue;
+		}
+
+		writePersonaRecord( out, sp );
+
+		for ( size_t e = 0; e < sp.expectations.size(); e++ ) {
+			writeExpectationRecord( out, sp, sp.expectations[e] );
+		}
+	}
+
+	f = fopen( tempName.c_str(), "wb" );
+	if ( !f ) {
+		Log::Printf( LOG_WARNING, "store", "WARNING: Failed to open %s for writing", tempName.c_str() );
+		return false;
+	}
+
+	bool okay = ( fwrite( &out[0], 1, out.size(), f ) == out.size() );
+	fflush( f );
+#ifndef _WIN32
+	fsync( fileno( f ) );
+#endif
+	fclose( f );
+
+#ifdef _WIN32
+	remove( snapName.c_str() ); // rename doesn't replace files on Windows
+#endif
+	if ( !okay || rename( tempName.c_str(), snapName.c_str() ) != 0 ) {
+		Log::Printf( LOG_WARNING, "store", "WARNING: Failed to write %s", snapName.c_str() );
+		remove( tempName.c_str() );
+		return false;
+	}
+
+	// written records are in the snapshot
+	if ( this->log ) {
+		fclose( this->log );
+	}
+	this->log = fopen( logName.c_str(), "wb" );
+	this->logSize = 0;
+
+	if ( !this->log ) {
+		Log::Printf( LOG_WARNING, "store", "WARNING: Failed to open %s for writing", logName.c_str() );
+		return false;
+	}
+
+	return true;
+}
+
+void PersonaStore::savePersona( const Persona *persona )
+{
+	StoredPersona *sp = findPersona( persona );
+
+	if ( !sp ) {
+		return;
+	}
+
+	sp->hasState = true;
+	sp->nick = persona->nick;
+	sp->fullName = persona->fullName;
+	sp->gender = persona->gender;
+	sp->funReplies = persona->funReplies;
+
+	writePersonaRecord( this->pending, *sp );
+}
+
+void PersonaStore::addExpectation( const Persona *persona, Expectation *exp )
+{
+	StoredPersona *sp = findPersona( persona );
+	StoredExpectation se;
+
+	if ( !sp ) {
+		return;
+	}
+
+	se.conName = exp->con ? exp->con->getName() : exp->conName;
+	se.fromNick = exp->from ? exp->from->getNick() : exp->fromNick;
+
+	// can't find the conversation again after restarting
+	if ( se.conName.isEmpty() ) {
+		return;
+	}
+
+	se.id = this->state.nextExpectationId++;
+	se.waitForReply = exp->waitForReply;
+	se.expstr = exp->expstr;
+
+	exp->storeId = se.id;
+	sp->expectations.push_back( se );
+
+	writeExpectationRecord( this->pending, *sp, se );
+}
+
+void PersonaStore::updateExpectation( const Persona *persona, const Expectation *exp )
+{
+	StoredPersona *sp = findPersona( persona );
+
+	if ( !sp || !exp->storeId ) {
+		return;
+	}
+
+	for ( size_t i = 0; i < sp->expectations.size(); i++ ) {
+		if ( sp->expectations[i].id == exp->storeId ) {
+			sp->expectations[i].waitForReply = exp->waitForReply;
+			writeExpectationRecord( this->pending, *sp, sp->expectations[i] );
+			return;
+		}
+	}
+}
+
+void PersonaStore::removeExpectation( const Persona *persona, const Expectation *exp )
+{
+	StoredPersona *sp = findPersona( persona );
+
+	if ( !sp || !exp->storeId ) {
+		return;
+	}
+
+	for ( size_t i = 0; i < sp->expectations.size(); i++ ) {
+		if ( sp->expectations[i].id == exp->storeId ) {
+			size_t start = this->pending.size();
+
+			beginRecord( this->pending, PSR_REMOVE_EXPECTATION, sp->key );
+			PutInt( this->pending, exp->storeId );
+			endRecord( this->pending, start );
+
+			sp->expectations.erase( sp->expectations.begin() + i );
+			return;
+		}
+	}
+}
+
+} // end namespace AngelCommunication
@@ -0,0 +1,149 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ANGEL_PERSONASTORE_INCLUDED
+#define ANGEL_PERSONASTORE_INCLUDED
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "string.h"
+
+namespace AngelCommunication
+{
+
+class Persona;
+class Expectation;
+
+/*
+	PersonaStore class
+	Saves persona state (name, gender, settings, and expectations) so it
+	persists when the program is restarted.
+
+	Changes are appended to a log file (<path>.log). Records are buffered in
+	memory and update() hands them to a writer thread, which writes and syncs
+	them together, so replying never waits on the disk. The writer thread
+	keeps its own copy of the state from the records it has written; when the
+	log gets large it writes that to a snapshot (<path>.snap) and starts the
+	log over.
+*/
+class PersonaStore
+{
+	private:
+		class StoredExpectation
+		{
+			public:
+				unsigned int	id;
+				String			conName;
+				String			fromNick;
+				int				waitForReply;
+				String			expstr;
+		};
+
+		class StoredPersona
+		{
+			public:
+				String			key;
+				bool			hasState;
+				String			nick;
+				String			fullName;
+				int				gender;
+				bool			funReplies;
+				std::vector<StoredExpectation> expectations;
+				Persona			*persona;
+		};
+
+		class StoredState
+		{
+			public:
+				unsigned int	sequence;		// last record
+				unsigned int	nextExpectationId;
+				std::vector<StoredPersona> personas;
+
+				StoredState();
+
+				StoredPersona *findPersona( const String &key, bool create );
+				size_t replay( const char *data, size_t size, unsigned int minSequence );
+		};
+
+		String			path;
+		bool			opened;
+		StoredState		state;
+		std::vector<char> pending;		// records since the last update
+
+		// used by the writer thread
+		FILE			*log;
+		size_t			logSize;
+		StoredState		written;		// state as of the last record written to the log
+
+		std::thread		writer;
+		std::mutex		queueMutex;
+		std::condition_variable wake;
+		std::vector<char> queued;		// records waiting to be written, guarded by queueMutex
+		bool			stopWriter;		// guarded by queueMutex
+
+		StoredPersona *findPersona( const Persona *persona );
+
+		void beginRecord( std::vector<char> &out, int type, const String &key );
+		void endRecord( std::vector<char> &out, size_t start );
+		void writePersonaRecord( std::vector<char> &out, const StoredPersona &sp );
+		void writeExpectationRecord( std::vector<char> &out, const StoredPersona &sp, const StoredExpectation &se );
+
+		void writerThread();
+		void writeRecords( const std::vector<char> &records );
+		bool snapshot();
+
+		// not copyable
+		PersonaStore( const PersonaStore & );
+		PersonaStore &operator=( const PersonaStore & );
+
+	public:
+		// after the log is this large it's replaced by a snapshot
+		static const size_t SNAPSHOT_LOG_SIZE = 256 * 1024;
+
+		PersonaStore();
+		~PersonaStore();
+
+		bool open( const char *path );
+		void close(); // writes all changes and waits for the writer thread
+		bool isOpen() const;
+
+		// Restore saved state to persona and save changes to it from now on.
+		void attach( Persona *persona, const String &key );
+		void detach( Persona *persona );
+
+		// queue changes since the last update to be written
+		void update();
+
+		// called by Persona when state changes
+		void savePersona( const Persona *persona );
+		void addExpectation( const Persona *persona, Expectation *exp );
+		void updateExpectation( const Persona *persona, const Expectation *exp );
+		void removeExpectation( const Persona *persona, const Expectation *exp );
+};
+
+} // end namespace AngelCommunication
+
+#endif // ANGEL_PERSONASTORE_INCLUDED
@@ -0,0 +1,161 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <algorithm>
+
+#include "phrasetrie.h"
+
+namespace AngelCommunication
+{
+
+PhraseTrie::PhraseTrie()
+{
+	clear();
+}
+
+void PhraseTrie::clear()
+{
+	this->nodes.clear();
+	this->nodes.push_back( Node() ); // root
+	this->numPhrases = 0;
+}
+
+// FNV-1a over ASCII lower case characters
+unsigned int PhraseTrie::HashToken( const char *token )
+{
+	return String::FoldHash( token );
+}
+
+bool PhraseTrie::EdgeHashLess( const Edge &edge, unsigned int hash )
+{
+	return edge.hash < hash;
+}
+
+int PhraseTrie::findChild( int node, const char *token ) const
+{
+	const std::vector<Edge> &edges = this->nodes[node].edges;
+	unsigned int hash = HashToken( token );
+
+	std::vector<Edge>::const_iterator it = std::lower_bound( edges.begin(), edges.end(), hash, EdgeHashLess );
+
+	// multiple tokens may have the same hash
+	for ( ; it != edges.end() && it->hash == hash; ++it ) {
+		if ( !it->token.icompareTo( token ) ) {
+			return it->child;
+		}
+	}
+
+	return -1;
+}
+
+/*
+	addPhrase
+	Returns false if phrase has no tokens. If phrase was already added, the
+	first value is kept so earlier rules take priority.
+*/
+bool PhraseTrie::addPhrase( const String &phrase, int value )
+{
+	Lexer tokens( phrase );
+	int node = 0;
+
+	if ( tokens.isEmpty() ) {
+		return false;
+	}
+
+	for ( unsigned int i = 0; i < tokens.getNumTokens(); ++i ) {
+		const char *token = tokens.getTokenText( i );
+		int child = findChild( node, token );
+
+		if ( child == -1 ) {
+			Edge edge;
+
+			child = (int)this->nodes.size();
+			this->nodes.push_back( Node() );
+
+			edge.hash = HashToken( token );
+			edge.token = token;
+			edge.child = child;
+
+			std::vector<Edge> &edges = this->nodes[node].edges;
+			edges.insert( std::lower_bound( edges.begin(), edges.end(), edge.hash, EdgeHashLess ), edge );
+		}
+
+		node = child;
+	}
+
+	if ( this->nodes[node].value == -1 ) {
+		this->nodes[node].value = value;
+		this->numPhrases++;
+	}
+
+	return true;
+}
+
+size_t PhraseTrie::getNumPhrases() const
+{
+	return this->numPhrases;
+}
+
+int PhraseTrie::matchPrefix( const Lexer &tokens, int *numMatchedTokens ) const
+{
+	int node = 0;
+	int value = -1;
+	int matched = 0;
+
+	for ( unsigned int i = 0; i < tokens.getNumTokens(); ++i ) {
+		node = findChild( node, tokens.getTokenText( i ) );
+
+		if ( node == -1 )
+			break;
+
+		if ( this->nodes[node].value != -1 ) {
+			value = this->nodes[node].value;
+			matched = i + 1;
+		}
+	}
+
+	if ( numMatchedTokens ) {
+		*numMatchedTokens = matched;
+	}
+
+	return value;
+}
+
+int PhraseTrie::matchExact( const Lexer &tokens, unsigned int first, unsigned int last ) const
+{
+	int node = 0;
+
+	if ( first > last || last >= tokens.getNumTokens() ) {
+		return -1;
+	}
+
+	for ( unsigned int i = first; i <= last; ++i ) {
+		node = findChild( node, tokens.getTokenText( i ) );
+
+		if ( node == -1 )
+			return -1;
+	}
+
+	return this->nodes[node].value;
+}
+
+} // end namespace AngelCommunication
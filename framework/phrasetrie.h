@@ -0,0 +1,84 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ANGEL_PHRASETRIE_INCLUDED
+#define ANGEL_PHRASETRIE_INCLUDED
+
+#include <vector>
+
+#include "string.h"
+#include "lexer.h"
+
+namespace AngelCommunication
+{
+
+/*
+	PhraseTrie class
+	Phrases are split into tokens (using Lexer) and stored in a tree where each
+	edge is one case-insensitive token. A whole rule table can then be matched
+	in one pass over a message's tokens without joining them into a string.
+*/
+class PhraseTrie
+{
+	private:
+		class Edge
+		{
+			public:
+				unsigned int	hash;	// case-folded hash of token
+				String			token;
+				int				child;
+		};
+
+		class Node
+		{
+			public:
+				std::vector<Edge>	edges;	// sorted by hash
+				int					value;	// phrase ending at this node, -1 if none
+
+				Node() : value( -1 ) { }
+		};
+
+		std::vector<Node> nodes;
+		size_t numPhrases;
+
+		int findChild( int node, const char *token ) const;
+		static bool EdgeHashLess( const Edge &edge, unsigned int hash );
+
+	public:
+		PhraseTrie();
+
+		void clear();
+		bool addPhrase( const String &phrase, int value );
+		size_t getNumPhrases() const;
+
+		// Longest phrase that tokens begin with. Returns -1 if none match.
+		int matchPrefix( const Lexer &tokens, int *numMatchedTokens = NULL ) const;
+
+		// Phrase that is exactly tokens first through last. Returns -1 if none match.
+		int matchExact( const Lexer &tokens, unsigned int first, unsigned int last ) const;
+
+		static unsigned int HashToken( const char *token );
+};
+
+} // end namespace AngelCommunication
+
+#endif // ANGEL_PHRASETRIE_INCLUDED
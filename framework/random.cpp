@@ -0,0 +1,98 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "random.h"
+
+namespace AngelCommunication
+{
+
+// http://prng.di.unimi.it/ xoshiro128** and splitmix64 (public domain)
+
+static uint64_t SplitMix64( uint64_t &x )
+{
+	uint64_t z = ( x += 0x9E3779B97F4A7C15ULL );
+	z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+	z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+	return z ^ ( z >> 31 );
+}
+
+static inline uint32_t RotateLeft( uint32_t x, int k )
+{
+	return ( x << k ) | ( x >> ( 32 - k ) );
+}
+
+Random::Random()
+{
+	seed( 0 );
+}
+
+void Random::seed( uint64_t seed, uint64_t stream )
+{
+	uint64_t x = seed ^ SplitMix64( stream );
+	uint64_t a = SplitMix64( x );
+	uint64_t b = SplitMix64( x );
+
+	this->state[0] = (uint32_t)a;
+	this->state[1] = (uint32_t)( a >> 32 );
+	this->state[2] = (uint32_t)b;
+	this->state[3] = (uint32_t)( b >> 32 );
+
+	// all zero state would only ever return 0
+	if ( !( this->state[0] | this->state[1] | this->state[2] | this->state[3] ) ) {
+		this->state[0] = 1;
+	}
+}
+
+uint32_t Random::next()
+{
+	uint32_t *s = this->state;
+	const uint32_t result = RotateLeft( s[1] * 5, 7 ) * 9;
+	const uint32_t t = s[1] << 9;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+
+	s[2] ^= t;
+
+	s[3] = RotateLeft( s[3], 11 );
+
+	return result;
+}
+
+// multiply and shift instead of modulus, bias is too small to matter for n this size
+int Random::range( int n )
+{
+	if ( n <= 0 ) {
+		return 0;
+	}
+
+	return (int)( ( (uint64_t)next() * (uint32_t)n ) >> 32 );
+}
+
+bool Random::chance( int n )
+{
+	return range( n ) == 0;
+}
+
+} // end namespace AngelCommunication
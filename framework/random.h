@@ -0,0 +1,55 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ANGEL_RANDOM_INCLUDED
+#define ANGEL_RANDOM_INCLUDED
+
+#include <stdint.h>
+
+namespace AngelCommunication
+{
+
+/*
+	Random class
+	xoshiro128** pseudo random number generator. It's small and fast, and
+	each Persona has its own so the replies only depend on the seed and the
+	messages received, not on anything else using rand().
+*/
+class Random
+{
+	private:
+		uint32_t state[4];
+
+	public:
+		Random();
+
+		// different streams with the same seed give unrelated numbers
+		void seed( uint64_t seed, uint64_t stream = 0 );
+
+		uint32_t next();
+		int range( int n );		// 0 to n-1
+		bool chance( int n );	// true one in n times
+};
+
+} // end namespace AngelCommunication
+
+#endif // ANGEL_RANDOM_INCLUDED
@@ -0,0 +1,174 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "replaylog.h"
+
+namespace AngelCommunication
+{
+
+ReplayLog::ReplayLog() : file( NULL ), writing( false ), lineNum( 0 )
+{
+}
+
+ReplayLog::~ReplayLog()
+{
+	close();
+}
+
+bool ReplayLog::open( const char *filename, bool write )
+{
+	close();
+
+	this->file = fopen( filename, write ? "a" : "r" );
+	this->writing = write;
+	this->lineNum = 0;
+
+	return ( this->file != NULL );
+}
+
+void ReplayLog::close()
+{
+	if ( this->file ) {
+		fclose( this->file );
+		this->file = NULL;
+	}
+}
+
+bool ReplayLog::isOpen() const
+{
+	return ( this->file != NULL );
+}
+
+void ReplayLog::write( const String &event )
+{
+	if ( !this->file || !this->writing ) {
+		return;
+	}
+
+	fprintf( this->file, "%s\n", event.c_str() );
+	fflush( this->file );
+}
+
+void ReplayLog::writeThink( const ThinkScheduler &scheduler )
+{
+	const std::vector<ThinkTurn> &turns = scheduler.getLastTurns();
+
+	if ( turns.empty() ) {
+		return;
+	}
+
+	String event( "think" );
+
+	for ( size_t i = 0; i < turns.size(); i++ ) {
+		event.appendValues( ' ', turns[i].entry, ':', turns[i].processed );
+	}
+
+	write( event );
+}
+
+bool ReplayLog::read( String &event, String &fields )
+{
+	String line;
+	int ch;
+
+	if ( !this->file || this->writing ) {
+		return false;
+	}
+
+	// skip empty lines
+	while ( line.isEmpty() ) {
+		ch = getc( this->file );
+
+		if ( ch == EOF ) {
+			return false;
+		}
+
+		this->lineNum++;
+
+		for ( ; ch != EOF && ch != '\n'; ch = getc( this->file ) ) {
+			if ( ch != '\r' ) {
+				line.append( (char)ch );
+			}
+		}
+	}
+
+	const char *p = line.c_str();
+
+	event = NextField( p );
+	fields = p;
+	return true;
+}
+
+unsigned int ReplayLog::getLineNum() const
+{
+	return this->lineNum;
+}
+
+String ReplayLog::NextField( const char *&fields )
+{
+	const char *end = strchr( fields, ' ' );
+	String field;
+
+	if ( !end ) {
+		end = fields + strlen( fields );
+	}
+
+	if ( end > fields ) {
+		memcpy( field.getBuffer( (unsigned int)( end - fields ) ), fields, end - fields );
+	}
+
+	fields = ( *end == ' ' ) ? end + 1 : end;
+	return field;
+}
+
+bool ReplayLog::ReplayThink( ThinkScheduler &scheduler, const String &fields )
+{
+	std::vector<ThinkTurn> turns;
+	const char *p = fields.c_str();
+
+	while ( *p ) {
+		ThinkTurn turn;
+		char *end;
+
+		turn.entry = (unsigned int)strtoul( p, &end, 10 );
+		if ( end == p || *end != ':' ) {
+			return false;
+		}
+
+		p = end + 1;
+		turn.processed = (unsigned int)strtoul( p, &end, 10 );
+		if ( end == p || turn.processed == 0 || ( *end != ' ' && *end != '\0' ) ) {
+			return false;
+		}
+
+		p = ( *end == ' ' ) ? end + 1 : end;
+		turns.push_back( turn );
+	}
+
+	scheduler.replay( turns );
+	return !turns.empty();
+}
+
+} // end namespace AngelCommunication
@@ -0,0 +1,85 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ANGEL_REPLAYLOG_INCLUDED
+#define ANGEL_REPLAYLOG_INCLUDED
+
+#include <stdio.h>
+
+#include "string.h"
+#include "scheduler.h"
+
+namespace AngelCommunication
+{
+
+/*
+	ReplayLog class
+	Saves everything given to the personas so a run can be repeated with the
+	same seed (see --log and --replay). Each line is an event, a name and
+	fields separated by spaces. Only the last field may contain spaces.
+
+	Programs write events for what people said and nick changes. After each
+	ThinkScheduler::think() writeThink() saves how many messages each persona
+	processed, replaying it processes the same messages in the same order.
+	The reply delay and think time limit depend on the clock, so replaying
+	only the messages wouldn't give the same replies.
+
+	Ex: think 0:4 1:2
+*/
+class ReplayLog
+{
+	private:
+		FILE			*file;
+		bool			writing;
+		unsigned int	lineNum;
+
+		// not copyable
+		ReplayLog( const ReplayLog & );
+		ReplayLog &operator=( const ReplayLog & );
+
+	public:
+		ReplayLog();
+		~ReplayLog();
+
+		// events are added to the end of a log that's opened for writing
+		bool open( const char *filename, bool write );
+		void close();
+		bool isOpen() const;
+
+		// does nothing if the log isn't open for writing
+		void write( const String &event );
+		void writeThink( const ThinkScheduler &scheduler ); // nothing if no persona processed messages
+
+		// Returns false at the end of the log. fields is the rest of the line.
+		bool read( String &event, String &fields );
+		unsigned int getLineNum() const;
+
+		// Returns the first field, fields is left pointing at the next one.
+		static String NextField( const char *&fields );
+
+		// Returns false if fields isn't valid for a think event.
+		static bool ReplayThink( ThinkScheduler &scheduler, const String &fields );
+};
+
+} // end namespace AngelCommunication
+
+#endif // ANGEL_REPLAYLOG_INCLUDED
@@ -0,0 +1,317 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <cstring>
+
+#include "replytemplate.h"
+#include "worddata.h"
+#include "log.h"
+
+namespace AngelCommunication
+{
+
+// built-in templates, used when the word data doesn't have a reply
+struct replyTemplate_s {
+	const char	*name;
+	const char	*text;
+} replyTemplates[RT_MAX] = {
+	{ "connect",				"Hi {nick}." },
+	{ "greeting",				"{text} {nick}" },
+	{ "toggle_done",			"{text} {value} as you requested." },
+	{ "set_done",				"Set {text} to {value} as you requested." },
+	{ "answer_me",				"{nick}, answer me." },
+	{ "i_am",					"I don't know what {predicate} means, so maybe you are." },
+	{ "like_me",				"I {verb} you too{end}{extra}" },
+	{ "like_mine_what",			"You {verb} my what?" },
+	{ "like_mine",				"I might {verb} my {predicate} if I knew what it was." },
+	{ "like_gift",				"/me gives {nick} {predicate} that {pronoun} {verb}s" },
+	{ "recent_subject",			"Are you still talking about {subject}?" },
+	{ "cant_parse",				"I don't know how to parse that statement." },
+	{ "cant_parse_addressed",	"{nick}, I don't know how to parse that statement." },
+	{ "talk_about_me",			"Let's talk about me instead of[ {extra}][ {owner}][ {subject}][ {link}][ {predicate}]! :)" },
+	{ "asking_about",			"Are you asking about[ {owner}][ {subject}][ {link}][ {predicate}]?" },
+	{ "talking_about",			"Are you talking about[ {owner}][ {subject}][ {link}][ {predicate}]?" },
+};
+
+const char *replySlotNames[RS_MAX] = {
+	"nick",
+	"name",
+	"fullname",
+	"pronoun",
+	"owner",
+	"subject",
+	"link",
+	"predicate",
+	"verb",
+	"text",
+	"value",
+	"end",
+	"extra",
+};
+
+std::vector<ReplyTemplate> ReplyTemplate::compiled;
+unsigned int ReplyTemplate::compiledGeneration = 0;
+
+ReplyArgs::ReplyArgs()
+{
+	for ( int i = 0; i < RS_MAX; i++ ) {
+		this->values[i] = NULL;
+		this->lens[i] = 0;
+	}
+}
+
+ReplyArgs &ReplyArgs::set( ReplySlot slot, const String &value )
+{
+	this->values[slot] = value.c_str();
+	this->lens[slot] = value.getLen();
+	return *this;
+}
+
+ReplyArgs &ReplyArgs::set( ReplySlot slot, const char *value )
+{
+	this->values[slot] = value;
+	this->lens[slot] = value ? strlen( value ) : 0;
+	return *this;
+}
+
+ReplyTemplate::ReplyTemplate()
+{
+}
+
+int ReplyTemplate::FindSlot( const char *name, size_t len )
+{
+	for ( int i = 0; i < RS_MAX; i++ ) {
+		if ( strlen( replySlotNames[i] ) == len && !strncmp( replySlotNames[i], name, len ) ) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+bool ReplyTemplate::compile( const char *text, String &error )
+{
+	size_t textLen = strlen( text );
+	unsigned int numLiterals = 0;
+	int group = -1; // op starting the open [
+	Op op;
+
+	this->ops.clear();
+
+	// unescaped literal text is never longer than the template
+	char *literal = this->literals.getBuffer( textLen );
+
+	op.slot = -1;
+	op.offset = 0;
+	op.len = 0;
+
+	for ( const char *p = text; *p; p++ ) {
+		if ( ( *p == '{' && p[1] == '{' ) || ( *p == '[' && p[1] == '[' ) ) {
+			literal[numLiterals++] = *p;
+			op.len++;
+			p++;
+			continue;
+		}
+
+		if ( *p == '[' || ( *p == ']' && group != -1 ) ) {
+			if ( *p == '[' && group != -1 ) {
+				error = "[ inside [ ]";
+				this->ops.clear();
+				this->literals.setLen( 0 );
+				return false;
+			}
+
+			if ( op.len ) {
+				this->ops.push_back( op );
+			}
+
+			if ( *p == '[' ) {
+				op.slot = -2;
+				op.offset = 0;
+				op.len = 0;
+				group = (int)this->ops.size();
+				this->ops.push_back( op );
+			} else {
+				this->ops[group].len = (unsigned int)( this->ops.size() - group - 1 );
+				group = -1;
+			}
+
+			op.slot = -1;
+			op.offset = numLiterals;
+			op.len = 0;
+			continue;
+		}
+
+		if ( *p != '{' ) {
+			literal[numLiterals++] = *p;
+			op.len++;
+			continue;
+		}
+
+		const char *end = strchr( p, '}' );
+		if ( !end ) {
+			error = "missing }";
+			this->ops.clear();
+			this->literals.setLen( 0 );
+			return false;
+		}
+
+		int slot = FindSlot( p + 1, end - ( p + 1 ) );
+		if ( slot == -1 ) {
+			error = "unknown slot ";
+			error.append( String( p ).subscript( 0, end - p ) );
+			this->ops.clear();
+			this->literals.setLen( 0 );
+			return false;
+		}
+
+		if ( op.len ) {
+			this->ops.push_back( op );
+		}
+
+		op.slot = slot;
+		op.offset = 0;
+		op.len = 0;
+		this->ops.push_back( op );
+
+		op.slot = -1;
+		op.offset = numLiterals;
+		op.len = 0;
+
+		p = end;
+	}
+
+	if ( group != -1 ) {
+		error = "missing ]";
+		this->ops.clear();
+		this->literals.setLen( 0 );
+		return false;
+	}
+
+	if ( op.len ) {
+		this->ops.push_back( op );
+	}
+
+	this->literals.setLen( numLiterals );
+	return true;
+}
+
+// text in [ ] is only used if all of its slots are set
+bool ReplyTemplate::groupIsSet( const ReplyArgs &args, size_t group ) const
+{
+	for ( size_t i = group + 1; i <= group + this->ops[group].len; i++ ) {
+		if ( this->ops[i].slot >= 0 && !args.lens[this->ops[i].slot] ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ReplyTemplate::render( const ReplyArgs &args, String &out ) const
+{
+	unsigned int total = 0;
+
+	for ( size_t i = 0; i < this->ops.size(); i++ ) {
+		const Op &op = this->ops[i];
+
+		if ( op.slot == -2 ) {
+			if ( !groupIsSet( args, i ) ) {
+				i += op.len;
+			}
+			continue;
+		}
+
+		total += ( op.slot == -1 ) ? op.len : args.lens[op.slot];
+	}
+
+	char *dest = out.getBuffer( total );
+	const char *literal = this->literals.c_str();
+
+	for ( size_t i = 0; i < this->ops.size(); i++ ) {
+		const Op &op = this->ops[i];
+
+		if ( op.slot == -2 ) {
+			if ( !groupIsSet( args, i ) ) {
+				i += op.len;
+			}
+		} else if ( op.slot == -1 ) {
+			memcpy( dest, literal + op.offset, op.len );
+			dest += op.len;
+		} else if ( args.lens[op.slot] ) {
+			memcpy( dest, args.values[op.slot], args.lens[op.slot] );
+			dest += args.lens[op.slot];
+		}
+	}
+}
+
+// compile the templates again when different word data is loaded
+void ReplyTemplate::CompileAll()
+{
+	const WordData *words = WordData::Current();
+	String error;
+
+	compiled.resize( RT_MAX );
+
+	for ( int i = 0; i < RT_MAX; i++ ) {
+		int entry = words->findEntry( WL_REPLIES, replyTemplates[i].name );
+
+		if ( entry != -1 ) {
+			if ( compiled[i].compile( words->getString( WL_REPLIES, entry, 1 ), error ) ) {
+				continue;
+			}
+
+			Log::Printf( LOG_WARNING, "data", "WARNING: Reply %s has %s, using built-in reply", replyTemplates[i].name, error.c_str() );
+		}
+
+		if ( !compiled[i].compile( replyTemplates[i].text, error ) ) {
+			Log::Printf( LOG_WARNING, "data", "WARNING: Built-in reply %s has %s", replyTemplates[i].name, error.c_str() );
+		}
+	}
+
+	compiledGeneration = words->getGeneration();
+}
+
+const ReplyTemplate &ReplyTemplate::Get( ReplyId id )
+{
+	if ( compiled.empty() || compiledGeneration != WordData::Current()->getGeneration() ) {
+		CompileAll();
+	}
+
+	return compiled[id];
+}
+
+void ReplyTemplate::Format( ReplyId id, String &out, const ReplyArgs &args )
+{
+	Get( id ).render( args, out );
+}
+
+const char *ReplyTemplate::GetName( ReplyId id )
+{
+	if ( id < 0 || id >= RT_MAX ) {
+		return NULL;
+	}
+
+	return replyTemplates[id].name;
+}
+
+} // end namespace AngelCommunication
@@ -0,0 +1,142 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ANGEL_REPLYTEMPLATE_INCLUDED
+#define ANGEL_REPLYTEMPLATE_INCLUDED
+
+#include <vector>
+
+#include "string.h"
+
+namespace AngelCommunication
+{
+
+// replies built from templates, the data file can replace them by name
+enum ReplyId
+{
+	RT_CONNECT,				// greet someone joining
+	RT_GREETING,			// reply to a greeting
+	RT_TOGGLE_DONE,			// "Angel stop fun"
+	RT_SET_DONE,			// "Angel set gender male"
+	RT_ANSWER_ME,			// asked a question and they changed the subject
+	RT_I_AM,				// "I am happy"
+	RT_LIKE_ME,				// "I like you"
+	RT_LIKE_MINE_WHAT,		// "I like your"
+	RT_LIKE_MINE,			// "I like your cat"
+	RT_LIKE_GIFT,			// "I like popcorn"
+	RT_RECENT_SUBJECT,		// sentence without a subject
+	RT_CANT_PARSE,			// message for everyone
+	RT_CANT_PARSE_ADDRESSED,
+	RT_TALK_ABOUT_ME,		// statement not about me, with fun replies
+	RT_ASKING_ABOUT,		// check what a question was about
+	RT_TALKING_ABOUT,		// check what a statement was about
+
+	RT_MAX
+};
+
+// values that can be inserted into a template using {name}
+enum ReplySlot
+{
+	RS_NICK,		// person being replied to
+	RS_NAME,		// my nick
+	RS_FULLNAME,	// my full name
+	RS_PRONOUN,		// he or she, for the person being replied to
+	RS_OWNER,		// word before the subject, such as my, your, or the
+	RS_SUBJECT,
+	RS_LINK,		// words before the predicate, such as being or your
+	RS_PREDICATE,
+	RS_VERB,		// linking verb
+	RS_TEXT,
+	RS_VALUE,
+	RS_END,			// ending punctuation
+	RS_EXTRA,
+
+	RS_MAX
+};
+
+/*
+	ReplyArgs class
+	Slot values for rendering a template. Only pointers are kept, so values
+	must exist until the template is rendered. Unset slots are empty.
+
+	Ex: ReplyTemplate::Format( RT_I_AM, s, ReplyArgs().set( RS_PREDICATE, predicate.toString() ) );
+*/
+class ReplyArgs
+{
+	private:
+		const char		*values[RS_MAX];
+		unsigned int	lens[RS_MAX];
+
+		friend class ReplyTemplate;
+
+	public:
+		ReplyArgs();
+
+		ReplyArgs &set( ReplySlot slot, const String &value );
+		ReplyArgs &set( ReplySlot slot, const char *value );
+};
+
+/*
+	ReplyTemplate class
+	Reply text with slots, such as "I don't know what {predicate} means.".
+	Text in [ ] is only used if all of the slots in it are set, such as
+	"Are you talking about[ {subject}]?". Use {{ or [[ for a literal { or [.
+	Templates are compiled to a list of literal text and slot ops, so
+	rendering is one allocation and a copy of each piece.
+*/
+class ReplyTemplate
+{
+	private:
+		class Op
+		{
+			public:
+				int				slot;	// -1 for literal text, -2 for an optional group of the next len ops
+				unsigned int	offset;	// literal text in literals
+				unsigned int	len;
+		};
+
+		std::vector<Op>	ops;
+		String			literals;
+
+		static std::vector<ReplyTemplate> compiled;
+		static unsigned int compiledGeneration;
+
+		static int FindSlot( const char *name, size_t len );
+		bool groupIsSet( const ReplyArgs &args, size_t group ) const;
+		static void CompileAll();
+
+	public:
+		ReplyTemplate();
+
+		// Returns false and sets error if text isn't a valid template.
+		bool compile( const char *text, String &error );
+		void render( const ReplyArgs &args, String &out ) const;
+
+		// Template from the current word data, or built-in if it's missing or invalid.
+		static const ReplyTemplate &Get( ReplyId id );
+		static void Format( ReplyId id, String &out, const ReplyArgs &args );
+		static const char *GetName( ReplyId id );
+};
+
+} // end namespace AngelCommunication
+
+#endif // ANGEL_REPLYTEMPLATE_INCLUDED
@@ -0,0 +1,143 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "scheduler.h"
+#include "persona.h"
+
+namespace AngelCommunication
+{
+
+ThinkScheduler::ThinkScheduler() : next( 0 )
+{
+}
+
+void ThinkScheduler::add( Persona *persona, unsigned int weight )
+{
+	Entry entry;
+
+	entry.persona = persona;
+	entry.weight = weight ? weight : 1;
+
+	this->entries.push_back( entry );
+}
+
+void ThinkScheduler::remove( Persona *persona )
+{
+	for ( size_t i = 0; i < this->entries.size(); i++ ) {
+		if ( this->entries[i].persona == persona ) {
+			this->entries.erase( this->entries.begin() + i );
+			break;
+		}
+	}
+
+	if ( this->next >= this->entries.size() ) {
+		this->next = 0;
+	}
+}
+
+void ThinkScheduler::setWeight( Persona *persona, unsigned int weight )
+{
+	for ( size_t i = 0; i < this->entries.size(); i++ ) {
+		if ( this->entries[i].persona == persona ) {
+			this->entries[i].weight = weight ? weight : 1;
+			break;
+		}
+	}
+}
+
+bool ThinkScheduler::think( double maxSeconds )
+{
+	size_t numEntries = this->entries.size();
+	double startTime = Persona::ClockSeconds();
+	bool moreLeft = false;
+
+	this->lastTurns.clear();
+
+	for ( size_t n = 0; n < numEntries; n++ ) {
+		size_t index = ( this->next + n ) % numEntries;
+		double remaining = 0;
+
+		if ( maxSeconds > 0 ) {
+			remaining = maxSeconds - ( Persona::ClockSeconds() - startTime );
+
+			// out of time, this persona goes first next round
+			if ( remaining <= 0 ) {
+				this->next = index;
+				return true;
+			}
+		}
+
+		const Entry &entry = this->entries[index];
+		unsigned int processed = entry.persona->getThinkStats().processed;
+
+		if ( entry.persona->think( entry.weight * MESSAGES_PER_WEIGHT, remaining ) ) {
+			moreLeft = true;
+		}
+
+		processed = entry.persona->getThinkStats().processed - processed;
+
+		if ( processed ) {
+			ThinkTurn turn;
+
+			turn.entry = (unsigned int)index;
+			turn.processed = processed;
+			this->lastTurns.push_back( turn );
+		}
+	}
+
+	if ( numEntries > 0 ) {
+		this->next = ( this->next + 1 ) % numEntries;
+	}
+
+	return moreLeft;
+}
+
+float ThinkScheduler::getSleepTime() const
+{
+	float delay = -1;
+
+	for ( size_t i = 0; i < this->entries.size(); i++ ) {
+		float sleepTime = this->entries[i].persona->getSleepTime();
+
+		if ( delay < 0 || ( sleepTime >= 0 && sleepTime < delay ) ) {
+			delay = sleepTime;
+		}
+	}
+
+	return delay;
+}
+
+const std::vector<ThinkTurn> &ThinkScheduler::getLastTurns() const
+{
+	return this->lastTurns;
+}
+
+void ThinkScheduler::replay( const std::vector<ThinkTurn> &turns )
+{
+	for ( size_t i = 0; i < turns.size(); i++ ) {
+		if ( turns[i].entry < this->entries.size() && turns[i].processed ) {
+			this->entries[turns[i].entry].persona->flush( turns[i].processed );
+		}
+	}
+}
+
+} // end namespace AngelCommunication
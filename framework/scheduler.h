@@ -0,0 +1,88 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ANGEL_SCHEDULER_INCLUDED
+#define ANGEL_SCHEDULER_INCLUDED
+
+#include <cstddef>
+#include <vector>
+
+namespace AngelCommunication
+{
+
+class Persona;
+
+// messages a persona processed in a turn of ThinkScheduler::think()
+class ThinkTurn
+{
+	public:
+		unsigned int	entry;		// personas are numbered in the order they were added
+		unsigned int	processed;
+};
+
+/*
+	ThinkScheduler class
+	Lets personas process their messages in turns so one with a large backlog
+	doesn't keep the others (or the network) waiting. Each turn a persona may
+	process weight * MESSAGES_PER_WEIGHT messages. The persona that goes first
+	rotates so every persona gets to use the time budget.
+*/
+class ThinkScheduler
+{
+	private:
+		class Entry
+		{
+			public:
+				Persona			*persona;
+				unsigned int	weight;
+		};
+
+		std::vector<Entry> entries;
+		size_t next; // persona that goes first in the next round
+		std::vector<ThinkTurn> lastTurns;
+
+	public:
+		static const unsigned int MESSAGES_PER_WEIGHT = 4;
+
+		ThinkScheduler();
+
+		void add( Persona *persona, unsigned int weight = 1 );
+		void remove( Persona *persona );
+		void setWeight( Persona *persona, unsigned int weight );
+
+		// give each persona a turn until maxSeconds have passed, 0 is no limit.
+		// returns true if a persona has messages ready that it didn't get to.
+		bool think( double maxSeconds = 0 );
+
+		// shortest Persona::getSleepTime(), -1 if all are waiting for messages
+		float getSleepTime() const;
+
+		// personas that processed messages in the last think(), in order.
+		// replay() processes the same messages again, ignoring the reply
+		// delay and time, so a recorded run can be repeated (see ReplayLog).
+		const std::vector<ThinkTurn> &getLastTurns() const;
+		void replay( const std::vector<ThinkTurn> &turns );
+};
+
+} // end namespace AngelCommunication
+
+#endif // ANGEL_SCHEDULER_INCLUDED
@@ -19,102 +19,16 @@ freely, subject to the following restrictions:
 3. This notice may not be removed or altered from any source distribution.
 */
 
-#include <stdio.h> // printf
-
 #include "angel.h"
 #include "sentence.h"
+#include "log.h"
+#include "worddata.h"
 
 namespace AngelCommunication
 {
 
-// http://en.wikipedia.org/wiki/Interrogative_word
-const char *interrogativeWords[] = {
-	"which", "what",
-	"whose",
-	"who", "whom",
-	"where",
-	"whence",
-	"whither",
-	"when",
-	"how",
-	"why", "wherefore",
-	"whether",
-	NULL
-};
-
-// http://en.wikipedia.org/wiki/English_modal_verbs
-// these are also considered to be auxiliary verbs
-const char *modalVerbs[] = {
-	"can", "could", "may", "might", "must", "shall", "should", "will", "would", NULL
-};
-
-// http://en.wikipedia.org/wiki/Auxiliary_verb
-// NOTE: modal verbs and auxiliary verbs are treated the same by this program
-// NOTE: "do" is in the commandWords list instead of here
-const char *auxiliaryVerbs[] = {
-	"am", "are", "be", "been", "being", "did", "does", "had", "has", "is", "was", "were",
-
-	// this was in commandWords, but it's kind of more stating something rather than a command
-	"have",
-
-	// like is uber complicated and not always a verb
-	"like",
-	"love",
-
-	NULL
-};
-
-// http://en.wikipedia.org/wiki/Copula_(linguistics)
-// NOTE: modal verbs and linking verbs are treated the same by this program
-const char *linkingVerbs[] = {
-	"to", // NOTE: I don't think this is considered a linking verb
-	NULL
-};
-
-// Words that are a command.
-// hmm, are these all 'main verbs'? main verb means can be a predicate by itself.
-const char *commandWords[] = {
-	// http://ogden.basic-english.org/verbs.html
-	"be", "come", "give", "make",
-	/*"have", */"go", "get", "send",
-	"do", "put", "keep", "see",
-	"seem", "take", "let", "say",
-	// There are said to sometimes be used as operators.
-	// ZTM: "because" probably needs to be a conjunction word in some cases
-	"cause", "because",
-
-	// ZTM: not part of list for Basic English verbs / operators. might not be correct handling.
-	"set", "enable", "disable", "stop", "start", "restart",
-
-	NULL
-};
-
-const char *miscVerbs[] = {
-	NULL
-};
-
-#if 0
-// http://www.scientificpsychic.com/grammar/enggramg.html
-const char *prepositionWords[] = {
-	"from", "toward", "in", "about", "over", "above", "under", "at", "below", NULL
-};
-#endif
-
-const char *punctuationMarks[] = {
-	".", "!", "?", ",", ";", NULL
-};
-
-const char *quoteMarks[] = {
-	"\"", "\'", "`", NULL
-};
-
-bool inWordList( const String &original, const char **wordList ) {
-	for ( int i = 0; wordList[i] != NULL; ++i ) {
-		if ( !original.icompareTo( wordList[i] ) ) {
-			return true;
-		}
-	}
-	return false;
+bool inWordList( const String &original, WordList list ) {
+	return WordData::Current()->inList( list, original );
 }
 
 Sentence::Sentence() {
@@ -129,7 +43,7 @@ void Sentence::clear() {
 	parts.clear();
 }
 
-void Sentence::parse( const char *text ) {
+void Sentence::parse( const char *text, bool verbose ) {
 	SentencePart newPart;
 
 	Lexer tokens( text );
@@ -150,24 +64,24 @@ void Sentence::parse( const char *text ) {
 
 	// part of sentence tagging.
 	for ( int i = 0; i < tokens.getNumTokens(); ++i ) {
-		if ( inWordList( tokens[i], interrogativeWords ) ) {
+		if ( inWordList( tokens[i], WL_INTERROGATIVE ) ) {
 			tokenTypes[i] = TT_QUESTWORD;
 		}
-		else if ( inWordList( tokens[i], auxiliaryVerbs )
-				|| inWordList( tokens[i], modalVerbs )
-				|| inWordList( tokens[i], linkingVerbs ) ) {
+		else if ( inWordList( tokens[i], WL_AUXILIARY )
+				|| inWordList( tokens[i], WL_MODAL )
+				|| inWordList( tokens[i], WL_LINKING ) ) {
 			tokenTypes[i] = TT_LINKVERB;
 		}
-		else if ( inWordList( tokens[i], miscVerbs ) ) {
+		else if ( inWordList( tokens[i], WL_MISC ) ) {
 			tokenTypes[i] = TT_MISCVERB;
 		}
-		else if ( inWordList( tokens[i], commandWords ) ) {
+		else if ( inWordList( tokens[i], WL_COMMAND ) ) {
 			tokenTypes[i] = TT_COMMANDWORD;
 		}
-		else if ( inWordList( tokens[i], punctuationMarks ) ) {
+		else if ( inWordList( tokens[i], WL_PUNCTUATION ) ) {
 			tokenTypes[i] = TT_PUNCTUATION;
 		}
-		else if (  inWordList( tokens[i], quoteMarks ) ) {
+		else if (  inWordList( tokens[i], WL_QUOTE ) ) {
 			tokenTypes[i] = TT_QUOTE;
 		}
 		else {
@@ -204,7 +118,8 @@ void Sentence::parse( const char *text ) {
 
 		if ( tokenTypes[i] == TT_QUESTWORD ) {
 			if ( !newPart.interrogative.isEmpty() ) {
-				printf("  WARNING: Two interrogative words found in one sentence part\n");
+				if ( verbose )
+					Log::Write( LOG_WARNING, "parse", "  WARNING: Two interrogative words found in one sentence part" );
 			}
 			newPart.function = SentencePart::SF_QUESTION;
 			newPart.interrogative = tokens[i];
@@ -213,14 +128,16 @@ void Sentence::parse( const char *text ) {
 			// Ex: A cat has how many legs? -- how is after has
 			if ( !newPart.subject.isEmpty() ) {
 				if ( !newPart.predicate.isEmpty() ) {
-					printf("  WARNING: Found interrogative after subject. Swapping subject and predictate.\n");
+					if ( verbose )
+						Log::Write( LOG_WARNING, "parse", "  WARNING: Found interrogative after subject. Swapping subject and predictate." );
 				}
 				String tmp = newPart.predicate;
 				newPart.predicate = newPart.subject;
 				newPart.subject = tmp;
 			}
 			if ( !newPart.subject.isEmpty() && !newPart.predicate.isEmpty() ) {
-				printf("  WARNING: Going to append tokens after interrogative to (non empty) predicate\n");
+				if ( verbose )
+					Log::Write( LOG_WARNING, "parse", "  WARNING: Going to append tokens after interrogative to (non empty) predicate" );
 			}
 			readSubject = newPart.subject.isEmpty();
 			readPredicate = !readSubject;
@@ -249,7 +166,8 @@ void Sentence::parse( const char *text ) {
 			// right after an interrogative word or command word
 			else if ( perviousType == TT_QUESTWORD || perviousType == TT_COMMANDWORD ) {
 				if ( !newPart.subjectVerb.isEmpty() ) {
-					printf("  WARNING: Two subject verbs found in one sentence part\n");
+					if ( verbose )
+						Log::Write( LOG_WARNING, "parse", "  WARNING: Two subject verbs found in one sentence part" );
 				}
 
 				newPart.subjectVerb = tokens[i];
@@ -277,7 +195,7 @@ void Sentence::parse( const char *text ) {
 						}
 					}
 
-					//printf("  NOTICE: Two linking verbs in a row in one sentence part (ignoring second)\n");
+					ANGEL_LOG_DEBUG( "parse", "  NOTICE: Two linking verbs in a row in one sentence part (ignoring second)" );
 					continue;
 				}
 
@@ -286,11 +204,12 @@ void Sentence::parse( const char *text ) {
 					// In "How many legs does a cat have?" 'does' and 'have' are link words.
 					// Don't need the 'have' for responding, unless nitpicking grammer.
 					if ( realNextType == TT_NONE || realNextType == TT_PUNCTUATION ) {
-						//printf("  NOTICE: Ignoring second linking verb at end of sentence\n");
+						ANGEL_LOG_DEBUG( "parse", "  NOTICE: Ignoring second linking verb at end of sentence" );
 						continue;
 					}
 
-					printf("  NOTICE: Two linking verbs found in one sentence part\n");
+					if ( verbose )
+						Log::Write( LOG_NOTICE, "parse", "  NOTICE: Two linking verbs found in one sentence part" );
 
 					// finish this sentence part
 					SentencePart::SentenceFunction perviousFunction = newPart.function;
@@ -334,10 +253,10 @@ void Sentence::parse( const char *text ) {
 				}
 
 				if ( startToken >= sectencePartFirstToken && tokenTypes[startToken] == TT_OTHER && endToken >= sectencePartFirstToken ) {
-					//printf( "  NOTICE: link subject %d to %d...\n", startToken, endToken );
+					ANGEL_LOG_DEBUG( "parse", "  NOTICE: link subject %d to %d...", startToken, endToken );
 					newPart.subject = tokens.toString( startToken, endToken );
 				} else {
-					//printf( "  NOTICE: link verb without subject before it.\n" );
+					ANGEL_LOG_DEBUG( "parse", "  NOTICE: link verb without subject before it." );
 				}
 
 				// begin subject reading or predicate if subject is already set.
@@ -351,7 +270,7 @@ void Sentence::parse( const char *text ) {
 
 			if ( tokens[i] == "?" && newPart.function != SentencePart::SF_QUESTION ) {
 				// it just became a question!
-				//printf( "  NOTICE: Forcing %s to question!\n", newPart.getFunctionName() );
+				ANGEL_LOG_DEBUG( "parse", "  NOTICE: Forcing %s to question!", newPart.getFunctionName() );
 				newPart.function = SentencePart::SF_QUESTION;
 			}
 			// Avoid "May The Force be with you." being a question. Might not be the best method as "May The Force be with you" will be treated as a question.
@@ -359,7 +278,7 @@ void Sentence::parse( const char *text ) {
 			// This could be bad if someone writes "What.", "What is that.", etc. Then again, this whole thing asuming mostly proper english with optional punctuation.
 			else if ( tokens[i] == "." && newPart.function == SentencePart::SF_QUESTION ) {
 				// it just became a question!
-				//printf( "  NOTICE: Forcing question to statement!\n" );
+				ANGEL_LOG_DEBUG( "parse", "  NOTICE: Forcing question to statement!" );
 				newPart.function = SentencePart::SF_STATEMENT;
 			}
 		} else {
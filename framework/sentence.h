@@ -102,7 +102,7 @@ class Sentence {
 		Sentence();
 		Sentence( const char *text );
 
-		void parse( const char *text );
+		void parse( const char *text, bool verbose = true ); // verbose prints parsing problems
 		void clear();
 };
 
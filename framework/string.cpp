@@ -30,6 +30,7 @@ freely, subject to the following restrictions:
 
 #include <cstring>
 #include <cstdio>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdarg.h>
@@ -46,6 +47,45 @@ freely, subject to the following restrictions:
 namespace AngelCommunication
 {
 
+/*
+    StringPiece
+    Part of a String being built. The pieces are collected first so the
+    output can be allocated once at its final length.
+*/
+class StringPiece
+{
+    public:
+        const char *text;
+        size_t len;
+
+        StringPiece(const char *t, size_t l) : text(t), len(l)
+        {
+        }
+};
+
+static void JoinPieces(String &output, const std::vector<StringPiece> &pieces)
+{
+    size_t total = 0;
+
+    for (size_t i = 0; i < pieces.size(); i++)
+    {
+        total += pieces[i].len;
+    }
+
+    char *dest = output.getBuffer(total);
+
+    if (dest == NULL)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < pieces.size(); i++)
+    {
+        memcpy(dest, pieces[i].text, pieces[i].len);
+        dest += pieces[i].len;
+    }
+}
+
 /*
     String::String
 */
@@ -54,12 +94,14 @@ String::String(const String &text)
     data = NULL;
     len = 0;
     setData(text.data);
+    foldHash = text.foldHash;
 }
 
 String::String(const String *text)
 {
     data = NULL;
     len = 0;
+    foldHash = 0;
     if (text != NULL)
         setData(text->data);
 }
@@ -71,6 +113,7 @@ String::String(const char *newData)
 {
     data = NULL;
     len = 0;
+    foldHash = 0;
     setData(newData);
 }
 
@@ -81,6 +124,7 @@ String::String(void)
 {
     data = NULL;
     len = 0;
+    foldHash = 0;
 }
 
 /*
@@ -130,6 +174,8 @@ void String::setLen(unsigned int newlen)
 {
     char *temp = NULL;
 
+    foldHash = 0;
+
     if (len == newlen)
     {
         return;
@@ -161,6 +207,42 @@ void String::setLen(unsigned int newlen)
     len = newlen;
 }
 
+/*
+    String::shrink
+    Makes the String newlen long without reallocating. Does nothing if
+    newlen isn't shorter.
+*/
+void String::shrink(unsigned int newlen)
+{
+    foldHash = 0;
+
+    if (newlen >= len)
+    {
+        return;
+    }
+
+    if (newlen == 0)
+    {
+        delete[] data;
+        data = NULL;
+        len = 0;
+        return;
+    }
+
+    len = newlen;
+    data[len] = '\0';
+}
+
+/*
+    String::getBuffer
+*/
+char *String::getBuffer(unsigned int newlen)
+{
+    setLen(newlen);
+
+    return data;
+}
+
 /*
     String::setData
 */
@@ -191,6 +273,8 @@ void String::setData(const char *newData)
 {
     unsigned int newlen;
 
+    foldHash = 0;
+
 	if (newData)
     {
 		newlen = strlen(newData);
@@ -275,11 +359,14 @@ int String::compareTo(const char *str, int len) const
 */
 int String::icompareTo(const String &str, int len) const
 {
-    if (len >= 0)
+    // compare the terminating '\0' of the shorter string too
+    size_t n = std::min(getLen(), str.getLen()) + 1;
+
+    if (len >= 0 && (size_t)len < n)
     {
-        return strnicmp(c_str(), str.c_str(), len);
+        n = len;
     }
-    return stricmp(c_str(), str.c_str());
+    return FoldCompareKnown(c_str(), str.c_str(), n);
 }
 
 /*
@@ -291,11 +378,7 @@ int String::icompareTo(const String *str, int len) const
     {
         return 0;
     }
-    if (len >= 0)
-    {
-        return strnicmp(c_str(), str->c_str(), len);
-    }
-    return stricmp(c_str(), str->c_str());
+    return icompareTo(*str, len);
 }
 
 /*
@@ -307,11 +390,116 @@ int String::icompareTo(const char *str, int len) const
     {
         return 0;
     }
-    if (len >= 0)
+    return FoldCompare(c_str(), str, (len >= 0) ? (size_t)len : (size_t)-1);
+}
+
+/*
+    FoldWord
+    Lower case the ASCII letters in 8 bytes at once.
+*/
+static inline uint64_t FoldWord(uint64_t w)
+{
+    const uint64_t highBits = 0x8080808080808080ULL;
+    uint64_t heptets = w & 0x7f7f7f7f7f7f7f7fULL;
+    uint64_t geA = heptets + 0x3f3f3f3f3f3f3f3fULL; // high bit set if >= 'A'
+    uint64_t gtZ = heptets + 0x2525252525252525ULL; // high bit set if > 'Z'
+    uint64_t upper = geA & ~gtZ & ~w & highBits;
+
+    return w | (upper >> 2); // set 0x20 bit of upper case letters
+}
+
+static inline bool HasZeroByte(uint64_t w)
+{
+    return ((w - 0x0101010101010101ULL) & ~w & 0x8080808080808080ULL) != 0;
+}
+
+static inline int FoldChar(unsigned char c)
+{
+    if (c >= 'A' && c <= 'Z')
     {
-        return strnicmp(c_str(), str, len);
+        return c + ('a' - 'A');
+    }
+    return c;
+}
+
+/*
+    String::FoldCompare
+    ASCII case-insensitive compare of at most n characters.
+*/
+int String::FoldCompare(const char *a, const char *b, size_t n)
+{
+    const unsigned char *ua = (const unsigned char *)a;
+    const unsigned char *ub = (const unsigned char *)b;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        int ca = FoldChar(ua[i]);
+        int cb = FoldChar(ub[i]);
+
+        if (ca != cb || ca == '\0')
+        {
+            return ca - cb;
+        }
     }
-    return stricmp(c_str(), str);
+    return 0;
+}
+
+/*
+    String::FoldCompareKnown
+    Same as FoldCompare, but a and b must both have at least n readable
+    bytes so 8 bytes can be compared at once.
+*/
+int String::FoldCompareKnown(const char *a, const char *b, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8)
+    {
+        uint64_t wa, wb;
+
+        memcpy(&wa, a + i, 8);
+        memcpy(&wb, b + i, 8);
+
+        if (HasZeroByte(wa) || HasZeroByte(wb))
+        {
+            break;
+        }
+        if (wa != wb && FoldWord(wa) != FoldWord(wb))
+        {
+            break;
+        }
+    }
+
+    return FoldCompare(a + i, b + i, n - i);
+}
+
+/*
+    String::FoldHash
+    FNV-1a hash of str with ASCII letters lower cased.
+*/
+unsigned int String::FoldHash(const char *str)
+{
+    unsigned int hash = 2166136261u;
+
+    for (const unsigned char *p = (const unsigned char *)str; *p; ++p)
+    {
+        hash ^= FoldChar(*p);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/*
+    String::getFoldHash
+*/
+unsigned int String::getFoldHash(void) const
+{
+    // 0 means not computed, so a hash of 0 is just computed every time
+    if (foldHash == 0)
+    {
+        foldHash = FoldHash(c_str());
+    }
+    return foldHash;
 }
 
 /*
@@ -421,15 +609,14 @@ void String::ltrim(void)
         }
     }
 
-	if ( i != len )
-	{
-		setData( subscript( i, len ) );
-	}
-	else
-	{
-		// it's all spaces
-		setData( "" );
-	}
+    if (i == 0)
+    {
+        return;
+    }
+
+    // move the text and '\0' to the start, if it's all spaces it's just the '\0'
+    memmove(data, &data[i], len - i + 1);
+    shrink(len - i);
 }
 
 /*
@@ -445,23 +632,16 @@ void String::rtrim(void)
         return;
     }
 
-    for (i = getLen()-1; i > 0; i--)
+    for (i = getLen(); i > 0; i--)
     {
-        if (data[i] != ' ')
+        if (data[i-1] != ' ')
         {
             break;
         }
     }
 
-	if ( i > 0 )
-	{
-		setData( subscript( 0, i ) );
-	}
-	else
-	{
-		// it's all spaces
-		setData( "" );
-	}
+    // if it's all spaces i is 0
+    shrink(i);
 }
 
 /*
@@ -840,58 +1020,50 @@ bool String::fileExists(const char *filename)
 String String::replaceENV()
 {
     String output;
-    size_t outputLen = getLen();
+    std::vector<StringPiece> pieces;
+    const char *src = c_str();
+    const char *p;
 
-    if (findString("$(") == false)
+    while ((p = strstr(src, "$(")) != NULL)
     {
-        return String(*this);
-    }
+        const char *close = strchr(p + 2, ')');
 
-    for (size_t i = 0; i < outputLen; /* */)
-    {
-        if (strncmp(&this->data[i], "$(", 2) == 0)
+        // no ')', the rest is copied as is
+        if (close == NULL)
         {
-            size_t start = i;
-            size_t size = 0;
-            String envName;
-            char *env = NULL;
-
-            i += 2; // Skip "$(" when reading env name.
-
-            // FIXME: what if there is no ')'...
-            for (size = 0; this->data[i] != ')'; ++size, ++i)
-            {
-                envName.append(this->data[i]);
-            }
+            break;
+        }
 
-            // Next data read at start + size + 3.
-            i = start + size + 3; // Add 3 to skip "$(" and ")"
+        pieces.push_back(StringPiece(src, p - src));
 
-            //cout << "envName: \"" << envName.c_str() << "\"" << endl;
+        String envName;
+        if (close - p > 2)
+        {
+            memcpy(envName.getBuffer(close - p - 2), p + 2, close - p - 2);
+        }
 
-            env = getenv(envName.c_str());
-            if (env == NULL)
-            {
-                // Can't replace...
-                output.append("$(");
-                output.append(envName);
-                output.append(")");
-            }
-            else
-            {
-                //cout << envName.c_str() << ": " << env << endl;
-                output.append(env);
-                outputLen += strlen(env);
-            }
+        const char *env = getenv(envName.c_str());
+        if (env == NULL)
+        {
+            // Can't replace...
+            pieces.push_back(StringPiece(p, close - p + 1));
         }
         else
         {
-            // Add the character.
-            output.append(this->data[i]);
-            ++i;
+            pieces.push_back(StringPiece(env, strlen(env)));
         }
+
+        src = close + 1;
     }
 
+    if (pieces.empty())
+    {
+        return String(*this);
+    }
+
+    pieces.push_back(StringPiece(src, c_str() + getLen() - src));
+    JoinPieces(output, pieces);
+
     return output;
 }
 
@@ -923,35 +1095,77 @@ bool String::isNum(void) const
 }
 
 /*
-    String::snprintf
-    Works like snprintf, the data is set to this String.
-    nsize is the size of the buffer.
+    String::vformat
+    Formats into this String starting at offset, keeping the text before
+    it. Short results are formatted on the stack and copied, longer ones are
+    measured and formatted straight into the new buffer so the String is
+    only reallocated once. The arguments may point into this String.
 */
-int String::snprintf(size_t nsize, const char *fmt, ...)
+int String::vformat(unsigned int offset, size_t nsize, const char *fmt, va_list args)
 {
-	va_list argptr;
-	char *str = NULL;
-    int rtn = 0;
+    char stackBuf[256];
+    va_list argsCopy;
+    int rtn;
+
+    va_copy(argsCopy, args);
+
+    rtn = vsnprintf(stackBuf, std::min(sizeof(stackBuf), nsize), fmt, args);
+
+    if (rtn < 0)
+    {
+        va_end(argsCopy);
+        return rtn;
+    }
+
+    // vsnprintf leaves room for the '\0' in nsize.
+    size_t outLen = std::min((size_t)rtn, nsize > 0 ? nsize - 1 : 0);
 
-    try
+    if (outLen < sizeof(stackBuf))
     {
-        str = new char [nsize+1];
+        setLen(offset + outLen);
+
+        if (outLen > 0)
+        {
+            memcpy(data + offset, stackBuf, outLen);
+        }
     }
-    catch (std::bad_alloc) // Couldn't alloc memory.
+    else
     {
-        return 0;
+        char *temp = new char [offset + outLen + 1];
+
+        if (offset > 0)
+        {
+            memcpy(temp, data, offset);
+        }
+
+        vsnprintf(temp + offset, outLen + 1, fmt, argsCopy);
+
+        delete[] data;
+        data = temp;
+        len = offset + outLen;
+        foldHash = 0;
     }
 
-	va_start(argptr, fmt);
-	rtn = vsnprintf (str, nsize, fmt, argptr);
-	va_end(argptr);
+    va_end(argsCopy);
 
-    setData(str); // Set the data to str.
+    return rtn;
+}
 
-    if (str != NULL)
-        delete[] str;
+/*
+    String::snprintf
+    Works like snprintf, the data is set to this String.
+    nsize is the size of the buffer.
+*/
+int String::snprintf(size_t nsize, const char *fmt, ...)
+{
+    va_list argptr;
+    int rtn;
+
+    va_start(argptr, fmt);
+    rtn = vformat(0, nsize, fmt, argptr);
+    va_end(argptr);
 
-	return rtn;
+    return rtn;
 }
 
 /*
@@ -961,29 +1175,120 @@ int String::snprintf(size_t nsize, const char *fmt, ...)
 */
 int String::append_snprintf(size_t nsize, const char *fmt, ...)
 {
-	va_list argptr;
-	char *str = NULL;
-    int rtn = 0;
+    va_list argptr;
+    int rtn;
+
+    va_start(argptr, fmt);
+    rtn = vformat(len, nsize, fmt, argptr);
+    va_end(argptr);
+
+    return rtn;
+}
 
-    try
+/*
+    StringValue
+    Converts numbers to text when the value is made, strings are only
+    pointed to.
+*/
+StringValue::StringValue(const char *str) : text(str ? str : ""), len(str ? strlen(str) : 0)
+{
+}
+
+StringValue::StringValue(const String &str) : text(str.c_str()), len(str.getLen())
+{
+}
+
+StringValue::StringValue(char c) : text(number), len(1)
+{
+    number[0] = c;
+    number[1] = '\0';
+}
+
+StringValue::StringValue(int n) : text(number)
+{
+    len = ::snprintf(number, sizeof(number), "%d", n);
+}
+
+StringValue::StringValue(unsigned int n) : text(number)
+{
+    len = ::snprintf(number, sizeof(number), "%u", n);
+}
+
+StringValue::StringValue(long n) : text(number)
+{
+    len = ::snprintf(number, sizeof(number), "%ld", n);
+}
+
+StringValue::StringValue(unsigned long n) : text(number)
+{
+    len = ::snprintf(number, sizeof(number), "%lu", n);
+}
+
+StringValue::StringValue(long long n) : text(number)
+{
+    len = ::snprintf(number, sizeof(number), "%lld", n);
+}
+
+StringValue::StringValue(unsigned long long n) : text(number)
+{
+    len = ::snprintf(number, sizeof(number), "%llu", n);
+}
+
+StringValue::StringValue(double n) : text(number)
+{
+    len = ::snprintf(number, sizeof(number), "%g", n);
+}
+
+StringValue::StringValue(const StringValue &other) : text(other.text), len(other.len)
+{
+    if (other.text == other.number)
     {
-        str = new char [nsize+1];
+        memcpy(number, other.number, sizeof(number));
+        text = number;
     }
-    catch (std::bad_alloc) // Couldn't alloc memory.
+}
+
+/*
+    String::joinValues
+    Appends the values at offset in one allocation. Builds a new buffer
+    before freeing the old one so values may point into this String.
+*/
+void String::joinValues(unsigned int offset, const StringValue *values, size_t num)
+{
+    size_t total = offset;
+
+    for (size_t i = 0; i < num; i++)
     {
-        return 0;
+        total += values[i].len;
     }
 
-	va_start(argptr, fmt);
-	rtn = vsnprintf (str, nsize, fmt, argptr);
-	va_end(argptr);
+    if (total == 0)
+    {
+        setLen(0);
+        return;
+    }
 
-    append(str); // Append it to the current data.
+    char *temp = new char [total + 1];
+    char *dest = temp;
 
-    if (str != NULL)
-        delete[] str;
+    if (offset > 0)
+    {
+        memcpy(dest, data, offset);
+        dest += offset;
+    }
 
-	return rtn;
+    for (size_t i = 0; i < num; i++)
+    {
+        memcpy(dest, values[i].text, values[i].len);
+        dest += values[i].len;
+    }
+
+    *dest = '\0';
+
+    delete[] data;
+    data = temp;
+    len = total;
+    foldHash = 0;
 }
 
 /*
@@ -1001,8 +1306,9 @@ void String::append(const String &str)
         setData(str);
         return;
     }
-    setLen(getLen()+str.getLen()+1);
-    strcat(data, str.c_str());
+    size_t oldLen = getLen();
+    setLen(oldLen+str.getLen());
+    memcpy(data+oldLen, str.c_str(), str.getLen());
 }
 
 /*
@@ -1024,8 +1330,9 @@ void String::append(const String *str)
         setData(str);
         return;
     }
-    setLen(getLen()+str->getLen()+1);
-    strcat(data, str->c_str());
+    size_t oldLen = getLen();
+    setLen(oldLen+str->getLen());
+    memcpy(data+oldLen, str->c_str(), str->getLen());
 }
 
 /*
@@ -1043,8 +1350,10 @@ void String::append(const char *str)
         setData(str);
         return;
     }
-    setLen(getLen()+strlen(str)+1);
-    strcat(data, str);
+    size_t oldLen = getLen();
+    size_t strLen = strlen(str);
+    setLen(oldLen+strLen);
+    memcpy(data+oldLen, str, strLen);
 }
 
 /*
@@ -1090,69 +1399,107 @@ bool String::findString(const char *str) const
     String::replaceString
     Returns a String
 */
-String String::replaceString(String findStr, String newData) const
+String String::replaceString(const String &findStr, const String &newData) const
 {
-    String output;
-    size_t findLen = 0;
-    size_t inputLen = getLen();
+    return replaceString(findStr.c_str(), newData.c_str());
+}
 
-    if (findStr.isEmpty() == true)
+/*
+    String::replaceString
+    Returns a String.
+*/
+String String::replaceString(const char *findStr, const char *newData) const
+{
+    if (findStr == NULL)
     {
         return String(*this);
     }
 
-    findLen = findStr.getLen();
+    return replaceStrings(&findStr, &newData, 1);
+}
 
-    for (size_t i = 0; i < (inputLen - findLen)+1; /* */)
+/*
+    String::replaceStrings
+    Returns a String.
+*/
+String String::replaceStrings(const char * const *findStrs, const char * const *newDatas, int num) const
+{
+    String output;
+    std::vector<StringPiece> pieces;
+    std::vector<size_t> findLens(num > 0 ? num : 0);
+    bool firstChars[256] = { false };
+    const char *src = c_str();
+    const char *end = src + getLen();
+
+    for (int n = 0; n < num; n++)
     {
-        if (strncmp(&this->data[i], findStr.c_str(), findLen) == 0)
-        {
-            if (newData.isEmpty() == false && newData.getLen() > 0)
-            {
-                output.append(newData);
-                /*if (output[getLen()] == '\0')
-                {
-                    output.setLen(output.getLen()-1); // Remove '\0'
-                }*/
-            }
-            inputLen += findLen;
-            i += findLen;
-        }
-        else
+        findLens[n] = findStrs[n] ? strlen(findStrs[n]) : 0;
+
+        if (findLens[n] > 0)
         {
-            // Add the character.
-            output.append(this->data[i]);
-            i += 1;
+            firstChars[(unsigned char)findStrs[n][0]] = true;
         }
     }
 
-    // Append '\0'
-    if (output[getLen()] != '\0')
+    if (num == 1)
     {
-        output.append('\0');
+        // strstr doesn't go back over text, so it's linear time
+        const char *p;
+
+        if (findLens[0] == 0)
+        {
+            return String(*this);
+        }
+
+        while ((p = strstr(src, findStrs[0])) != NULL)
+        {
+            pieces.push_back(StringPiece(src, p - src));
+            pieces.push_back(StringPiece(newDatas[0] ? newDatas[0] : "", newDatas[0] ? strlen(newDatas[0]) : 0));
+            src = p + findLens[0];
+        }
     }
+    else
+    {
+        // only try the finds where the first character matches one of them
+        for (const char *p = src; p < end; /* */)
+        {
+            int match = -1;
 
-    return output;
-}
+            if (firstChars[(unsigned char)*p])
+            {
+                for (int n = 0; n < num; n++)
+                {
+                    // longest match wins
+                    if (findLens[n] > 0 && findLens[n] <= (size_t)(end - p)
+                        && (match == -1 || findLens[n] > findLens[match])
+                        && !memcmp(p, findStrs[n], findLens[n]))
+                    {
+                        match = n;
+                    }
+                }
+            }
 
-/*
-    String::replaceString
-    Returns a String.
-*/
-String String::replaceString(const char *findStr, const char *newData) const
-{
-    String output;
-    String find, set;
+            if (match == -1)
+            {
+                ++p;
+                continue;
+            }
 
-    if (findStr == NULL)
+            pieces.push_back(StringPiece(src, p - src));
+            pieces.push_back(StringPiece(newDatas[match] ? newDatas[match] : "", newDatas[match] ? strlen(newDatas[match]) : 0));
+            p += findLens[match];
+            src = p;
+        }
+    }
+
+    if (pieces.empty())
     {
         return String(*this);
     }
 
-    find.setData(findStr);
-    set.setData(newData);
+    pieces.push_back(StringPiece(src, end - src));
+    JoinPieces(output, pieces);
 
-    output.setData(replaceString(find,set));
     return output;
 }
 
@@ -1168,6 +1515,11 @@ String String::subscript(size_t start, size_t end) const
     char *temp = NULL;
     String str;
 
+    if (data == NULL)
+    {
+        return str;
+    }
+
     if (end > getLen())
     {
         end = getLen();
@@ -1228,25 +1580,18 @@ String String::subscript(size_t start, size_t end) const
 */
 void String::insert(size_t where, char character)
 {
-#if 1
-    String /*s1, */s2;
-
-    //s1 = subscript(0, where-1);
-    s2 = subscript(where, getLen());
-
-    //setLen(0);
-    setLen(where);
+    size_t oldLen = getLen();
 
-    //append(s1);
-    append(character);
-    append(s2);
+    // inserting past the end pads with '\0's
+    if (where > oldLen)
+    {
+        oldLen = where;
+    }
 
-#else // Doesn't seem to work.
-    setLen(getLen()+1);
+    setLen(oldLen + 1);
 
-    strcpy(&this->data[where+1], &this->data[where]);
+    memmove(&this->data[where+1], &this->data[where], oldLen - where);
     this->data[where] = character;
-#endif
 }
 
 /*
@@ -1262,8 +1607,8 @@ void String::remove(size_t start, size_t len)
     if (len > getLen()-start)
         len = getLen()-start;
 
-    strcpy(&this->data[start], &this->data[start+len]);
-    setLen(getLen() - len);
+    memmove(&this->data[start], &this->data[start+len], getLen()-start-len+1);
+    shrink(getLen() - len);
 }
 
 /*
@@ -1278,6 +1623,9 @@ char &String::operator[](unsigned int index) const
 
 char &String::charAtIndex(unsigned int index) const
 {
+    // the character may be changed
+    foldHash = 0;
+
     if (index >= getLen())
     {
         static char dummy;
@@ -1302,7 +1650,27 @@ String String::operator=(const char *str)
 
 bool String::operator==(const String &str) const
 {
-    return (icompareTo(str) == 0);
+    if (getLen() != str.getLen())
+    {
+        return false;
+    }
+
+    // only use hashes that are already known
+    if (foldHash != 0 && str.foldHash != 0 && foldHash != str.foldHash)
+    {
+        return false;
+    }
+
+    return (FoldCompareKnown(c_str(), str.c_str(), getLen()) == 0);
+}
+
+bool String::operator==(const char *str) const
+{
+    if (str == NULL)
+    {
+        return false;
+    }
+    return (FoldCompare(c_str(), str) == 0);
 }
 
 } // end namespace AngelCommunication
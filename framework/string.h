@@ -32,11 +32,44 @@ freely, subject to the following restrictions:
 #define ANGEL_STRING_INCLUDED
 
 #include <cstdlib>
+#include <cstdarg>
 #include <vector>
 
 namespace AngelCommunication
 {
 
+class String;
+
+/*
+    StringValue
+    A value for String::setValues/appendValues. Strings are pointed to and
+    numbers are converted into a small buffer, so building a String from
+    values needs no printf format parsing and only one allocation.
+*/
+class StringValue
+{
+    public:
+        const char *text;
+        size_t len;
+
+        StringValue(const char *str);
+        StringValue(const String &str);
+        StringValue(char c);
+        StringValue(int n);
+        StringValue(unsigned int n);
+        StringValue(long n);
+        StringValue(unsigned long n);
+        StringValue(long long n);
+        StringValue(unsigned long long n);
+        StringValue(double n);
+        StringValue(const StringValue &other);
+
+    private:
+        char number[32];
+
+        StringValue &operator=(const StringValue &other);
+};
+
 /*
     String Class
     Simple string class to make handling char* simpler.
@@ -47,6 +80,13 @@ class String
     private:
         char *data; // pointer to the text.
         unsigned int len; // length of the text, doesn't count the null.
+        mutable unsigned int foldHash; // cached getFoldHash(), 0 if not computed.
+
+        static int FoldCompareKnown(const char *a, const char *b, size_t n);
+
+        void shrink(unsigned int newlen);
+        int vformat(unsigned int offset, size_t nsize, const char *format, va_list args);
+        void joinValues(unsigned int offset, const StringValue *values, size_t num);
 
     public:
         String(const String &text);
@@ -62,6 +102,13 @@ class String
         void setData(const String *text);
         void setData(const char *newData);
 
+        /*
+            getBuffer
+            Sets the length and returns the text so it can be written in
+            place. Returns NULL if newlen is 0.
+        */
+        char *getBuffer(unsigned int newlen);
+
         int compareTo(const String &str, int len = -1) const;
         int compareTo(const String *str, int len = -1) const;
         int compareTo(const char *str, int len = -1) const;
@@ -70,6 +117,21 @@ class String
         int icompareTo(const String *str, int len = -1) const;
         int icompareTo(const char *str, int len = -1) const;
 
+        /*
+            FoldCompare
+            Compares ASCII letters ignoring case, doesn't depend on locale.
+        */
+        static int FoldCompare(const char *a, const char *b, size_t n = (size_t)-1);
+
+        /*
+            getFoldHash
+            Returns a hash of the text ignoring ASCII case. It's saved until
+            the String is changed, so comparing Strings with different hashes
+            is fast.
+        */
+        unsigned int getFoldHash(void) const;
+        static unsigned int FoldHash(const char *str);
+
         bool validString(const unsigned long min) const;
 		static bool validString(const char *string, const unsigned long min);
 
@@ -106,6 +168,29 @@ class String
         */
         int append_snprintf(size_t nsize, const char *format, ...);
 
+        /*
+            setValues
+            Replaces this String with the values joined together, e.g.
+            str.setValues("Sentence ", 2, ": ", line);
+        */
+        template<typename... Values>
+        void setValues(const Values &... values)
+        {
+            const StringValue list[] = { StringValue(values)... };
+            joinValues(0, list, sizeof...(values));
+        }
+
+        /*
+            appendValues
+            Adds the values to the end of this String.
+        */
+        template<typename... Values>
+        void appendValues(const Values &... values)
+        {
+            const StringValue list[] = { StringValue(values)... };
+            joinValues(len, list, sizeof...(values));
+        }
+
         /*
             append
             Addes str (or character) to the end of this String.
@@ -126,9 +211,17 @@ class String
             replaceString
             Replaces all occerences of findStr with newData.
         */
-        String replaceString(String findStr, String newData) const;
+        String replaceString(const String &findStr, const String &newData) const;
         String replaceString(const char *findStr, const char *newData) const;
 
+        /*
+            replaceStrings
+            Replaces all occerences of each findStrs[n] with newDatas[n] in
+            one pass. If more than one is found at the same place the longest
+            is replaced.
+        */
+        String replaceStrings(const char * const *findStrs, const char * const *newDatas, int num) const;
+
         /*
             subscript
             Returns a String containing the data from start to end.
@@ -163,7 +256,9 @@ class String
         String operator=(const String &str);
         String operator=(const char *str);
 
+        // case-insensitive
         bool operator==(const String &str) const;
+        bool operator==(const char *str) const;
 };
 
 } // end namespace AngelCommunication
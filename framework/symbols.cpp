@@ -0,0 +1,101 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "symbols.h"
+
+namespace AngelCommunication
+{
+
+size_t NickHash::operator()( const String &nick ) const
+{
+	return nick.getFoldHash();
+}
+
+bool NickEqual::operator()( const String &a, const String &b ) const
+{
+	return !a.icompareTo( b );
+}
+
+SymbolTable::SymbolTable()
+{
+	// must be in the same order as SYM_* enum
+	this->names.push_back( "" );
+	this->names.push_back( "*anybody" );
+	this->names.push_back( "*nobody" );
+
+	this->ids[this->names[SYM_ANYBODY]] = SYM_ANYBODY;
+	this->ids[this->names[SYM_NOBODY]] = SYM_NOBODY;
+}
+
+SymbolTable &SymbolTable::Get()
+{
+	static SymbolTable table;
+
+	return table;
+}
+
+int SymbolTable::Intern( const String &name )
+{
+	SymbolTable &table = Get();
+
+	if ( name.isEmpty() ) {
+		return SYM_NONE;
+	}
+
+	std::unordered_map<String, int, NickHash, NickEqual>::const_iterator it = table.ids.find( name );
+
+	if ( it != table.ids.end() ) {
+		return it->second;
+	}
+
+	int symbol = table.names.size();
+
+	table.names.push_back( name );
+	table.ids[name] = symbol;
+
+	return symbol;
+}
+
+int SymbolTable::Find( const String &name )
+{
+	SymbolTable &table = Get();
+	std::unordered_map<String, int, NickHash, NickEqual>::const_iterator it = table.ids.find( name );
+
+	if ( it == table.ids.end() ) {
+		return SYM_NONE;
+	}
+
+	return it->second;
+}
+
+const String &SymbolTable::GetName( int symbol )
+{
+	SymbolTable &table = Get();
+
+	if ( symbol < 0 || symbol >= (int)table.names.size() ) {
+		return table.names[SYM_NONE];
+	}
+
+	return table.names[symbol];
+}
+
+} // end namespace AngelCommunication
@@ -0,0 +1,79 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ANGEL_SYMBOLS_INCLUDED
+#define ANGEL_SYMBOLS_INCLUDED
+
+#include <vector>
+#include <unordered_map>
+
+#include "string.h"
+
+namespace AngelCommunication
+{
+
+// case-insensitive hash and compare for nick lookups
+class NickHash
+{
+	public:
+		size_t operator()( const String &nick ) const;
+};
+
+class NickEqual
+{
+	public:
+		bool operator()( const String &a, const String &b ) const;
+};
+
+// reserved symbols
+enum
+{
+	SYM_NONE,		// not a symbol
+	SYM_ANYBODY,	// "*anybody", message is for everyone
+	SYM_NOBODY		// "*nobody", message isn't for anyone
+};
+
+/*
+	SymbolTable class
+	Gives each name (nicks and special addressees) an id so they can be
+	compared as integers. Names differing only in case get the same id.
+	Ids are never freed so each name keeps its id for the life of the program.
+*/
+class SymbolTable
+{
+	private:
+		std::unordered_map<String, int, NickHash, NickEqual> ids;
+		std::vector<String> names;	// name of each id, as first added
+
+		SymbolTable();
+
+		static SymbolTable &Get();
+
+	public:
+		static int Intern( const String &name );		// add name if needed and return id
+		static int Find( const String &name );			// SYM_NONE if name was never added
+		static const String &GetName( int symbol );
+};
+
+} // end namespace AngelCommunication
+
+#endif // ANGEL_SYMBOLS_INCLUDED
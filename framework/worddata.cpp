@@ -0,0 +1,703 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <stdio.h> // snprintf
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#include "worddata.h"
+#include "log.h"
+
+namespace AngelCommunication
+{
+
+/*
+	Binary format (native byte order, all values are 32-bit unsigned ints)
+
+	header:		"ANGD", version, numLists, stringsOffset, stringsSize
+	lists:		numLists * { nameOffset, numEntries, numFields, entriesOffset }
+	entries:	numEntries * numFields values. string fields are offsets into strings.
+	strings:	'\0' terminated strings
+*/
+#define WORDDATA_MAGIC		"ANGD"
+#define WORDDATA_VERSION	1
+#define WORDDATA_HEADER		5
+#define WORDDATA_LISTHEADER	4
+
+struct listSchema_s {
+	const char	*name;
+	const char	*fields;	// 's' for string, 'i' for integer
+	bool		sorted;		// sorted by first field for lookups
+} listSchemas[WL_MAX] = {
+	{ "filler",			"s",	true },
+	{ "cancel",			"s",	true },
+	{ "false",			"s",	true },
+	{ "true",			"s",	true },
+	{ "interrogative",	"s",	true },
+	{ "modal",			"s",	true },
+	{ "auxiliary",		"s",	true },
+	{ "linking",		"s",	true },
+	{ "command",		"s",	true },
+	{ "misc",			"s",	true },
+	{ "punctuation",	"s",	true },
+	{ "quote",			"s",	true },
+	{ "pronoun",		"s",	true },
+	{ "greetings",		"si",	false },
+	{ "statements",		"ssi",	false },
+	{ "replies",		"ss",	true },
+};
+
+//
+// Built-in data, used when no data file is loaded.
+// Built-in replies are in replytemplate.cpp.
+//
+
+const char *fillerWords[] = {
+	"a", "an", "the", "so", "be", "eh", "um", "ah", "oh", "hhhhhh", "mm", "mmm", "very", "really", NULL
+};
+
+const char *cancelWords[] = {
+	"nothing", "nevermind", "nm", "nvm", "never mind" /* FIXME can't have spaces in words yet */, NULL
+};
+
+const char *falseWords[] = {
+	"false", "no", NULL
+};
+
+const char *trueWords[] = {
+	"true", "yes", "yeah", "yea", "yeas", "yah", "yep", "ye", "aye", "okay", "mm", "mmm", NULL
+};
+
+// http://en.wikipedia.org/wiki/Interrogative_word
+const char *interrogativeWords[] = {
+	"which", "what",
+	"whose",
+	"who", "whom",
+	"where",
+	"whence",
+	"whither",
+	"when",
+	"how",
+	"why", "wherefore",
+	"whether",
+	NULL
+};
+
+// http://en.wikipedia.org/wiki/English_modal_verbs
+// these are also considered to be auxiliary verbs
+const char *modalVerbs[] = {
+	"can", "could", "may", "might", "must", "shall", "should", "will", "would", NULL
+};
+
+// http://en.wikipedia.org/wiki/Auxiliary_verb
+// NOTE: modal verbs and auxiliary verbs are treated the same by this program
+// NOTE: "do" is in the commandWords list instead of here
+const char *auxiliaryVerbs[] = {
+	"am", "are", "be", "been", "being", "did", "does", "had", "has", "is", "was", "were",
+
+	// this was in commandWords, but it's kind of more stating something rather than a command
+	"have",
+
+	// like is uber complicated and not always a verb
+	"like",
+	"love",
+
+	NULL
+};
+
+// http://en.wikipedia.org/wiki/Copula_(linguistics)
+// NOTE: modal verbs and linking verbs are treated the same by this program
+const char *linkingVerbs[] = {
+	"to", // NOTE: I don't think this is considered a linking verb
+	NULL
+};
+
+// Words that are a command.
+// hmm, are these all 'main verbs'? main verb means can be a predicate by itself.
+const char *commandWords[] = {
+	// http://ogden.basic-english.org/verbs.html
+	"be", "come", "give", "make",
+	/*"have", */"go", "get", "send",
+	"do", "put", "keep", "see",
+	"seem", "take", "let", "say",
+	// There are said to sometimes be used as operators.
+	// ZTM: "because" probably needs to be a conjunction word in some cases
+	"cause", "because",
+
+	// ZTM: not part of list for Basic English verbs / operators. might not be correct handling.
+	"set", "enable", "disable", "stop", "start", "restart",
+
+	NULL
+};
+
+const char *miscVerbs[] = {
+	NULL
+};
+
+#if 0
+// http://www.scientificpsychic.com/grammar/enggramg.html
+const char *prepositionWords[] = {
+	"from", "toward", "in", "about", "over", "above", "under", "at", "below", NULL
+};
+#endif
+
+const char *punctuationMarks[] = {
+	".", "!", "?", ",", ";", NULL
+};
+
+const char *quoteMarks[] = {
+	"\"", "\'", "`", NULL
+};
+
+const char *pronouns[] = {
+	"i", "me", "my", "you", "your", "he", "him", "his", "she", "her", "it", "its", "we", "us", "our", "they", "them", "their",
+	"this", "that", "these", "those", NULL
+};
+
+struct greetingType_s {
+	const char	*text;
+	int			flags;
+} greetingTypes[] = {
+	{ "Hi",				0 },
+	{ "Hello",			0 },
+	{ "'ello",			0 },
+	{ "ello",			0 },
+	{ "Hey",			0 }, // not always a greeting...
+	{ "ohai",			0 },
+	{ "ohayou",			0 }, // Ohayou Gozaimasu
+	{ "I acknowledge your existence", 0 },
+	{ "Bye",			GTF_BYE },
+	{ "Good bye",		GTF_BYE },
+	{ "Goodbye",		GTF_BYE },
+	{ "Good night",		GTF_NIGHT },
+	{ "gn",				GTF_NIGHT },
+	{ "sleep",			GTF_NIGHT },
+	{ "sleep time",		GTF_NIGHT },
+	{ "sleep taim",		GTF_NIGHT },
+	{ "Welcome",		GTF_SPECIAL }, // not really special but don't want saying a lot
+	{ "Good morning",	GTF_SPECIAL },
+	{ "Good afternoon",	GTF_SPECIAL },
+	{ "Good evening",	GTF_SPECIAL },
+	{ "Merry Christmas",GTF_SPECIAL },
+	{ NULL, 0 }
+};
+
+struct statement_s {
+	const char	*msg, *reply;
+	bool		random;
+} statements[] = {
+	//{ "Yes", "No", true },
+	//{ "No", "Yes", true },
+	{ "Marco", "Polo", true },
+	{ "Thanks", "Don't mention it", false },
+	{ "Thank you", "Don't mention it", false },
+	{ "Dumb", "No you", false },
+	{ "Your stupid", "*You're stupid. >.>", false },
+	{ "You're stupid", "It's not my fault.", false },
+	{ "Your dumb", "*You're dumb. <.<", false },
+	{ "You're dumb", "It's not my fault.", false },
+	{ "Dummy", "It's not my fault.", false },
+	{ "Stupid", "It's not my fault.", false },
+	{ "make", "You need to quit before you can rebuild", false },
+	{ "Can I ask a question", "Don't ask to ask. Just ask your question.", false },
+	{ "Can I ask you a question", "Don't ask to ask. Just ask your question.", false },
+	{ NULL, NULL, false }
+};
+
+const char **builtinWordLists[WL_GREETINGS] = {
+	fillerWords,
+	cancelWords,
+	falseWords,
+	trueWords,
+	interrogativeWords,
+	modalVerbs,
+	auxiliaryVerbs,
+	linkingVerbs,
+	commandWords,
+	miscVerbs,
+	punctuationMarks,
+	quoteMarks,
+	pronouns,
+};
+
+// ASCII case-insensitive compare, so sort order doesn't depend on locale
+static int FoldCompare( const char *a, const char *b )
+{
+	return String::FoldCompare( a, b );
+}
+
+const char *WordData::GetListName( WordList list )
+{
+	if ( list < 0 || list >= WL_MAX ) {
+		return NULL;
+	}
+
+	return listSchemas[list].name;
+}
+
+static int FindList( const char *name )
+{
+	for ( int i = 0; i < WL_MAX; i++ ) {
+		if ( !strcmp( listSchemas[i].name, name ) ) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+//
+// WordDataBuilder
+//
+
+void WordDataBuilder::clear()
+{
+	for ( int i = 0; i < WL_MAX; i++ ) {
+		this->lists[i].clear();
+	}
+}
+
+bool WordDataBuilder::addEntry( WordList list, const char **fields, int numFields )
+{
+	const char *types = listSchemas[list].fields;
+	Entry entry;
+
+	if ( numFields != (int)strlen( types ) || !fields[0] || !fields[0][0] ) {
+		return false;
+	}
+
+	for ( int i = 0; i < numFields; i++ ) {
+		entry.fields.push_back( fields[i] );
+	}
+
+	this->lists[list].push_back( entry );
+	return true;
+}
+
+bool WordDataBuilder::parseText( const char *text, const char *filename )
+{
+	int list = -1;
+	int lineNum = 0;
+	bool okay = true;
+	const char *line = text;
+	std::vector<char> buf;
+
+	while ( *line ) {
+		const char *end = strchr( line, '\n' );
+
+		if ( !end ) {
+			end = line + strlen( line );
+		}
+
+		lineNum++;
+		buf.assign( line, end );
+		line = *end ? end + 1 : end;
+
+		// remove windows line ending
+		if ( !buf.empty() && buf[buf.size()-1] == '\r' ) {
+			buf.pop_back();
+		}
+
+		if ( buf.empty() || buf[0] == '#' ) {
+			continue;
+		}
+
+		buf.push_back( '\0' );
+
+		if ( buf[0] == '[' ) {
+			char *close = strchr( &buf[0], ']' );
+
+			if ( !close || close[1] != '\0' ) {
+				Log::Printf( LOG_WARNING, "data", "WARNING: %s:%d: missing ']'", filename, lineNum );
+				okay = false;
+				list = -1;
+				continue;
+			}
+
+			*close = '\0';
+			list = FindList( &buf[1] );
+			if ( list == -1 ) {
+				Log::Printf( LOG_WARNING, "data", "WARNING: %s:%d: unknown list %s", filename, lineNum, &buf[1] );
+				okay = false;
+			}
+			continue;
+		}
+
+		if ( list == -1 ) {
+			continue;
+		}
+
+		// split at tabs
+		const char *fields[8];
+		int numFields = 0;
+		char *p = &buf[0];
+
+		fields[numFields++] = p;
+		while ( ( p = strchr( p, '\t' ) ) != NULL && numFields < 8 ) {
+			*p++ = '\0';
+			fields[numFields++] = p;
+		}
+
+		if ( !addEntry( (WordList)list, fields, numFields ) ) {
+			Log::Printf( LOG_WARNING, "data", "WARNING: %s:%d: %s entries need %d field(s)", filename, lineNum, listSchemas[list].name, (int)strlen( listSchemas[list].fields ) );
+			okay = false;
+		}
+	}
+
+	return okay;
+}
+
+bool WordDataBuilder::parseFile( const char *filename )
+{
+	std::ifstream input( filename, std::ios::in | std::ios::binary );
+	std::vector<char> text;
+
+	if ( !input.good() ) {
+		Log::Printf( LOG_WARNING, "data", "WARNING: Failed to open %s", filename );
+		return false;
+	}
+
+	text.assign( std::istreambuf_iterator<char>( input ), std::istreambuf_iterator<char>() );
+	text.push_back( '\0' );
+
+	return parseText( &text[0], filename );
+}
+
+void WordDataBuilder::addBuiltin()
+{
+	const char *fields[3];
+	char number[16];
+
+	for ( int list = 0; list < WL_GREETINGS; list++ ) {
+		for ( int i = 0; builtinWordLists[list][i] != NULL; i++ ) {
+			addEntry( (WordList)list, &builtinWordLists[list][i], 1 );
+		}
+	}
+
+	for ( int i = 0; greetingTypes[i].text != NULL; i++ ) {
+		::snprintf( number, sizeof ( number ), "%d", greetingTypes[i].flags );
+		fields[0] = greetingTypes[i].text;
+		fields[1] = number;
+		addEntry( WL_GREETINGS, fields, 2 );
+	}
+
+	for ( int i = 0; statements[i].msg != NULL; i++ ) {
+		fields[0] = statements[i].msg;
+		fields[1] = statements[i].reply;
+		fields[2] = statements[i].random ? "1" : "0";
+		addEntry( WL_STATEMENTS, fields, 3 );
+	}
+}
+
+class EntryFoldLess
+{
+	public:
+		const std::vector<String> *strings;
+
+		bool operator()( unsigned int a, unsigned int b ) const
+		{
+			return FoldCompare( (*strings)[a].c_str(), (*strings)[b].c_str() ) < 0;
+		}
+};
+
+static void PutInt( std::vector<char> &out, size_t offset, unsigned int value )
+{
+	memcpy( &out[offset], &value, sizeof ( value ) );
+}
+
+void WordDataBuilder::compile( std::vector<char> &out ) const
+{
+	std::vector<char> strings;
+	size_t offset;
+
+	// header and list headers
+	out.assign( ( WORDDATA_HEADER + WORDDATA_LISTHEADER * WL_MAX ) * 4, '\0' );
+	memcpy( &out[0], WORDDATA_MAGIC, 4 );
+	PutInt( out, 4, WORDDATA_VERSION );
+	PutInt( out, 8, WL_MAX );
+
+	for ( int list = 0; list < WL_MAX; list++ ) {
+		const std::vector<Entry> &entries = this->lists[list];
+		const char *types = listSchemas[list].fields;
+		unsigned int numFields = (unsigned int)strlen( types );
+		std::vector<unsigned int> order;
+		size_t listHeader = ( WORDDATA_HEADER + WORDDATA_LISTHEADER * list ) * 4;
+
+		for ( size_t i = 0; i < entries.size(); i++ ) {
+			order.push_back( (unsigned int)i );
+		}
+
+		if ( listSchemas[list].sorted ) {
+			std::vector<String> keys;
+			EntryFoldLess less;
+
+			for ( size_t i = 0; i < entries.size(); i++ ) {
+				keys.push_back( entries[i].fields[0] );
+			}
+
+			less.strings = &keys;
+			std::stable_sort( order.begin(), order.end(), less );
+		}
+
+		PutInt( out, listHeader, (unsigned int)strings.size() );
+		strings.insert( strings.end(), listSchemas[list].name, listSchemas[list].name + strlen( listSchemas[list].name ) + 1 );
+		PutInt( out, listHeader + 4, (unsigned int)entries.size() );
+		PutInt( out, listHeader + 8, numFields );
+		PutInt( out, listHeader + 12, (unsigned int)out.size() );
+
+		offset = out.size();
+		out.resize( out.size() + entries.size() * numFields * 4 );
+
+		for ( size_t i = 0; i < order.size(); i++ ) {
+			const Entry &entry = entries[order[i]];
+
+			for ( unsigned int f = 0; f < numFields; f++, offset += 4 ) {
+				if ( types[f] == 'i' ) {
+					PutInt( out, offset, (unsigned int)atoi( entry.fields[f].c_str() ) );
+				} else {
+					PutInt( out, offset, (unsigned int)strings.size() );
+					strings.insert( strings.end(), entry.fields[f].c_str(), entry.fields[f].c_str() + entry.fields[f].getLen() + 1 );
+				}
+			}
+		}
+	}
+
+	PutInt( out, 12, (unsigned int)out.size() );
+	PutInt( out, 16, (unsigned int)strings.size() );
+	out.insert( out.end(), strings.begin(), strings.end() );
+}
+
+//
+// WordData
+//
+
+WordData *WordData::current = NULL;
+unsigned int WordData::numGenerations = 0;
+
+WordData::WordData()
+	: base( NULL ), size( 0 ), strings( NULL ), stringsSize( 0 )
+{
+	for ( int i = 0; i < WL_MAX; i++ ) {
+		this->entries[i] = NULL;
+		this->numEntries[i] = 0;
+		this->numFields[i] = 0;
+	}
+
+	this->generation = ++numGenerations;
+}
+
+WordData::~WordData()
+{
+}
+
+static unsigned int GetInt( const char *base, size_t offset )
+{
+	unsigned int value;
+
+	memcpy( &value, base + offset, sizeof ( value ) );
+	return value;
+}
+
+// Check that all offsets are inside of the data and set up list pointers.
+bool WordData::validate( const char *filename )
+{
+	unsigned int numLists, stringsOffset;
+
+	if ( this->size < WORDDATA_HEADER * 4 || memcmp( this->base, WORDDATA_MAGIC, 4 ) ) {
+		Log::Printf( LOG_WARNING, "data", "WARNING: %s is not a word data file", filename );
+		return false;
+	}
+
+	if ( GetInt( this->base, 4 ) != WORDDATA_VERSION ) {
+		Log::Printf( LOG_WARNING, "data", "WARNING: %s has wrong version %u (should be %d)", filename, GetInt( this->base, 4 ), WORDDATA_VERSION );
+		return false;
+	}
+
+	numLists = GetInt( this->base, 8 );
+	stringsOffset = GetInt( this->base, 12 );
+	this->stringsSize = GetInt( this->base, 16 );
+
+	if ( stringsOffset > this->size || this->stringsSize > this->size - stringsOffset
+		|| this->stringsSize == 0 || this->base[stringsOffset + this->stringsSize - 1] != '\0'
+		|| numLists > ( this->size / 4 - WORDDATA_HEADER ) / WORDDATA_LISTHEADER ) {
+		Log::Printf( LOG_WARNING, "data", "WARNING: %s is corrupt", filename );
+		return false;
+	}
+
+	this->strings = this->base + stringsOffset;
+
+	for ( unsigned int i = 0; i < numLists; i++ ) {
+		size_t listHeader = ( WORDDATA_HEADER + WORDDATA_LISTHEADER * i ) * 4;
+		unsigned int nameOffset = GetInt( this->base, listHeader );
+		unsigned int count = GetInt( this->base, listHeader + 4 );
+		unsigned int fields = GetInt( this->base, listHeader + 8 );
+		unsigned int offset = GetInt( this->base, listHeader + 12 );
+		int list;
+
+		if ( nameOffset >= this->stringsSize || ( offset & 3 ) || offset > this->size
+			|| ( fields && count > ( this->size - offset ) / 4 / fields ) ) {
+			Log::Printf( LOG_WARNING, "data", "WARNING: %s is corrupt", filename );
+			return false;
+		}
+
+		list = FindList( this->strings + nameOffset );
+		if ( list == -1 ) {
+			// unknown lists are skipped so newer files still load
+			continue;
+		}
+
+		const char *types = listSchemas[list].fields;
+		if ( fields < strlen( types ) ) {
+			Log::Printf( LOG_WARNING, "data", "WARNING: %s list %s has %u fields (should be %d)", filename, listSchemas[list].name, fields, (int)strlen( types ) );
+			return false;
+		}
+
+		this->entries[list] = (const unsigned int *)( this->base + offset );
+		this->numEntries[list] = count;
+		this->numFields[list] = fields;
+
+		for ( unsigned int e = 0; e < count; e++ ) {
+			for ( unsigned int f = 0; types[f]; f++ ) {
+				if ( types[f] == 's' && this->entries[list][e * fields + f] >= this->stringsSize ) {
+					Log::Printf( LOG_WARNING, "data", "WARNING: %s is corrupt", filename );
+					return false;
+				}
+			}
+
+			if ( listSchemas[list].sorted && e > 0 && FoldCompare( getString( (WordList)list, e - 1, 0 ), getString( (WordList)list, e, 0 ) ) > 0 ) {
+				Log::Printf( LOG_WARNING, "data", "WARNING: %s list %s is not sorted", filename, listSchemas[list].name );
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool WordData::inList( WordList list, const String &word ) const
+{
+	return inList( list, word.c_str() );
+}
+
+bool WordData::inList( WordList list, const char *word ) const
+{
+	return findEntry( list, word ) != -1;
+}
+
+// binary search, lists are sorted case-insensitively
+int WordData::findEntry( WordList list, const char *key ) const
+{
+	int low = 0, high = (int)this->numEntries[list] - 1;
+
+	while ( low <= high ) {
+		int mid = ( low + high ) / 2;
+		int cmp = FoldCompare( key, getString( list, mid, 0 ) );
+
+		if ( cmp == 0 )
+			return mid;
+		else if ( cmp < 0 )
+			high = mid - 1;
+		else
+			low = mid + 1;
+	}
+
+	return -1;
+}
+
+size_t WordData::getNumEntries( WordList list ) const
+{
+	return this->numEntries[list];
+}
+
+const char *WordData::getString( WordList list, size_t entry, int field ) const
+{
+	if ( entry >= this->numEntries[list] ) {
+		return "";
+	}
+
+	return this->strings + this->entries[list][entry * this->numFields[list] + field];
+}
+
+int WordData::getInt( WordList list, size_t entry, int field ) const
+{
+	if ( entry >= this->numEntries[list] ) {
+		return 0;
+	}
+
+	return (int)this->entries[list][entry * this->numFields[list] + field];
+}
+
+unsigned int WordData::getGeneration() const
+{
+	return this->generation;
+}
+
+const WordData *WordData::Current()
+{
+	if ( !current ) {
+		WordDataBuilder builder;
+		WordData *data = new WordData();
+		std::vector<char> contents;
+
+		builder.addBuiltin();
+		builder.compile( contents );
+		data->file.assign( contents );
+
+		data->base = data->file.getData();
+		data->size = data->file.getSize();
+		data->validate( "built-in data" );
+
+		current = data;
+	}
+
+	return current;
+}
+
+bool WordData::Load( const char *filename )
+{
+	WordData *data = new WordData();
+
+	if ( !data->file.open( filename ) ) {
+		Log::Printf( LOG_WARNING, "data", "WARNING: Failed to open %s", filename );
+		delete data;
+		return false;
+	}
+
+	data->base = data->file.getData();
+	data->size = data->file.getSize();
+
+	if ( !data->validate( filename ) ) {
+		delete data;
+		return false;
+	}
+
+	// Only swapped from the main loop, so nothing is still using the old data.
+	delete current;
+	current = data;
+
+	Log::Printf( LOG_INFO, "data", "Loaded word data from %s", filename );
+	return true;
+}
+
+} // end namespace AngelCommunication
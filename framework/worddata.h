@@ -0,0 +1,138 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ANGEL_WORDDATA_INCLUDED
+#define ANGEL_WORDDATA_INCLUDED
+
+#include <vector>
+
+#include "string.h"
+#include "mappedfile.h"
+
+namespace AngelCommunication
+{
+
+// word lists and rule tables that can be loaded from a data file
+enum WordList
+{
+	WL_FILLER,
+	WL_CANCEL,
+	WL_FALSE,
+	WL_TRUE,
+	WL_INTERROGATIVE,
+	WL_MODAL,
+	WL_AUXILIARY,
+	WL_LINKING,
+	WL_COMMAND,
+	WL_MISC,
+	WL_PUNCTUATION,
+	WL_QUOTE,
+	WL_PRONOUN,
+	WL_GREETINGS,	// fields: text, flags (GTF_*)
+	WL_STATEMENTS,	// fields: message, reply, random
+	WL_REPLIES,		// fields: name, template (see ReplyTemplate)
+
+	WL_MAX
+};
+
+// greeting flags
+#define GTF_SPECIAL 1 // one does not just say Merry Christmas whenever.
+#define GTF_BYE		2
+#define GTF_NIGHT	4
+
+/*
+	WordDataBuilder class
+	Collects list entries and writes the binary data format.
+
+	The text format is a list name in brackets followed by one entry per line,
+	with fields separated by tabs. Lines starting with # are comments.
+
+	[filler]
+	um
+	[greetings]
+	Good night	4
+*/
+class WordDataBuilder
+{
+	private:
+		class Entry
+		{
+			public:
+				std::vector<String> fields;
+		};
+
+		std::vector<Entry> lists[WL_MAX];
+
+	public:
+		void clear();
+		bool addEntry( WordList list, const char **fields, int numFields );
+		bool parseText( const char *text, const char *filename );
+		bool parseFile( const char *filename );
+		void addBuiltin();
+		void compile( std::vector<char> &out ) const;
+};
+
+/*
+	WordData class
+	Read-only view of the binary data format. Data files are memory mapped so
+	processes using the same file share the pages.
+*/
+class WordData
+{
+	private:
+		MappedFile		file;
+		const char		*base;
+		size_t			size;
+
+		const unsigned int	*entries[WL_MAX];
+		unsigned int	numEntries[WL_MAX];
+		unsigned int	numFields[WL_MAX];
+		const char		*strings;
+		unsigned int	stringsSize;
+		unsigned int	generation;
+
+		static WordData *current;
+		static unsigned int numGenerations;
+
+		WordData();
+		bool validate( const char *filename );
+
+	public:
+		~WordData();
+
+		bool inList( WordList list, const String &word ) const;
+		bool inList( WordList list, const char *word ) const;
+		int findEntry( WordList list, const char *key ) const; // sorted lists only, -1 if not found
+		size_t getNumEntries( WordList list ) const;
+		const char *getString( WordList list, size_t entry, int field ) const;
+		int getInt( WordList list, size_t entry, int field ) const;
+		unsigned int getGeneration() const;
+
+		// Replace the current data. Returns false (keeping current data) if the file can't be used.
+		static bool Load( const char *filename );
+		static const WordData *Current();
+		static const char *GetListName( WordList list );
+};
+
+} // end namespace AngelCommunication
+
+#endif // ANGEL_WORDDATA_INCLUDED
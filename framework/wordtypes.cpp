@@ -20,65 +20,37 @@ freely, subject to the following restrictions:
 */
 
 #include "wordtypes.h"
+#include "worddata.h"
 
 namespace AngelCommunication
 {
 
-const char *fillerWords[] = {
-	"a", "an", "the", "so", "be", "eh", "um", "ah", "oh", "hhhhhh", "mm", "mmm", "very", "really"
-};
-
-const char *cancelWords[] = {
-	"nothing", "nevermind", "nm", "nvm", "never mind" /* FIXME can't have spaces in words yet */
-};
-
-const char *falseWords[] = {
-	"false", "no",
-};
-
-const char *trueWords[] = {
-	"true", "yes", "yeah", "yea", "yeas", "yah", "yep", "ye", "aye", "okay", "mm", "mmm"
-};
-
 int	WordType( const String & str ) {
-	int i;
 	int type = 0;
 	Lexer tokens( str );
+	const WordData *words = WordData::Current();
 
 	// assume filler unless proven otherwise
 	type |= WT_FILLER;
 
 	for ( int w = 0; w < tokens.getNumTokens(); w++ ) {
-		for ( i = 0; i < ARRAY_LEN( fillerWords ); i++ ) {
-			if ( tokens[w].icompareTo( fillerWords[i] ) == 0 ) {
-				break;
-			}
-		}
+		const char *token = tokens.getTokenText( w );
 
 		// this word isn't a filler, remove filler flag
-		if ( i == ARRAY_LEN( fillerWords ) ) {
+		if ( !words->inList( WL_FILLER, token ) ) {
 			type &= ~WT_FILLER;
 		}
 
-		for ( i = 0; i < ARRAY_LEN( cancelWords ); i++ ) {
-			if ( tokens[w].icompareTo( cancelWords[i] ) == 0 ) {
-				type |= WT_CANCEL_QUEST;
-				break;
-			}
+		if ( words->inList( WL_CANCEL, token ) ) {
+			type |= WT_CANCEL_QUEST;
 		}
 
-		for ( i = 0; i < ARRAY_LEN( falseWords ); i++ ) {
-			if ( tokens[w].icompareTo( falseWords[i] ) == 0 ) {
-				type |= WT_FALSE;
-				break;
-			}
+		if ( words->inList( WL_FALSE, token ) ) {
+			type |= WT_FALSE;
 		}
 
-		for ( i = 0; i < ARRAY_LEN( trueWords ); i++ ) {
-			if ( tokens[w].icompareTo( trueWords[i] ) == 0 ) {
-				type |= WT_TRUE;
-				break;
-			}
+		if ( words->inList( WL_TRUE, token ) ) {
+			type |= WT_TRUE;
 		}
 	}
 
@@ -28,15 +28,21 @@ freely, subject to the following restrictions:
 #include <netdb.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/ioctl.h>
+#endif
+#ifdef __linux__
+#include <linux/sockios.h> // SIOCOUTQ
 #endif
 
-#include <stdio.h> // printf
+#include <stdio.h> // sprintf
 #include <errno.h> // errno
 
 #include <cstring>
 
 #include "irc_backend.h"
 
+using namespace AngelCommunication;
+
 #ifndef _WIN32
 #define closesocket(x) close(x)
 #endif
@@ -49,11 +55,12 @@ int IrcClient::sendall( int fd, const char *s, int len, int flags ) {
 		val = send( fd, s+len-left, left, flags );
 
 		if ( val < 0 ) {
-			printf( "WARNING: send errored: %s (errno %d)\n", strerror( errno ), errno );
+			Log::Printf( LOG_WARNING, "irc", "WARNING: send errored: %s (errno %d)", strerror( errno ), errno );
 			return -1;
 		}
 
 		left -= val;
+		this->stats.bytesSent += val;
 	}
 
 	// update time last packet was sent
@@ -63,7 +70,7 @@ int IrcClient::sendall( int fd, const char *s, int len, int flags ) {
 }
 
 IrcClient::IrcClient()
-: nick( NULL ), channel( NULL ), sock( 0 ), connected( false ), msgnum( 0 ), packetTime ( 0 )
+: state( IRC_DISCONNECTED ), connectTime( 0 ), nick( NULL ), sock( 0 ), msgnum( 0 ), packetTime ( 0 )
 {
 	data[0] = 0;
 }
@@ -75,49 +82,80 @@ IrcClient::~IrcClient()
 		free( nick );
 		nick = NULL;
 	}
-	if ( channel ) {
-		free( channel );
-		channel = NULL;
+}
+
+void IrcClient::SetNetwork( const char *name ) {
+	this->network = name;
+}
+
+// joins now if connected, and each time after connecting
+void IrcClient::AddChannel( const char *channel ) {
+	char msg[513];
+
+	for ( size_t i = 0; i < this->channels.size(); i++ ) {
+		if ( this->channels[i] == channel ) {
+			return;
+		}
+	}
+
+	this->channels.push_back( channel );
+
+	if ( state == IRC_READY ) {
+		snprintf( msg, sizeof ( msg ), "JOIN %s\r\n", channel );
+		sendall( sock, msg, strlen(msg), 0 );
 	}
 }
 
-bool IrcClient::Connect( const char *server, const char *port, const char *nick, const char *ident, const char *realName, const char *channel ) {
+// Starts connecting and returns right away, Update() finishes connecting.
+// Returns false if it failed to start.
+bool IrcClient::Connect( const char *server, const char *port, const char *nick, const char *ident, const char *realName ) {
 	int ret;
 	struct addrinfo hints, *res;
-	char buf[513]; // for USER message
 
-	if ( connected ) {
+	if ( state != IRC_DISCONNECTED ) {
 		Disconnect( "connecting elsewhere" );
 	}
 
+	if ( this->network.isEmpty() ) {
+		this->network = server;
+	}
+
 	memset( &hints, 0, sizeof ( hints ) );
 
 	hints.ai_family = AF_UNSPEC;
 	hints.ai_socktype = SOCK_STREAM;
 	hints.ai_protocol = IPPROTO_TCP;
 
+	// NOTE: looking up the server name still blocks
 	if ( ( ret = getaddrinfo( server, port, &hints, &res ) ) != 0 ) {
-		printf( "Connecting to %s:%s failed: getaddrinfo() returned %d", server, port, ret );
 #ifndef _WIN32
-		printf( ": %s", gai_strerror( ret ) );
+		Log::Printf( LOG_WARNING, "irc", "Connecting to %s:%s failed: getaddrinfo() returned %d: %s", server, port, ret, gai_strerror( ret ) );
+#else
+		Log::Printf( LOG_WARNING, "irc", "Connecting to %s:%s failed: getaddrinfo() returned %d", server, port, ret );
 #endif
-		printf( "\n" );
 		return false;
 	}
 
 	sock = socket( res->ai_family, res->ai_socktype, res->ai_protocol );
-	if ( ( ret = connect( sock, res->ai_addr, res->ai_addrlen ) ) != 0 ) {
-		printf( "Connecting to %s:%s failed: connect() returned %d", server, port, ret );
-#ifndef _WIN32
-		printf( ": %s", gai_strerror( ret ) );
-#endif
-		printf( "\n" );
+	if ( sock < 0 ) {
+		Log::Printf( LOG_WARNING, "irc", "Connecting to %s:%s failed: socket() errored: %s (errno %d)", server, port, strerror( errno ), errno );
+		freeaddrinfo( res );
+		sock = 0;
 		return false;
 	}
 
-	freeaddrinfo( res );
+#ifndef _WIN32
+	// select() can't watch it, connecting is retried after other sockets are closed
+	if ( sock >= FD_SETSIZE ) {
+		Log::Printf( LOG_WARNING, "irc", "Connecting to %s:%s failed: socket %d is past select()'s limit of %d", server, port, sock, FD_SETSIZE );
+		closesocket( sock );
+		freeaddrinfo( res );
+		sock = 0;
+		return false;
+	}
+#endif
 
-	// set socket as non-blocking
+	// set socket as non-blocking, so connect() doesn't wait
 	{
 #ifdef _WIN32
 		u_long val = 1;
@@ -128,26 +166,77 @@ bool IrcClient::Connect( const char *server, const char *port, const char *nick,
 #endif
 	}
 
-	if ( !realName ) {
-		realName = nick;
+	ret = connect( sock, res->ai_addr, res->ai_addrlen );
+	freeaddrinfo( res );
+
+	if ( ret != 0 && errno != EINPROGRESS
+#ifdef _WIN32
+		&& WSAGetLastError() != WSAEWOULDBLOCK
+#endif
+		) {
+		Log::Printf( LOG_WARNING, "irc", "Connecting to %s:%s failed: connect() errored: %s (errno %d)", server, port, strerror( errno ), errno );
+		closesocket( sock );
+		sock = 0;
+		return false;
+	}
+
+	// sent once connected
+	this->pendingNick = nick;
+	this->pendingIdent = ident ? ident : nick;
+	this->pendingRealName = realName ? realName : nick;
+
+	Log::Printf( LOG_INFO, "irc", "Connecting to %s (%s:%s)", this->network.c_str(), server, port );
+	this->state = IRC_CONNECTING;
+	this->connectTime = std::time( NULL );
+
+	return true;
+}
+
+// Check if connect() finished and register with the server.
+void IrcClient::FinishConnect() {
+	fd_set wfds;
+	struct timeval tv = { 0, 0 };
+	char buf[513]; // for USER message
+
+	if ( difftime( std::time( NULL ), this->connectTime ) >= CONNECT_TIMEOUT_SECONDS ) {
+		Disconnect( "Connection timed out" );
+		return;
 	}
-	if ( !ident ) {
-		ident = nick;
+
+	FD_ZERO( &wfds );
+	FD_SET( sock, &wfds );
+
+	if ( select( sock+1, NULL, &wfds, NULL, &tv ) <= 0 ) {
+		return; // still connecting
 	}
-	sprintf( buf, "USER %s 0 * :%s\r\n", ident, realName );
+
+	int error = 0;
+	socklen_t len = sizeof ( error );
+
+	if ( getsockopt( sock, SOL_SOCKET, SO_ERROR, (char *)&error, &len ) != 0 || error != 0 ) {
+		Log::Printf( LOG_WARNING, "irc", "Connecting to %s failed: %s", this->network.c_str(), strerror( error ) );
+		Disconnect( "Connection failed" );
+		return;
+	}
+
+	this->state = IRC_REGISTERING;
+
+	sprintf( buf, "USER %s 0 * :%s\r\n", this->pendingIdent.c_str(), this->pendingRealName.c_str() );
 	sendall( sock, buf, strlen( buf ), 0 );
 
-	RequestNick( nick );
+	// nick from the last connection, RequestNick skips it if it's the same
+	if ( this->nick ) {
+		free( this->nick );
+		this->nick = NULL;
+	}
 
-	// FIXME check for send failure?
+	RequestNick( this->pendingNick.c_str() );
 
-	this->nick = strdup( nick );
-	this->channel = strdup( channel );
+	// FIXME check for send failure?
 
-	printf( "Connected to %s:%s\n", server, port );
-	connected = true;
+	this->nick = strdup( this->pendingNick.c_str() );
 
-	return true;
+	Log::Printf( LOG_INFO, "irc", "Connected to %s", this->network.c_str() );
 }
 
 void IrcClient::Update() {
@@ -156,13 +245,24 @@ void IrcClient::Update() {
 	char msg[513];
 	char *buf, *eol, *p;
 
-	if ( !connected ) {
+	if ( state == IRC_CONNECTING ) {
+		FinishConnect();
+	}
+
+	if ( state == IRC_DISCONNECTED || state == IRC_CONNECTING ) {
+		return;
+	}
+
+	// server didn't say welcome
+	if ( state == IRC_REGISTERING && difftime( std::time( NULL ), this->connectTime ) >= CONNECT_TIMEOUT_SECONDS ) {
+		Disconnect( "Registration timed out" );
 		return;
 	}
 
 	while ( ( newlen = recv( sock, newbuf, sizeof (newbuf) - 1, 0 ) ) > 0 ) {
 		newbuf[newlen] = 0;
 		strcat( data, newbuf );
+		this->stats.bytesReceived += newlen;
 
 		eol = data;
 
@@ -181,14 +281,14 @@ void IrcClient::Update() {
 			eol = p;
 
 			// debug helper
-			//printf("%s: MESSAGE %d: %s\n", this->nick, msgnum, buf );
+			ANGEL_LOG_DEBUG( "irc", "%s: MESSAGE %d: %s", this->nick, msgnum, buf );
 			msgnum++;
 
 			if ( !strncmp( buf, "PING ", 5 ) ) {
 				// server sent PING request, change to PONG and send back
 				buf[1] = 'O';
 				sendall( sock, buf, strlen(buf), 0 );
-				//printf("%s: SENT: %s\n", this->nick, buf );
+				ANGEL_LOG_DEBUG( "irc", "%s: SENT: %s", this->nick, buf );
 			}
 			else if ( buf[0] == ':' ) {
 				char *user = NULL;
@@ -275,22 +375,26 @@ setMessage:
 				}
 
 				// debug helper
-				//printf( "user=[%s], command=[%s], where=[%s], ctcp=[%s], message=[%s]\n", user, command, where, ctcp, message );
+				ANGEL_LOG_DEBUG( "irc", "user=[%s], command=[%s], where=[%s], ctcp=[%s], message=[%s]", user, command, where, ctcp, message );
 
 				if ( !command ) {
-					printf("WARNING: IRC message with no command. user=%s, where=%s, ctcp=%s, message=%s\n", user, where, ctcp, message );
+					Log::Printf( LOG_WARNING, "irc", "WARNING: IRC message with no command. user=%s, where=%s, ctcp=%s, message=%s", user, where, ctcp, message );
 					continue;
 				}
 
 				if ( !strcmp( command, "001" ) ) {
-					sprintf( msg, "JOIN %s\r\n", this->channel );
-					sendall( sock, msg, strlen(msg), 0 );
+					state = IRC_READY;
+					this->stats.connects++;
+
+					for ( size_t i = 0; i < this->channels.size(); i++ ) {
+						snprintf( msg, sizeof ( msg ), "JOIN %s\r\n", this->channels[i].c_str() );
+						sendall( sock, msg, strlen(msg), 0 );
+					}
 				}
 				else if ( !strcmp( command, "433" ) && user ) {
-					// Try nick with an underscore after it
+					// Try nick with an underscore after it, only used on this connection
 					sprintf( msg, "%s_", user );
 
-					ANGEL_IRC_NickChange( this->nick, msg );
 					RequestNick( msg );
 					UpdateNick( msg );
 				}
@@ -300,17 +404,17 @@ setMessage:
 					time_t sentTime = atol( message );
 					time_t currentTime = time( NULL );
 					double diffSeconds = difftime( currentTime, sentTime );
-					printf("%s: ping response from %s (%.f seconds)\n", this->nick, where, diffSeconds );
+					Log::Printf( LOG_INFO, "irc", "%s: ping response from %s (%.f seconds)", this->nick, where, diffSeconds );
 #endif
 				}
 				else if ( !strcmp( command, "NICK" ) && user && message ) {
 					const char *oldname = user;
 					const char *newname = message;
 
-					if ( !strcmp( oldname, this->nick ) ) {
+					if ( this->nick && !strcmp( oldname, this->nick ) ) {
 						UpdateNick( newname );
 					}
-					ANGEL_IRC_NickChange( oldname, newname );
+					ANGEL_IRC_NickChange( this, oldname, newname );
 				}
 				else if ( !strcmp( command, "PRIVMSG" ) && user && where && message ) {
 					if ( ctcp ) {
@@ -325,7 +429,7 @@ setMessage:
 							}
 
 							sprintf( msg, "/me %s", message );
-							ANGEL_IRC_ReceiveMessage( nick, user, channelName, msg );
+							ANGEL_IRC_ReceiveMessage( this, nick, user, channelName, msg );
 						}
 						else if ( !strcmp( ctcp, "PING" ) ) {
 							sprintf( msg, "NOTICE %s :\001PING %s\001\r\n", user, message );
@@ -351,7 +455,7 @@ setMessage:
 							sprintf( msg, "NOTICE %s :\001ERRMSG %s : Query is unknown\001\r\n", user, ctcp );
 							sendall( sock, msg, strlen(msg), 0 );
 
-							printf("WARNING: Received unknown CTCP tag name (%s) from %s, acked ERRMSG back\n", ctcp, user);
+							Log::Printf( LOG_WARNING, "irc", "WARNING: Received unknown CTCP tag name (%s) from %s, acked ERRMSG back", ctcp, user );
 						}
 					} else {
 						char *channelName;
@@ -362,11 +466,11 @@ setMessage:
 							channelName = where;
 						}
 
-						ANGEL_IRC_ReceiveMessage( nick, user, channelName, message );
+						ANGEL_IRC_ReceiveMessage( this, nick, user, channelName, message );
 					}
 				}
 				else {
-					printf("WARNING: Unhandled IRC command (%s). user=%s, where=%s, ctcp=%s, message=%s\n", command, user, where, ctcp, message );
+					Log::Printf( LOG_WARNING, "irc", "WARNING: Unhandled IRC command (%s). user=%s, where=%s, ctcp=%s, message=%s", command, user, where, ctcp, message );
 				}
 			}
 		}
@@ -390,7 +494,7 @@ setMessage:
 		&& errno != EWOULDBLOCK
 #endif
 		) {
-		printf( "WARNING: recv errored: %s (errno %d)\n", strerror( errno ), errno );
+		Log::Printf( LOG_WARNING, "irc", "WARNING: recv errored: %s (errno %d)", strerror( errno ), errno );
 	}
 
 	// ping server to keep connection alive
@@ -405,20 +509,23 @@ setMessage:
 void IrcClient::Disconnect( const char *reason ) {
 	char buf[513];
 
-	if ( !connected ) {
+	if ( state == IRC_DISCONNECTED ) {
 		return;
 	}
 
-	sprintf( buf, "QUIT :%s\r\n", reason );
-	sendall( sock, buf, strlen( buf ), 0 );
+	if ( state != IRC_CONNECTING ) {
+		sprintf( buf, "QUIT :%s\r\n", reason );
+		sendall( sock, buf, strlen( buf ), 0 );
+	}
 
 	closesocket( sock );
 	sock = 0;
 
-	printf( "Disconnected (%s)\n", reason );
+	Log::Printf( LOG_INFO, "irc", "Disconnected from %s (%s)", this->network.c_str(), reason );
 
-	connected = false;
+	state = IRC_DISCONNECTED;
 	packetTime = 0;
+	this->stats.disconnects++;
 }
 
 void IrcClient::RequestNick( const char *nick ) {
@@ -430,13 +537,13 @@ void IrcClient::RequestNick( const char *nick ) {
 	sprintf( buf, "NICK %s\r\n", nick );
 	sendall( sock, buf, strlen( buf ), 0 );
 
-	printf("IRC_CLIENT: Requested nick \"%s\".\n", nick );
+	Log::Printf( LOG_INFO, "irc", "IRC_CLIENT: Requested nick \"%s\".", nick );
 }
 
 void IrcClient::UpdateNick( const char *nick ) {
 	char buf[513];
 
-	printf("IRC_CLIENT: Update nick, \"%s\" -> \"%s\"\n", this->nick, nick );
+	Log::Printf( LOG_INFO, "irc", "IRC_CLIENT: Update nick, \"%s\" -> \"%s\"", this->nick, nick );
 
 	if ( this->nick && !strcmp( this->nick, nick ) )
 		return;
@@ -448,11 +555,12 @@ void IrcClient::UpdateNick( const char *nick ) {
 	this->nick = strdup( nick );
 }
 
-void IrcClient::SayTo( const char *target, const char *message ) {
+bool IrcClient::SayTo( const char *target, const char *message ) {
 	char msg[513];
 
-	if ( !connected ) {
-		return;
+	// can't send messages until registered
+	if ( !Ready() ) {
+		return false;
 	}
 
 	if ( !strncmp( message, "/me", 3 ) && ( message[3] == ' ' || message[3] == '\0' ) ) {
@@ -461,7 +569,13 @@ void IrcClient::SayTo( const char *target, const char *message ) {
 	else {
 		sprintf( msg, "PRIVMSG %s :%s\r\n", target, message );
 	}
-	sendall( sock, msg, strlen(msg), 0 );
+
+	if ( sendall( sock, msg, strlen(msg), 0 ) != 0 ) {
+		return false;
+	}
+
+	this->stats.messagesSent++;
+	return true;
 }
 
 const char *IrcClient::GetNick() const
@@ -469,13 +583,46 @@ const char *IrcClient::GetNick() const
 	return nick;
 }
 
+const char *IrcClient::GetNetwork() const
+{
+	return network.c_str();
+}
+
 int IrcClient::GetSocket() const
 {
 	return sock;
 }
 
+IrcState IrcClient::GetState() const
+{
+	return state;
+}
+
+const IrcStats &IrcClient::GetStats() const
+{
+	return stats;
+}
+
+int IrcClient::GetSendQueueBytes() const
+{
+#ifdef SIOCOUTQ
+	int bytes;
+
+	if ( Connected() && ioctl( sock, SIOCOUTQ, &bytes ) == 0 ) {
+		return bytes;
+	}
+#endif
+	return Connected() ? -1 : 0;
+}
+
+// socket is connected, might not be registered with the server yet
 bool IrcClient::Connected() const
 {
-	return connected;
+	return ( state == IRC_REGISTERING || state == IRC_READY );
+}
+
+bool IrcClient::Ready() const
+{
+	return ( state == IRC_READY );
 }
 
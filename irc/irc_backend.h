@@ -24,25 +24,53 @@ freely, subject to the following restrictions:
 
 #include "../framework/angel.h"
 #include <ctime>
+#include <vector>
 
-void ANGEL_IRC_ReceiveMessage( const char *to, const char *from, const char *channel, const char *message );
-void ANGEL_IRC_NickChange( const char *oldnick, const char *newnick );
+class IrcClient;
+
+void ANGEL_IRC_ReceiveMessage( IrcClient *client, const char *to, const char *from, const char *channel, const char *message );
+void ANGEL_IRC_NickChange( IrcClient *client, const char *oldnick, const char *newnick );
 
 // Version reported to other IRC clients / shown in terminal at start up
 // FIXME?: version is suppose to be formatted as 'client:version:platform'?
 #define ANGEL_IRC_VERSION "Angel Communication IRC Client"
 
+enum IrcState {
+	IRC_DISCONNECTED,
+	IRC_CONNECTING,		// waiting for connect() to finish
+	IRC_REGISTERING,	// sent USER and NICK, waiting for welcome
+	IRC_READY			// joined channels
+};
+
+class IrcStats {
+	public:
+		unsigned int	connects;		// times registered with the server
+		unsigned int	disconnects;	// includes failed connections
+		uint64_t		bytesSent;
+		uint64_t		bytesReceived;
+		unsigned int	messagesSent;	// by SayTo
+
+		IrcStats() : connects( 0 ), disconnects( 0 ), bytesSent( 0 ), bytesReceived( 0 ), messagesSent( 0 )
+		{
+		}
+};
+
 class IrcClient {
 	private:
-		bool connected;
+		IrcState state;
+		time_t connectTime; // connecting and registering time out after CONNECT_TIMEOUT_SECONDS
+		AngelCommunication::String pendingNick, pendingIdent, pendingRealName; // sent after connecting
 		char *nick;
-		char *channel;
+		AngelCommunication::String network; // name used in messages, the server if not set
+		std::vector<AngelCommunication::String> channels; // joined after connecting
 		int sock; // socket handle
 		int msgnum;
 		char data[1025]; // hold up to 2 512 character IRC messages
 		time_t packetTime;
+		IrcStats stats;
 
 		void UpdateNick( const char *nick );
+		void FinishConnect();
 
 		int sendall( int fd, const char *s, int len, int flags );
 
@@ -50,19 +78,27 @@ class IrcClient {
 		// after not sending a packet to server for 30 seconds,
 		// send a ping to keep the connection alive.
 		static const int IDLE_PING_SECONDS = 30;
+		static const int CONNECT_TIMEOUT_SECONDS = 60;
 
 		IrcClient();
 		~IrcClient();
-		bool Connect( const char *server, const char *port, const char *nick, const char *ident, const char *realName, const char *channel );
+		bool Connect( const char *server, const char *port, const char *nick, const char *ident, const char *realName );
+		void SetNetwork( const char *name );
+		void AddChannel( const char *channel );
 		void Update();
 		void Disconnect( const char *reason );
 
 		void RequestNick( const char *nick );
-		void SayTo( const char *target, const char *message );
+		bool SayTo( const char *target, const char *message ); // false if not sent
 
 		const char *GetNick() const;
+		const char *GetNetwork() const;
 		int GetSocket() const;
+		IrcState GetState() const;
+		const IrcStats &GetStats() const;
+		int GetSendQueueBytes() const; // sent but not acknowledged by the server, -1 if unknown
 		bool Connected() const;
+		bool Ready() const;
 };
 
 #endif // ANGEL_IRC_BACKEND_INCLUDED
@@ -0,0 +1,133 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "irc_connect.h"
+
+using namespace AngelCommunication;
+
+ConnectScheduler::ConnectScheduler()
+: serverDelay( 20 ), backoffMin( 5 ), backoffMax( 300 )
+{
+}
+
+void ConnectScheduler::setSeed( uint64_t seed ) {
+	// own stream so it doesn't match any bot's replies
+	random.seed( seed, 0x6972 );
+}
+
+int ConnectScheduler::add( const char *server, const char *port ) {
+	Entry entry;
+	String name;
+
+	name.setValues( server, ":", port );
+
+	entry.server = -1;
+	entry.waiting = true;
+	entry.failures = 0;
+	entry.nextAttempt = 0;
+
+	for ( size_t i = 0; i < servers.size(); i++ ) {
+		if ( servers[i].name == name ) {
+			entry.server = i;
+			break;
+		}
+	}
+
+	if ( entry.server == -1 ) {
+		Server newServer;
+
+		newServer.name = name;
+		newServer.nextConnect = 0;
+
+		entry.server = servers.size();
+		servers.push_back( newServer );
+	}
+
+	entries.push_back( entry );
+	return entries.size() - 1;
+}
+
+bool ConnectScheduler::startConnect( int id, double now ) {
+	Entry &entry = entries[id];
+	Server &server = servers[entry.server];
+
+	if ( !entry.waiting || now < entry.nextAttempt || now < server.nextConnect ) {
+		return false;
+	}
+
+	entry.waiting = false;
+	server.nextConnect = now + serverDelay;
+	return true;
+}
+
+void ConnectScheduler::connectFailed( int id, double now ) {
+	Entry &entry = entries[id];
+
+	// backoffMin, 2 * backoffMin, 4 * backoffMin... up to backoffMax
+	double backoff = backoffMin;
+	for ( int i = 0; i < entry.failures && backoff < backoffMax; i++ ) {
+		backoff *= 2;
+	}
+	if ( backoff > backoffMax ) {
+		backoff = backoffMax;
+	}
+
+	// wait between half and all of the backoff
+	double jitter = backoff * 0.5 * random.range( 1001 ) / 1000.0;
+
+	entry.failures++;
+	entry.waiting = true;
+	entry.nextAttempt = now + backoff * 0.5 + jitter;
+}
+
+void ConnectScheduler::connectSucceeded( int id ) {
+	entries[id].failures = 0;
+}
+
+float ConnectScheduler::getSleepTime( double now ) const {
+	float delay = -1;
+
+	for ( size_t i = 0; i < entries.size(); i++ ) {
+		const Entry &entry = entries[i];
+
+		if ( !entry.waiting ) {
+			continue;
+		}
+
+		double start = entry.nextAttempt;
+		if ( servers[entry.server].nextConnect > start ) {
+			start = servers[entry.server].nextConnect;
+		}
+
+		float wait = ( start > now ) ? (float)( start - now ) : 0;
+
+		if ( delay < 0 || wait < delay ) {
+			delay = wait;
+		}
+	}
+
+	return delay;
+}
+
+int ConnectScheduler::getFailures( int id ) const {
+	return entries[id].failures;
+}
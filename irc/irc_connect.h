@@ -0,0 +1,79 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ANGEL_IRC_CONNECT_INCLUDED
+#define ANGEL_IRC_CONNECT_INCLUDED
+
+#include <vector>
+
+#include "../framework/angel.h"
+
+/*
+	ConnectScheduler class
+	Decides when each IRC connection may connect. Connections to different
+	servers start in parallel, but connections to the same server are at
+	least serverDelay seconds apart as servers limit how fast one host can
+	connect. Failed connections wait an exponential backoff with jitter
+	before retrying, so a lot of bots don't all retry at the same time.
+	Times are Persona::ClockSeconds().
+*/
+class ConnectScheduler {
+	private:
+		class Server {
+			public:
+				AngelCommunication::String	name;	// host:port
+				double		nextConnect;
+		};
+
+		class Entry {
+			public:
+				int			server;
+				bool		waiting;	// not connected or connecting
+				int			failures;	// since last successful connection
+				double		nextAttempt;
+		};
+
+		std::vector<Server> servers;
+		std::vector<Entry> entries;
+		AngelCommunication::Random random;
+
+	public:
+		float	serverDelay;	// seconds between connecting to the same server
+		float	backoffMin;		// seconds to wait after the first failure, doubled for each failure after
+		float	backoffMax;
+
+		ConnectScheduler();
+
+		void setSeed( uint64_t seed );
+		int add( const char *server, const char *port ); // returns id
+
+		// returns true if id should connect now, the server's delay starts
+		bool startConnect( int id, double now );
+		void connectFailed( int id, double now ); // also used for lost connections
+		void connectSucceeded( int id );
+
+		// seconds until a waiting connection can start, -1 if none are waiting
+		float getSleepTime( double now ) const;
+		int getFailures( int id ) const;
+};
+
+#endif // ANGEL_IRC_CONNECT_INCLUDED
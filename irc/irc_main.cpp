@@ -24,6 +24,7 @@ freely, subject to the following restrictions:
 #include <stdio.h>
 #include <signal.h>
 #include <string.h>
+#include <stdlib.h>
 #ifdef _WIN32
 #include <winsock2.h>
 #else
@@ -31,166 +32,438 @@ freely, subject to the following restrictions:
 #endif
 
 #include "irc_backend.h"
+#include "irc_connect.h"
+#include "irc_metrics.h"
 
 #include "../framework/angel.h"
 
 using namespace AngelCommunication;
 
-// FIXME: these should be in a config file
+// defaults when not set by a config file (see --config)
+#define IRC_NETWORK	"wizard"
 #define IRC_SERVER	"wizard.local"
 #define IRC_PORT	"6667"
 #define IRC_CHANNEL	"#sandbox"
 #define IRC_IDENT	"angelcom" // user identifier, part of host name shown to other users
-#define IRC_CONNECT_DELAY 20 // wait 20 seconds between connecting each bot
+#define IRC_CONNECT_DELAY 20 // wait 20 seconds between connecting bots to the same server
+#define IRC_BACKOFF_MIN 5 // wait 5 seconds after the first failed connection, doubled after each failure
+#define IRC_BACKOFF_MAX 300
+#define THINK_SECONDS 0.05 // time bots can spend on messages before reading the sockets again, so PINGs are answered
+#define MAX_CONS 32
+#define MAX_USERS 32 // people with their own persona in a conversation, after that the one who spoke longest ago is renamed
 
 
-Persona user; // repersents all irc users... should probably have a persona for each?
+std::vector<Persona*> bots;
+std::vector<String> botNames; // initial nicks, used for PersonaStore and [bot name] in the config
 
-#define MAX_BOTS 2
-IrcClient bot_irc[MAX_BOTS];
-Persona bots[MAX_BOTS];
-int numBots = 0;
+PersonaStore store;
+ThinkScheduler scheduler;
+ReplayLog inputLog; // messages, nick changes, and think turns, for --replay
+bool replaying = false;
+std::vector<String> replayRenames; // rename events for the next think event, see ANGELC_PersonaRename
 
-#define MAX_CONS 8
+// [irc] settings, these are updated when the config file is reloaded
+class IrcSettings {
+	public:
+		String		ident;
+		float		connectDelay;
+		float		backoffMin;
+		float		backoffMax;
+		float		thinkSeconds;
+		int			maxConversations;
+		int			metricsPort;	// 0 is off
+		int			logLevel;
+		int			logFormat;
+
+		IrcSettings() : ident( IRC_IDENT ), connectDelay( IRC_CONNECT_DELAY ), backoffMin( IRC_BACKOFF_MIN ), backoffMax( IRC_BACKOFF_MAX ), thinkSeconds( THINK_SECONDS ), maxConversations( MAX_CONS ), metricsPort( 0 ),
+			logLevel( LOG_INFO ), logFormat( LOG_TEXT )
+		{
+		}
+};
+
+IrcSettings settings;
+
+// [bot name] settings, only weight and the inbox are updated when reloading
+class BotSettings {
+	public:
+		String		name;
+		String		fullName;
+		int			gender;
+		int			weight;
+		int			inboxSize;
+		int			inboxPolicy;
+
+		BotSettings() : gender( GENDER_NONE ), weight( 1 ), inboxSize( Persona::DEFAULT_INBOX_SIZE ), inboxPolicy( INBOX_PRIORITY_ADDRESSED )
+		{
+		}
+};
+
+class IrcNetwork {
+	public:
+		String		name;
+		String		server;
+		String		port;
+		std::vector<String> channels;
+};
+
+std::vector<IrcNetwork> networks;
+size_t numConfigNetworks = 0; // networks from the config file, the first ones in networks
+
+// each bot has its own connection to each network
+class IrcConnection {
+	public:
+		IrcClient	irc;
+		int			bot;
+		int			network;
+		int			connectId;	// in connector
+		IrcState	lastState;
+		String		requestedNick;	// rename the bot asked for, not confirmed by the server yet
+};
+
+std::vector<IrcConnection*> connections;
+ConnectScheduler connector;
+MetricsServer metricsServer;
+
+// someone on IRC talking in a conversation
+class IrcUser {
+	public:
+		Persona		*persona;
+		unsigned int lastSpoke;	// ConList::numLines when they last said something
+};
+
+// conversations are in a channel or with a person on a network
 class ConList {
 	public:
+		int			network;
+		int			bot;	// direct conversations are with one bot, -1 for channels
 		String		name;
 		Conversation con;
+		unsigned int messagesSent;	// bot messages sent to the network
+		unsigned int numLines;	// said by users
+		std::vector<IrcUser> users;
 };
 
-ConList conlist[MAX_CONS];
+std::vector<ConList*> conlist;
+
+IrcConnection *findConnection( const IrcClient *client ) {
+	for ( size_t i = 0; i < connections.size(); i++ ) {
+		if ( &connections[i]->irc == client ) {
+			return connections[i];
+		}
+	}
 
-int numCons = 0;
+	return NULL;
+}
 
-// if from starts with "#" it's from a channel
-void ANGEL_IRC_ReceiveMessage( const char *to, const char *from, const char *channel, const char *message )
+IrcConnection *findConnection( int bot, int network ) {
+	for ( size_t i = 0; i < connections.size(); i++ ) {
+		if ( connections[i]->bot == bot && connections[i]->network == network ) {
+			return connections[i];
+		}
+	}
+
+	return NULL;
+}
+
+ConList *findConversation( int network, int bot, const char *name ) {
+	for ( size_t i = 0; i < conlist.size(); i++ ) {
+		if ( conlist[i]->network == network && conlist[i]->bot == bot && conlist[i]->name == name ) {
+			return conlist[i];
+		}
+	}
+
+	return NULL;
+}
+
+ConList *addConversation( int network, int bot, const char *name ) {
+	if ( (int)conlist.size() >= settings.maxConversations ) {
+		return NULL;
+	}
+
+	ConList *cl = new ConList;
+
+	cl->network = network;
+	cl->bot = bot;
+	cl->name = name;
+	cl->messagesSent = 0;
+	cl->numLines = 0;
+
+	// network name is included so PersonaStore can tell them apart
+	String conName;
+	conName.setValues( networks[network].name, "/", name );
+	cl->con.setName( conName );
+
+	conlist.push_back( cl );
+	return cl;
+}
+
+// Persona for nick in the conversation, added the first time they say something.
+// Each person has their own persona so one that's talking doesn't rename everyone else.
+Persona *findUser( ConList *cl, const char *nick ) {
+	IrcUser *oldest = NULL;
+
+	cl->numLines++;
+
+	for ( size_t i = 0; i < cl->users.size(); i++ ) {
+		IrcUser &u = cl->users[i];
+
+		if ( u.persona->getNick() == nick ) {
+			u.lastSpoke = cl->numLines;
+			return u.persona;
+		}
+
+		if ( !oldest || u.lastSpoke < oldest->lastSpoke ) {
+			oldest = &u;
+		}
+	}
+
+	// personas can't be removed while bots have messages from them, reuse the quietest one
+	if ( oldest && cl->users.size() >= MAX_USERS ) {
+		oldest->persona->updateNick( nick );
+		oldest->lastSpoke = cl->numLines;
+		return oldest->persona;
+	}
+
+	IrcUser u;
+
+	u.persona = new Persona;
+	u.persona->updateNick( nick );
+	u.persona->setGender( GENDER_MALE );
+	u.persona->setAutoChat( false );
+	u.lastSpoke = cl->numLines;
+	cl->users.push_back( u );
+
+	// bots don't say hello to everyone that talks in a channel
+	cl->con.addPersona( u.persona, false );
+
+	return u.persona;
+}
+
+// Add a message from someone on the network, channel is NULL for a direct
+// message to bot. Returns false if there isn't a free conversation slot.
+bool addUserMessage( int network, int bot, const char *channel, const char *from, const char *to, const char *message )
 {
-	int i;
-	Persona *speaker = NULL;
 	const char *conversationName = channel ? channel : from;
+	const char *networkName = networks[network].name.c_str();
+	ConList *cl = findConversation( network, channel ? -1 : bot, conversationName );
 
-	for ( i = 0; i < numBots; i++ ) {
-		if ( bots[i].getNick() == from ) {
-			speaker = &bots[i];
-			break;
-		}
+	if ( cl ) {
+		Log::Printf( LOG_INFO, "chat", "%s/%s <%s> %s", networkName, conversationName, from, message );
+		cl->con.addMessage( findUser( cl, from ), message );
+		return true;
 	}
 
-	// Don't re-add bot messages (this would cause them to be sent to server again)
-	if ( speaker ) {
-		return;
+	// Create new direct conversation
+	cl = addConversation( network, channel ? -1 : bot, conversationName );
+
+	if ( !cl ) {
+		Log::Printf( LOG_WARNING, "irc", "WARNING: All IRC conversation slots full (%s wants to chat with %s on %s).", from, to, networkName );
+		return false;
 	}
 
-	// HACK: should have a persona for everyone?...
-	user.updateNick( from );
-	speaker = &user;
+	Log::Printf( LOG_INFO, "irc", "Started new IRC conversation on %s (%s wants to chat with %s).", networkName, from, to );
+	Persona *speaker = findUser( cl, from );
+	cl->con.addPersona( bots[bot] );
+	Log::Printf( LOG_INFO, "chat", "%s/%s <%s> %s", networkName, conversationName, from, message );
+	cl->con.addMessage( speaker, message );
+	return true;
+}
 
-	if ( channel ) {
-		// HACK: if there are multiple bots in the same channel and using same conversation,
-		// the messages will be duplicated (so only add for first bot...)
-		if ( bots[0].getNick().icompareTo( to ) != 0 )
-			return;
+// if from starts with "#" it's from a channel
+void ANGEL_IRC_ReceiveMessage( IrcClient *client, const char *to, const char *from, const char *channel, const char *message )
+{
+	IrcConnection *connection = findConnection( client );
+	const char *conversationName = channel ? channel : from;
+
+	if ( !connection ) {
+		return;
 	}
 
-	for ( i = 0; i < numCons; i++ ) {
-		if ( conlist[i].name == conversationName ) {
-			printf( "%s <%s> %s\n", conversationName, from, message );
-			conlist[i].con.addMessage( speaker, message );
+	int network = connection->network;
+	const char *networkName = networks[network].name.c_str();
+
+	// Don't re-add bot messages (this would cause them to be sent to server again)
+	for ( size_t i = 0; i < connections.size(); i++ ) {
+		const char *nick = connections[i]->irc.GetNick();
+
+		if ( connections[i]->network == network && nick && !strcmp( nick, from ) ) {
 			return;
 		}
 	}
 
-	// Create new direct conversation
-	if ( i < MAX_CONS ) {
-		printf( "Started new IRC conversation (%s wants to chat with %s).\n", from, to );
-		conlist[i].name = conversationName;
-		conlist[i].con.addPersona( speaker );
-		for ( int b = 0; b < numBots; b++ ) {
-			if ( bots[b].getNick() == to ) {
-				conlist[i].con.addPersona( &bots[b] );
+	if ( channel ) {
+		// all bots on a network are in the same channel conversations,
+		// only add messages from the first connected bot so they aren't duplicated
+		for ( size_t i = 0; i < connections.size(); i++ ) {
+			if ( connections[i]->network == network && connections[i]->irc.Ready() ) {
+				if ( connections[i] != connection )
+					return;
 				break;
 			}
 		}
-		printf( "%s <%s> %s\n", conversationName, from, message );
-		conlist[i].con.addMessage( speaker, message );
-		numCons++;
-	} else {
+	}
+
+	String event;
+
+	event.setValues( "say ", networkName, ' ', botNames[connection->bot], ' ', channel ? channel : "-", ' ', from, ' ', message );
+	inputLog.write( event );
+
+	if ( !addUserMessage( network, connection->bot, channel, from, to, message ) ) {
 		// TODO: Try to free a unused direct conversation
-		for ( int b = 0; b < numBots; b++ ) {
-			if ( bots[b].getNick() == to ) {
-				bot_irc[b].SayTo( conversationName, "Sorry, no available conversation slot." );
-				printf( "WARNING: All IRC conversation slots full (%s wants to chat with %s).\n", from, to );
-				break;
-			}
-		}
+		client->SayTo( conversationName, "Sorry, no available conversation slot." );
 	}
 }
 
 void ANGELC_PrintMessage( const AngelCommunication::Conversation *con, const AngelCommunication::Persona *speaker, const char *message )
 {
-	IrcClient *irc = NULL;
+	int bot = -1;
 
-	for ( int b = 0; b < numBots; b++ ) {
-		if ( &bots[b] == speaker ) {
-			irc = &bot_irc[b];
+	for ( int b = 0; b < (int)bots.size(); b++ ) {
+		if ( bots[b] == speaker ) {
+			bot = b;
 			break;
 		}
 	}
 
 	// ignore users
-	if ( !irc )
+	if ( bot == -1 )
 		return;
 
-	for ( int i = 0; i < numCons; i++ ) {
-		if ( &conlist[i].con == con ) {
-			irc->SayTo( conlist[i].name.c_str(), message );
-			printf( "%s <%s> %s\n", conlist[i].name.c_str(), irc->GetNick(), message );
+	for ( size_t i = 0; i < conlist.size(); i++ ) {
+		if ( &conlist[i]->con == con ) {
+			IrcConnection *connection = findConnection( bot, conlist[i]->network );
+
+			if ( connection ) {
+				// the connection doesn't have a nick until it first registers
+				const char *nick = connection->irc.GetNick() ? connection->irc.GetNick() : speaker->getNick().c_str();
+
+				if ( connection->irc.SayTo( conlist[i]->name.c_str(), message ) ) {
+					conlist[i]->messagesSent++;
+				}
+				Log::Printf( LOG_INFO, "chat", "%s/%s <%s> %s", networks[conlist[i]->network].name.c_str(), conlist[i]->name.c_str(), nick, message );
+			}
 			break;
 		}
 	}
 }
 
 // this is called when persona wants to change name
+// the persona is renamed when a server accepts the new nick, see ANGEL_IRC_NickChange
 void ANGELC_PersonaRename( const char *oldnick, const char *newnick ) {
-	for ( int b = 0; b < numBots; b++ ) {
-		if ( bots[b].getNick() == oldnick ) {
-			bot_irc[b].RequestNick( newnick );
-			return;
-		}
-	}
+	for ( int b = 0; b < (int)bots.size(); b++ ) {
+		if ( bots[b]->getNick() == oldnick ) {
+			bool requested = false;
+			String event;
 
-	printf( "ANGELC_PersonaRename: Unhandled local rename. %s -> %s\n", oldnick, newnick );
-}
+			if ( replaying ) {
+				// there's a botnick event later if the server allowed it
+				event.setValues( botNames[b], ' ', newnick, " now" );
+				requested = ( replayRenames.empty() || replayRenames.front().compareTo( event ) );
 
-// IRC server says someone renamed
-// TODO: Update Conversation lastAddressees
-// TODO: Support multiple IRC networks
-void ANGEL_IRC_NickChange( const char *oldnick, const char *newnick ) {
-	printf( "* %s renamed to %s\n", oldnick, newnick );
+				if ( !replayRenames.empty() ) {
+					replayRenames.erase( replayRenames.begin() );
+				} else {
+					Log::Printf( LOG_WARNING, "irc", "WARNING: %s renamed to %s but it isn't in the replay log.", oldnick, newnick );
+				}
+			} else {
+				for ( size_t i = 0; i < connections.size(); i++ ) {
+					if ( connections[i]->bot == b && connections[i]->irc.Connected() ) {
+						connections[i]->requestedNick = newnick;
+						connections[i]->irc.RequestNick( newnick );
+						requested = true;
+					}
+				}
+			}
 
-	for ( int b = 0; b < numBots; b++ ) {
-		if ( bots[b].getNick() == oldnick ) {
-			bots[b].updateNick( newnick );
+			// not connected anywhere, connect using the new nick
+			if ( !requested ) {
+				bots[b]->updateNick( newnick );
+			}
+
+			event.setValues( "rename ", botNames[b], ' ', newnick, requested ? " server" : " now" );
+			inputLog.write( event );
 			return;
 		}
 	}
 
+	Log::Printf( LOG_INFO, "irc", "ANGELC_PersonaRename: Unhandled local rename. %s -> %s", oldnick, newnick );
+}
+
+// someone else on the network renamed
+void renameUser( int network, const char *oldnick, const char *newnick ) {
 	// Update direct conversation, so person can continue conversation instead of starting a new one.
 	// WISH: Might be better to have multiple names attached to conversations? Rename, quit, then rejoin with original name will cause a new conversation to be created if they direct chat again.
 	// WISH: Could want to attach old name if new name is attached. so if user pings out and reconnects while their ghost is still present (using a fallback name)
 	// WISH:   then rename to original name, we can 'learn' their alternate name(s). Actually, that might be useful as a general thing not just direct conversations.
 	// WISH:   Though, what to do if started conversation with alt-name then rename to name that already has a conversation? Dump the non-alt I guess or merge them (after there is stuff to merge).
-	for ( int i = 0; i < numCons; i++ ) {
-		if ( conlist[i].name == oldnick ) {
-			conlist[i].name = newnick;
-			break;
+	for ( size_t i = 0; i < conlist.size(); i++ ) {
+		ConList *cl = conlist[i];
+
+		if ( cl->network != network ) {
+			continue;
+		}
+
+		if ( cl->bot != -1 && cl->name == oldnick ) {
+			String conName;
+
+			cl->name = newnick;
+			conName.setValues( networks[network].name, "/", newnick );
+			cl->con.setName( conName );
+		}
+
+		for ( size_t u = 0; u < cl->users.size(); u++ ) {
+			if ( cl->users[u].persona->getNick() == oldnick ) {
+				cl->users[u].persona->updateNick( newnick );
+				break;
+			}
 		}
 	}
 }
 
+// IRC server says someone renamed
+// TODO: Update Conversation lastAddressees
+void ANGEL_IRC_NickChange( IrcClient *client, const char *oldnick, const char *newnick ) {
+	IrcConnection *connection = findConnection( client );
+
+	if ( !connection ) {
+		return;
+	}
+
+	int network = connection->network;
+
+	Log::Printf( LOG_INFO, "chat", "* %s renamed to %s on %s", oldnick, newnick, networks[network].name.c_str() );
+
+	// the bot's nick on this connection, IrcClient has already updated it.
+	// a bot has one persona for every network, so it's only renamed when it asked
+	// for the nick. nicks picked by the server or the 433 fallback only apply to
+	// this connection and aren't saved.
+	if ( client->GetNick() && !strcmp( client->GetNick(), newnick ) ) {
+		Persona *bot = bots[connection->bot];
+
+		if ( !connection->requestedNick.compareTo( newnick ) ) {
+			connection->requestedNick = "";
+
+			if ( bot->getNick().compareTo( newnick ) ) {
+				String event;
+
+				event.setValues( "botnick ", botNames[connection->bot], ' ', newnick );
+				inputLog.write( event );
+				bot->updateNick( newnick );
+			}
+		}
+		return;
+	}
+
+	String event;
+
+	event.setValues( "nick ", networks[network].name, ' ', oldnick, ' ', newnick );
+	inputLog.write( event );
+	renameUser( network, oldnick, newnick );
+}
+
 // wait until a set time passes or there is new socket data
 void ircIdle( float waitInSeconds ) {
-	fd_set rfds;
+	fd_set rfds, wfds;
 	struct timeval tv, *ptv;
 	int retval;
 	int highestSock = 0;
@@ -199,10 +472,19 @@ void ircIdle( float waitInSeconds ) {
 
 	/* Watch sockets to see when it has input. */
 	FD_ZERO( &rfds );
-	for ( int i = 0; i < numBots; i++ ) {
-		// FIXME: check if connected!
-		int sock = bot_irc[i].GetSocket();
-		FD_SET( sock, &rfds );
+	FD_ZERO( &wfds );
+	metricsServer.AddSockets( &rfds, &wfds, highestSock );
+
+	for ( size_t i = 0; i < connections.size(); i++ ) {
+		IrcState state = connections[i]->irc.GetState();
+
+		if ( state == IRC_DISCONNECTED ) {
+			continue;
+		}
+
+		// writable once connect() finishes. IrcClient::Connect() only uses sockets below FD_SETSIZE.
+		int sock = connections[i]->irc.GetSocket();
+		FD_SET( sock, state == IRC_CONNECTING ? &wfds : &rfds );
 		if ( sock+1 > highestSock ) {
 			highestSock = sock+1;
 		}
@@ -221,86 +503,756 @@ void ircIdle( float waitInSeconds ) {
 		ptv = NULL;
 	}
 
-	retval = select(highestSock, &rfds, NULL, NULL, ptv);
+	retval = select(highestSock, &rfds, &wfds, NULL, ptv);
 
 	// FIXME?: select failed
 	//if (retval == -1)
 	//	return;
 }
 
-void sighandler( int signum ) {
-	for ( int i = 0; i < numBots; i++ ) {
-		bot_irc[i].Disconnect( "Bye" );
+// labels for a bot's connection to a network
+static String connectionLabels( const IrcConnection *connection ) {
+	String labels;
+
+	MetricsWriter::addLabel( labels, "network", networks[connection->network].name );
+	MetricsWriter::addLabel( labels, "bot", botNames[connection->bot] );
+
+	return labels;
+}
+
+void ANGEL_IRC_WriteMetrics( MetricsWriter &metrics ) {
+	std::vector<String> conLabels, botLabels;
+
+	for ( size_t i = 0; i < conlist.size(); i++ ) {
+		String labels;
+
+		MetricsWriter::addLabel( labels, "network", networks[conlist[i]->network].name );
+		MetricsWriter::addLabel( labels, "conversation", conlist[i]->con.getName() );
+		if ( conlist[i]->bot != -1 ) {
+			MetricsWriter::addLabel( labels, "bot", botNames[conlist[i]->bot] );
+		}
+		conLabels.push_back( labels );
+	}
+
+	for ( size_t i = 0; i < bots.size(); i++ ) {
+		String labels;
+
+		MetricsWriter::addLabel( labels, "bot", botNames[i] );
+		botLabels.push_back( labels );
+	}
+
+	// conversations
+	metrics.type( "angel_conversations", "gauge", "Open conversations." );
+	metrics.value( "angel_conversations", String(), (uint64_t)conlist.size() );
+
+	metrics.type( "angel_conversation_messages_in_total", "counter", "Messages said by IRC users." );
+	for ( size_t i = 0; i < conlist.size(); i++ ) {
+		metrics.value( "angel_conversation_messages_in_total", conLabels[i], (uint64_t)conlist[i]->con.getStats().messagesIn );
 	}
 
+	metrics.type( "angel_conversation_messages_out_total", "counter", "Messages bots sent to the network." );
+	for ( size_t i = 0; i < conlist.size(); i++ ) {
+		metrics.value( "angel_conversation_messages_out_total", conLabels[i], (uint64_t)conlist[i]->messagesSent );
+	}
+
+	// bots
+	metrics.type( "angel_bot_inbox_messages", "gauge", "Messages waiting to be processed." );
+	for ( size_t i = 0; i < bots.size(); i++ ) {
+		metrics.value( "angel_bot_inbox_messages", botLabels[i], (uint64_t)bots[i]->getInboxCount() );
+	}
+
+	metrics.type( "angel_bot_inbox_received_total", "counter", "Messages given to the bot." );
+	for ( size_t i = 0; i < bots.size(); i++ ) {
+		metrics.value( "angel_bot_inbox_received_total", botLabels[i], (uint64_t)bots[i]->getInboxStats().received );
+	}
+
+	metrics.type( "angel_bot_inbox_dropped_total", "counter", "Messages dropped because the inbox was full." );
+	for ( size_t i = 0; i < bots.size(); i++ ) {
+		metrics.value( "angel_bot_inbox_dropped_total", botLabels[i], (uint64_t)bots[i]->getInboxStats().dropped );
+	}
+
+	metrics.type( "angel_bot_inbox_coalesced_total", "counter", "Messages replaced by a newer message from the same person." );
+	for ( size_t i = 0; i < bots.size(); i++ ) {
+		metrics.value( "angel_bot_inbox_coalesced_total", botLabels[i], (uint64_t)bots[i]->getInboxStats().coalesced );
+	}
+
+	metrics.type( "angel_bot_expectations", "gauge", "Replies the bot is waiting for." );
+	for ( size_t i = 0; i < bots.size(); i++ ) {
+		metrics.value( "angel_bot_expectations", botLabels[i], (uint64_t)bots[i]->getNumExpectations() );
+	}
+
+	metrics.type( "angel_bot_processed_total", "counter", "Messages processed." );
+	for ( size_t i = 0; i < bots.size(); i++ ) {
+		metrics.value( "angel_bot_processed_total", botLabels[i], (uint64_t)bots[i]->getThinkStats().processed );
+	}
+
+	metrics.type( "angel_bot_deferred_total", "counter", "Times the bot ran out of time with messages waiting." );
+	for ( size_t i = 0; i < bots.size(); i++ ) {
+		metrics.value( "angel_bot_deferred_total", botLabels[i], (uint64_t)bots[i]->getThinkStats().deferred );
+	}
+
+	metrics.type( "angel_bot_latency_seconds", "histogram", "Time from a message being said until it's processed, including the reply delay." );
+	for ( size_t i = 0; i < bots.size(); i++ ) {
+		metrics.histogram( "angel_bot_latency_seconds", botLabels[i], bots[i]->getThinkStats().latency );
+	}
+
+	// parsing
+	const ParseCacheStats &parseStats = ParseCache::GetStats();
+
+	metrics.type( "angel_parse_seconds", "histogram", "Time to parse lines that weren't in the parse cache." );
+	metrics.histogram( "angel_parse_seconds", String(), parseStats.parseTime );
+
+	metrics.type( "angel_parse_cache_hits_total", "counter", "Lines found in the parse cache." );
+	metrics.value( "angel_parse_cache_hits_total", String(), (uint64_t)parseStats.hits );
+
+	metrics.type( "angel_parse_cache_misses_total", "counter", "Lines parsed and added to the parse cache." );
+	metrics.value( "angel_parse_cache_misses_total", String(), (uint64_t)parseStats.misses );
+
+	metrics.type( "angel_parse_cache_evictions_total", "counter", "Lines dropped from the parse cache to make room." );
+	metrics.value( "angel_parse_cache_evictions_total", String(), (uint64_t)parseStats.evictions );
+
+	// connections
+	metrics.type( "angel_irc_ready", "gauge", "1 if the bot is registered with the network." );
+	for ( size_t i = 0; i < connections.size(); i++ ) {
+		metrics.value( "angel_irc_ready", connectionLabels( connections[i] ), (uint64_t)connections[i]->irc.Ready() );
+	}
+
+	metrics.type( "angel_irc_connects_total", "counter", "Times registered with the network." );
+	for ( size_t i = 0; i < connections.size(); i++ ) {
+		metrics.value( "angel_irc_connects_total", connectionLabels( connections[i] ), (uint64_t)connections[i]->irc.GetStats().connects );
+	}
+
+	metrics.type( "angel_irc_disconnects_total", "counter", "Lost and failed connections." );
+	for ( size_t i = 0; i < connections.size(); i++ ) {
+		metrics.value( "angel_irc_disconnects_total", connectionLabels( connections[i] ), (uint64_t)connections[i]->irc.GetStats().disconnects );
+	}
+
+	metrics.type( "angel_irc_sent_messages_total", "counter", "Messages the bot sent to the network." );
+	for ( size_t i = 0; i < connections.size(); i++ ) {
+		metrics.value( "angel_irc_sent_messages_total", connectionLabels( connections[i] ), (uint64_t)connections[i]->irc.GetStats().messagesSent );
+	}
+
+	metrics.type( "angel_irc_sent_bytes_total", "counter", "Bytes sent to the network." );
+	for ( size_t i = 0; i < connections.size(); i++ ) {
+		metrics.value( "angel_irc_sent_bytes_total", connectionLabels( connections[i] ), connections[i]->irc.GetStats().bytesSent );
+	}
+
+	metrics.type( "angel_irc_received_bytes_total", "counter", "Bytes received from the network." );
+	for ( size_t i = 0; i < connections.size(); i++ ) {
+		metrics.value( "angel_irc_received_bytes_total", connectionLabels( connections[i] ), connections[i]->irc.GetStats().bytesReceived );
+	}
+
+	metrics.type( "angel_irc_send_queue_bytes", "gauge", "Bytes sent that the network hasn't received yet." );
+	for ( size_t i = 0; i < connections.size(); i++ ) {
+		int bytes = connections[i]->irc.GetSendQueueBytes();
+
+		if ( bytes >= 0 ) {
+			metrics.value( "angel_irc_send_queue_bytes", connectionLabels( connections[i] ), (uint64_t)bytes );
+		}
+	}
+
+	metrics.type( "angel_log_dropped_total", "counter", "Log lines dropped because the log writer fell behind." );
+	metrics.value( "angel_log_dropped_total", String(), Log::GetDropped() );
+}
+
+// disconnect and print stats before exiting
+void ircQuit() {
+	for ( size_t i = 0; i < connections.size(); i++ ) {
+		connections[i]->irc.Disconnect( "Bye" );
+	}
+
+	for ( int i = 0; i < (int)bots.size(); i++ ) {
+		const InboxStats &stats = bots[i]->getInboxStats();
+		if ( stats.dropped ) {
+			Log::Printf( LOG_INFO, "irc", "%s dropped %u of %u messages (%u replaced by newer messages from the same person).",
+					bots[i]->getNick().c_str(), stats.dropped, stats.received, stats.coalesced );
+		}
+
+		const ThinkStats &thinkStats = bots[i]->getThinkStats();
+		if ( thinkStats.processed ) {
+			Log::Printf( LOG_INFO, "irc", "%s processed %u messages, %.2f seconds after they were said on average (%.2f max), ran out of time %u times.",
+					bots[i]->getNick().c_str(), thinkStats.processed, thinkStats.averageLatency(), thinkStats.maxLatency, thinkStats.deferred );
+		}
+	}
+
+	store.close();
+	inputLog.close();
+
+	// write out queued log lines
+	Log::Stop();
+
 	exit( 1 );
 }
 
+// quit from the main loop, so the log isn't used while a signal interrupted it
+volatile sig_atomic_t quitRequested = 0;
+
+void sighandler( int signum ) {
+	quitRequested = 1;
+}
+
+#ifndef _WIN32
+volatile sig_atomic_t reloadData = 0;
+
+void reloadhandler( int signum ) {
+	reloadData = 1;
+}
+#endif
+
+// channels is a comma separated list
+void addNetwork( const char *name, const char *server, const char *port, const char *channels ) {
+	IrcNetwork network;
+
+	network.name = name;
+	network.server = server;
+	network.port = port;
+	Config::SplitList( channels, network.channels );
+
+	networks.push_back( network );
+}
+
+bool sameNetwork( const IrcNetwork &a, const IrcNetwork &b ) {
+	if ( a.server.compareTo( b.server ) || a.port.compareTo( b.port ) || a.channels.size() != b.channels.size() ) {
+		return false;
+	}
+
+	for ( size_t c = 0; c < a.channels.size(); c++ ) {
+		if ( !( a.channels[c] == b.channels[c] ) ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+	Read the config file. At start up bots and networks are created from it,
+	after that only the [irc] settings and the bots' weight and inbox are
+	changed. Nothing is changed if there are any errors.
+*/
+bool loadConfig( const char *filename, bool startup, std::vector<BotSettings> &newBots ) {
+	static const char *ircKeys[] = { "ident", "connect_delay", "backoff_min", "backoff_max", "think_seconds", "max_conversations", "metrics_port", "log_level", "log_format", NULL };
+	static const char *botKeys[] = { "fullname", "gender", "weight", "inbox_size", "inbox_policy", NULL };
+	static const char *networkKeys[] = { "server", "port", "channels", NULL };
+
+	Config config;
+	IrcSettings newSettings = settings;
+	std::vector<IrcNetwork> newNetworks;
+	bool okay = config.parseFile( filename );
+
+	newBots.clear();
+
+	for ( size_t i = 0; i < config.getNumSections(); i++ ) {
+		const ConfigSection &section = config.getSection( i );
+
+		if ( section.type == "irc" ) {
+			okay &= section.checkKeys( ircKeys );
+			okay &= section.getString( "ident", newSettings.ident );
+			okay &= section.getFloat( "connect_delay", newSettings.connectDelay, 0, 3600 );
+			okay &= section.getFloat( "backoff_min", newSettings.backoffMin, 0, 3600 );
+			okay &= section.getFloat( "backoff_max", newSettings.backoffMax, 0, 86400 );
+			okay &= section.getFloat( "think_seconds", newSettings.thinkSeconds, 0.001f, 10 );
+			okay &= section.getInt( "max_conversations", newSettings.maxConversations, 1, 100000 );
+			okay &= section.getInt( "metrics_port", newSettings.metricsPort, 0, 65535 );
+			okay &= section.getChoice( "log_level", newSettings.logLevel, LogLevelNames );
+			okay &= section.getChoice( "log_format", newSettings.logFormat, LogFormatNames );
+		} else if ( section.type == "bot" ) {
+			BotSettings bot;
+
+			bot.name = section.label;
+			bot.fullName = section.label;
+
+			okay &= section.checkKeys( botKeys );
+			okay &= section.getString( "fullname", bot.fullName );
+			okay &= section.getChoice( "gender", bot.gender, GenderNames );
+			okay &= section.getInt( "weight", bot.weight, 1, 100 );
+			okay &= section.getInt( "inbox_size", bot.inboxSize, 1, 100000 );
+			okay &= section.getChoice( "inbox_policy", bot.inboxPolicy, InboxPolicyNames );
+
+			if ( bot.name.isEmpty() ) {
+				Log::Printf( LOG_WARNING, "config", "WARNING: %s:%d: bot needs a nick, [bot Name]", filename, section.lineNum );
+				okay = false;
+			}
+
+			for ( size_t b = 0; b < newBots.size(); b++ ) {
+				if ( newBots[b].name == bot.name ) {
+					Log::Printf( LOG_WARNING, "config", "WARNING: %s:%d: there is already a [bot %s]", filename, section.lineNum, bot.name.c_str() );
+					okay = false;
+					break;
+				}
+			}
+
+			newBots.push_back( bot );
+		} else if ( section.type == "network" ) {
+			IrcNetwork network;
+
+			network.name = section.label;
+			network.port = IRC_PORT;
+
+			okay &= section.checkKeys( networkKeys );
+			okay &= section.getString( "server", network.server );
+			okay &= section.getString( "port", network.port );
+			okay &= section.getList( "channels", network.channels );
+
+			if ( network.name.isEmpty() || network.server.isEmpty() ) {
+				Log::Printf( LOG_WARNING, "config", "WARNING: %s:%d: network needs a name and server, [network name]", filename, section.lineNum );
+				okay = false;
+			}
+
+			for ( size_t n = 0; n < newNetworks.size(); n++ ) {
+				if ( newNetworks[n].name == network.name ) {
+					Log::Printf( LOG_WARNING, "config", "WARNING: %s:%d: there is already a [network %s]", filename, section.lineNum, network.name.c_str() );
+					okay = false;
+					break;
+				}
+			}
+
+			newNetworks.push_back( network );
+		} else if ( section.type == "cli" ) {
+			// shared config file, used by the CLI program
+		} else {
+			Log::Printf( LOG_WARNING, "config", "WARNING: %s:%d: unknown section [%s]", filename, section.lineNum, section.type.c_str() );
+			okay = false;
+		}
+	}
+
+	if ( newSettings.backoffMin > newSettings.backoffMax ) {
+		Log::Printf( LOG_WARNING, "config", "WARNING: %s: backoff_min is more than backoff_max", filename );
+		okay = false;
+	}
+
+	if ( !okay ) {
+		Log::Printf( LOG_WARNING, "config", "WARNING: Not using %s because of errors.", filename );
+		return false;
+	}
+
+	settings = newSettings;
+
+	Log::SetLevel( (LogLevel)settings.logLevel );
+	Log::SetFormat( (LogFormat)settings.logFormat );
+
+	connector.serverDelay = settings.connectDelay;
+	connector.backoffMin = settings.backoffMin;
+	connector.backoffMax = settings.backoffMax;
+
+	if ( settings.metricsPort != metricsServer.GetPort() ) {
+		if ( settings.metricsPort ) {
+			metricsServer.Listen( settings.metricsPort );
+		} else {
+			metricsServer.Close();
+		}
+	}
+
+	if ( startup ) {
+		networks = newNetworks;
+		numConfigNetworks = newNetworks.size();
+		return true;
+	}
+
+	for ( size_t i = 0; i < newNetworks.size(); i++ ) {
+		size_t n;
+
+		for ( n = 0; n < numConfigNetworks; n++ ) {
+			if ( networks[n].name == newNetworks[i].name ) {
+				if ( !sameNetwork( networks[n], newNetworks[i] ) ) {
+					Log::Printf( LOG_WARNING, "config", "WARNING: Restart to change network %s.", newNetworks[i].name.c_str() );
+				}
+				break;
+			}
+		}
+
+		if ( n == numConfigNetworks ) {
+			Log::Printf( LOG_WARNING, "config", "WARNING: Restart to add network %s.", newNetworks[i].name.c_str() );
+		}
+	}
+
+	for ( size_t n = 0; n < numConfigNetworks; n++ ) {
+		size_t i;
+
+		for ( i = 0; i < newNetworks.size(); i++ ) {
+			if ( networks[n].name == newNetworks[i].name ) {
+				break;
+			}
+		}
+
+		if ( i == newNetworks.size() ) {
+			Log::Printf( LOG_WARNING, "config", "WARNING: Restart to remove network %s.", networks[n].name.c_str() );
+		}
+	}
+
+	for ( size_t i = 0; i < newBots.size(); i++ ) {
+		size_t b;
+
+		for ( b = 0; b < botNames.size(); b++ ) {
+			if ( botNames[b] == newBots[i].name ) {
+				scheduler.setWeight( bots[b], newBots[i].weight );
+				bots[b]->setInbox( newBots[i].inboxSize, (InboxPolicy)newBots[i].inboxPolicy );
+				break;
+			}
+		}
+
+		if ( b == botNames.size() ) {
+			Log::Printf( LOG_WARNING, "config", "WARNING: Restart to add bot %s.", newBots[i].name.c_str() );
+		}
+	}
+
+	return true;
+}
+
+int findNetwork( const String &name ) {
+	for ( size_t n = 0; n < networks.size(); n++ ) {
+		if ( networks[n].name == name ) {
+			return (int)n;
+		}
+	}
+
+	return -1;
+}
+
+int findBot( const String &name ) {
+	for ( size_t b = 0; b < botNames.size(); b++ ) {
+		if ( botNames[b] == name ) {
+			return (int)b;
+		}
+	}
+
+	return -1;
+}
+
+// Repeat a log from --log without connecting. With the same seed, data, and
+// config the bots process the same messages in the same turns, so they give
+// the same replies.
+bool replayLog( const char *filename ) {
+	ReplayLog in;
+	String event, fields;
+
+	if ( !in.open( filename, false ) ) {
+		Log::Printf( LOG_WARNING, "irc", "WARNING: Failed to open %s", filename );
+		return false;
+	}
+
+	replaying = true;
+
+	while ( in.read( event, fields ) ) {
+		const char *p = fields.c_str();
+
+		if ( event == "say" ) {
+			int network = findNetwork( ReplayLog::NextField( p ) );
+			int bot = findBot( ReplayLog::NextField( p ) );
+			String channel = ReplayLog::NextField( p );
+			String from = ReplayLog::NextField( p );
+
+			if ( network == -1 || bot == -1 ) {
+				Log::Printf( LOG_WARNING, "irc", "WARNING: %s:%u: unknown network or bot", filename, in.getLineNum() );
+				continue;
+			}
+
+			addUserMessage( network, bot, channel.compareTo( "-" ) ? channel.c_str() : NULL, from.c_str(), bots[bot]->getNick().c_str(), p );
+		} else if ( event == "nick" ) {
+			int network = findNetwork( ReplayLog::NextField( p ) );
+			String oldnick = ReplayLog::NextField( p );
+			String newnick = ReplayLog::NextField( p );
+
+			if ( network != -1 ) {
+				renameUser( network, oldnick.c_str(), newnick.c_str() );
+			}
+		} else if ( event == "botnick" ) {
+			int bot = findBot( ReplayLog::NextField( p ) );
+
+			if ( bot != -1 ) {
+				bots[bot]->updateNick( p );
+			}
+		} else if ( event == "rename" ) {
+			// checked by ANGELC_PersonaRename when replaying the next think event
+			replayRenames.push_back( fields );
+		} else if ( event == "think" ) {
+			if ( !ReplayLog::ReplayThink( scheduler, fields ) ) {
+				Log::Printf( LOG_WARNING, "irc", "WARNING: %s:%u: bad think event", filename, in.getLineNum() );
+			}
+			replayRenames.clear();
+		} else if ( event == "reload" ) {
+			Log::Printf( LOG_WARNING, "irc", "WARNING: %s:%u: the data or config was reloaded, replies after this may be different", filename, in.getLineNum() );
+		} else {
+			Log::Printf( LOG_WARNING, "irc", "WARNING: %s:%u: unknown event %s", filename, in.getLineNum(), event.c_str() );
+		}
+	}
+
+	replaying = false;
+	return true;
+}
+
 int main( int argc, char **argv )
 {
-	printf(ANGEL_IRC_VERSION "\n");
-	printf("Use ctrl-C to exit.\n");
+	const char *dataFile = NULL;
+	const char *stateFile = NULL;
+	const char *configFile = NULL;
+	const char *logFile = NULL;
+	const char *replayFile = NULL;
+	bool twoBots = false;
+	uint64_t seed = (uint64_t)time( NULL );
+
+	for ( int i = 1; i < argc; i++ ) {
+		if ( !strcmp( argv[i], "--two" ) ) {
+			twoBots = true;
+		} else if ( !strcmp( argv[i], "--data" ) && i + 1 < argc ) {
+			dataFile = argv[++i];
+		} else if ( !strcmp( argv[i], "--state" ) && i + 1 < argc ) {
+			stateFile = argv[++i];
+		} else if ( !strcmp( argv[i], "--seed" ) && i + 1 < argc ) {
+			seed = strtoull( argv[++i], NULL, 10 );
+		} else if ( !strcmp( argv[i], "--config" ) && i + 1 < argc ) {
+			configFile = argv[++i];
+		} else if ( !strcmp( argv[i], "--log" ) && i + 1 < argc ) {
+			logFile = argv[++i];
+		} else if ( !strcmp( argv[i], "--replay" ) && i + 1 < argc ) {
+			replayFile = argv[++i];
+		} else if ( !strcmp( argv[i], "--network" ) && i + 4 < argc ) {
+			addNetwork( argv[i+1], argv[i+2], argv[i+3], argv[i+4] );
+			i += 4;
+		}
+	}
+
+	std::vector<BotSettings> botSettings;
+
+	if ( configFile ) {
+		// networks from the command line are added to the ones in the config
+		std::vector<IrcNetwork> argNetworks = networks;
+
+		if ( !loadConfig( configFile, true, botSettings ) ) {
+			return 1;
+		}
+
+		networks.insert( networks.end(), argNetworks.begin(), argNetworks.end() );
+	}
+
+	if ( networks.empty() ) {
+		addNetwork( IRC_NETWORK, IRC_SERVER, IRC_PORT, IRC_CHANNEL );
+	}
+
+	for ( size_t n = 1; n < networks.size(); n++ ) {
+		for ( size_t i = 0; i < n; i++ ) {
+			if ( networks[i].name == networks[n].name ) {
+				Log::Printf( LOG_WARNING, "config", "WARNING: There is more than one network named %s.", networks[n].name.c_str() );
+				return 1;
+			}
+		}
+	}
+
+	if ( botSettings.empty() ) {
+		BotSettings bot;
+
+		bot.name = "Angel";
+		bot.fullName = "Angelica Anarchy";
+		bot.gender = GENDER_FEMALE;
+		botSettings.push_back( bot );
+
+		if ( twoBots ) {
+			bot.name = "Sera";
+			bot.fullName = "Seraph Anarchy";
+			botSettings.push_back( bot );
+		}
+	}
+
+	// printing to a slow terminal or pipe shouldn't hold up the bots
+	Log::Start();
+
+	Log::Write( LOG_INFO, "irc", ANGEL_IRC_VERSION );
+	Log::Write( LOG_INFO, "irc", "Use ctrl-C to exit." );
+	Log::Printf( LOG_INFO, "irc", "Random seed: %llu", (unsigned long long)seed );
+
+	if ( dataFile && !WordData::Load( dataFile ) ) {
+		Log::Stop();
+		return 1;
+	}
 
 	signal(SIGINT, sighandler);
 	signal(SIGTERM, sighandler);
+#ifndef _WIN32
+	signal(SIGHUP, reloadhandler);
+
+	// a server or metrics scraper closing its socket makes send() fail instead of killing the bot
+	signal(SIGPIPE, SIG_IGN);
+#endif
 
-	user.updateNick( "User" );
-	user.setGender( GENDER_MALE );
-	user.setAutoChat( false );
+	for ( size_t i = 0; i < botSettings.size(); i++ ) {
+		Persona *bot = new Persona;
 
-	bots[numBots].updateNick( "Angel" );
-	bots[numBots].setFullName( "Angelica Anarchy" );
-	bots[numBots].setGender( GENDER_FEMALE );
-	numBots++;
+		bot->updateNick( botSettings[i].name );
+		bot->setFullName( botSettings[i].fullName );
+		bot->setGender( (Gender)botSettings[i].gender );
+		bot->setInbox( botSettings[i].inboxSize, (InboxPolicy)botSettings[i].inboxPolicy );
+		bots.push_back( bot );
+		botNames.push_back( botSettings[i].name );
+	}
 
-	if ( argc >= 2 && !strcmp( argv[1], "--two" ) ) {
-		bots[numBots].updateNick( "Sera" );
-		bots[numBots].setFullName( "Seraph Anarchy" );
-		bots[numBots].setGender( GENDER_FEMALE );
-		numBots++;
-	} else {
+	Persona *dummy = NULL;
+
+	if ( bots.size() == 1 ) {
 		// HACK always add extra persona so bot knows channel is "group chat" mode...
-		bots[numBots].updateNick( "Dummy" );
-		bots[numBots].setAutoChat( false );
-		conlist[0].con.addPersona( &bots[numBots] );
+		dummy = new Persona;
+		dummy->updateNick( "Dummy" );
+		dummy->setAutoChat( false );
+	}
+
+	if ( stateFile ) {
+		store.open( stateFile );
 	}
 
-	for ( int i = 0; i < numBots; i++ ) {
-		conlist[0].con.addPersona( &bots[i] );
+	for ( int i = 0; i < (int)bots.size(); i++ ) {
+		bots[i]->setRandomSeed( seed, i );
+
+		// saved using initial nick
+		store.attach( bots[i], botNames[i] );
+		scheduler.add( bots[i], botSettings[i].weight );
 	}
 
-	conlist[0].con.addPersona( &user );
-	conlist[0].name = IRC_CHANNEL;
-	numCons++;
+	for ( size_t n = 0; n < networks.size(); n++ ) {
+		for ( size_t c = 0; c < networks[n].channels.size(); c++ ) {
+			ConList *cl = addConversation( n, -1, networks[n].channels[c].c_str() );
 
-	bot_irc[0].Connect( IRC_SERVER, IRC_PORT, bots[0].getNick().c_str(), IRC_IDENT, bots[0].getFullName().c_str(), IRC_CHANNEL );
-	time_t connectTime = time( NULL );
+			if ( !cl ) {
+				Log::Printf( LOG_WARNING, "irc", "WARNING: Too many channels, not joining %s on %s.", networks[n].channels[c].c_str(), networks[n].name.c_str() );
+				networks[n].channels.resize( c );
+				break;
+			}
+
+			if ( dummy ) {
+				cl->con.addPersona( dummy );
+			}
+
+			for ( int i = 0; i < (int)bots.size(); i++ ) {
+				cl->con.addPersona( bots[i] );
+			}
+		}
+
+		for ( int i = 0; i < (int)bots.size(); i++ ) {
+			IrcConnection *connection = new IrcConnection;
+
+			connection->bot = i;
+			connection->network = n;
+			connection->connectId = connector.add( networks[n].server.c_str(), networks[n].port.c_str() );
+			connection->lastState = IRC_DISCONNECTED;
+			connection->irc.SetNetwork( networks[n].name.c_str() );
+
+			for ( size_t c = 0; c < networks[n].channels.size(); c++ ) {
+				connection->irc.AddChannel( networks[n].channels[c].c_str() );
+			}
+
+			connections.push_back( connection );
+		}
+	}
+
+	if ( replayFile ) {
+		bool replayed = replayLog( replayFile );
+
+		store.close();
+		Log::Stop();
+		return replayed ? 0 : 1;
+	}
+
+	if ( logFile && !inputLog.open( logFile, true ) ) {
+		Log::Printf( LOG_WARNING, "irc", "WARNING: Failed to open %s", logFile );
+		store.close();
+		Log::Stop();
+		return 1;
+	}
+
+	connector.setSeed( seed );
+
+	// connections to different servers start together, see ConnectScheduler
+	double startTime = Persona::ClockSeconds();
+	int lastReady = -1, lastConnecting = -1;
 
 	while (1)
 	{
-		for ( int i = 0; i < numBots; i++ ) {
-			bot_irc[i].Update();
-			bots[i].think();
+		if ( quitRequested ) {
+			ircQuit();
 		}
 
-		// sleep until bots wants to think or receive socket data.
-		float delay = -1, botDelay;
+#ifndef _WIN32
+		// reload word data and config on SIGHUP
+		if ( reloadData ) {
+			reloadData = 0;
+			if ( dataFile ) {
+				WordData::Load( dataFile );
+			}
+			if ( configFile ) {
+				loadConfig( configFile, false, botSettings );
+			}
+			inputLog.write( "reload" );
+		}
+#endif
 
-		for ( int i = 0; i < numBots; i++ ) {
-			if ( bot_irc[i].Connected() ) {
-				botDelay = bots[i].getSleepTime();
-			} else {
-				botDelay = ( connectTime + IRC_CONNECT_DELAY ) - time( NULL );
+		double now = Persona::ClockSeconds();
+
+		for ( size_t i = 0; i < connections.size(); i++ ) {
+			IrcConnection *connection = connections[i];
+
+			connection->irc.Update();
+
+			IrcState state = connection->irc.GetState();
+
+			if ( state != connection->lastState ) {
+				if ( state == IRC_READY ) {
+					connector.connectSucceeded( connection->connectId );
+				} else if ( state == IRC_DISCONNECTED ) {
+					connector.connectFailed( connection->connectId, now );
+				}
+				connection->lastState = state;
+			}
+		}
+
+		metricsServer.Update();
+
+		// a bot with a lot of messages finishes them over multiple loops
+		scheduler.think( settings.thinkSeconds );
+		inputLog.writeThink( scheduler );
+
+		// save state changes from this update
+		store.update();
 
-				if ( botDelay <= 0 ) {
-					bot_irc[i].Connect( IRC_SERVER, IRC_PORT, bots[i].getNick().c_str(), IRC_IDENT, bots[i].getFullName().c_str(), IRC_CHANNEL );
-					connectTime = time( NULL );
+		int ready = 0, connecting = 0;
+
+		for ( size_t i = 0; i < connections.size(); i++ ) {
+			IrcConnection *connection = connections[i];
+
+			if ( connection->irc.GetState() == IRC_DISCONNECTED && connector.startConnect( connection->connectId, now ) ) {
+				const IrcNetwork &network = networks[connection->network];
+				const Persona &bot = *bots[connection->bot];
+
+				if ( connection->irc.Connect( network.server.c_str(), network.port.c_str(), bot.getNick().c_str(), settings.ident.c_str(), bot.getFullName().c_str() ) ) {
+					connection->lastState = connection->irc.GetState();
+				} else {
+					connector.connectFailed( connection->connectId, now );
 				}
 			}
 
-			if ( delay < 0 || ( botDelay >= 0 && botDelay < delay ) ) {
-				delay = botDelay;
+			if ( connection->irc.Ready() ) {
+				ready++;
+			} else if ( connection->irc.GetState() != IRC_DISCONNECTED ) {
+				connecting++;
+			}
+		}
+
+		if ( ready != lastReady || connecting != lastConnecting ) {
+			int waiting = (int)connections.size() - ready - connecting;
+
+			Log::Printf( LOG_INFO, "irc", "Ready: %d of %d IRC connections (%d connecting, %d waiting to connect)", ready, (int)connections.size(), connecting, waiting );
+
+			if ( ready == (int)connections.size() ) {
+				Log::Printf( LOG_INFO, "irc", "All IRC connections ready after %.1f seconds.", now - startTime );
 			}
+
+			lastReady = ready;
+			lastConnecting = connecting;
+		}
+
+		// sleep until bots wants to think, a connection can start, or socket data is received.
+		float delay = scheduler.getSleepTime();
+		float connectDelay = connector.getSleepTime( now );
+
+		if ( connectDelay >= 0 && ( delay < 0 || connectDelay < delay ) ) {
+			delay = connectDelay;
 		}
 
 		// wake up to ping server if idle too long
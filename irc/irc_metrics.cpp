@@ -0,0 +1,286 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include <sys/types.h>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+#include <errno.h> // errno
+
+#include <cstring>
+
+#include "irc_metrics.h"
+
+#ifndef _WIN32
+#define closesocket(x) close(x)
+#endif
+
+using namespace AngelCommunication;
+
+static void SetNonBlocking( int sock ) {
+#ifdef _WIN32
+	u_long val = 1;
+	ioctlsocket( sock, FIONBIO, &val );
+#else
+	int flags = fcntl( sock, F_GETFL, 0 );
+	fcntl( sock, F_SETFL, flags | O_NONBLOCK );
+#endif
+}
+
+MetricsServer::MetricsServer()
+: listenSock( -1 ), port( 0 )
+{
+}
+
+MetricsServer::~MetricsServer() {
+	Close();
+}
+
+bool MetricsServer::Listen( int port ) {
+	struct sockaddr_in addr;
+	int yes = 1;
+
+	Close();
+
+	listenSock = socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+	if ( listenSock < 0 ) {
+		Log::Printf( LOG_WARNING, "metrics", "Metrics: socket() errored: %s (errno %d)", strerror( errno ), errno );
+		listenSock = -1;
+		return false;
+	}
+
+#ifndef _WIN32
+	// select() can't watch it
+	if ( listenSock >= FD_SETSIZE ) {
+		Log::Printf( LOG_WARNING, "metrics", "Metrics: socket %d is past select()'s limit of %d", listenSock, FD_SETSIZE );
+		closesocket( listenSock );
+		listenSock = -1;
+		return false;
+	}
+#endif
+
+	setsockopt( listenSock, SOL_SOCKET, SO_REUSEADDR, (const char *)&yes, sizeof ( yes ) );
+
+	memset( &addr, 0, sizeof ( addr ) );
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons( port );
+	addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+	if ( bind( listenSock, (struct sockaddr *)&addr, sizeof ( addr ) ) != 0 || listen( listenSock, MAX_CLIENTS ) != 0 ) {
+		Log::Printf( LOG_WARNING, "metrics", "Metrics: can't listen on 127.0.0.1:%d: %s (errno %d)", port, strerror( errno ), errno );
+		closesocket( listenSock );
+		listenSock = -1;
+		return false;
+	}
+
+	SetNonBlocking( listenSock );
+
+	this->port = port;
+	Log::Printf( LOG_INFO, "metrics", "Metrics: serving http://127.0.0.1:%d/metrics", port );
+
+	return true;
+}
+
+void MetricsServer::Close() {
+	for ( size_t i = 0; i < clients.size(); i++ ) {
+		closesocket( clients[i].sock );
+	}
+	clients.clear();
+
+	if ( listenSock >= 0 ) {
+		closesocket( listenSock );
+		listenSock = -1;
+	}
+
+	port = 0;
+}
+
+void MetricsServer::Accept() {
+	while ( 1 ) {
+		int sock = accept( listenSock, NULL, NULL );
+
+		if ( sock < 0 ) {
+			return; // nothing waiting
+		}
+
+		if ( (int)clients.size() >= MAX_CLIENTS ) {
+			closesocket( sock );
+			continue;
+		}
+
+#ifndef _WIN32
+		// select() can't watch it
+		if ( sock >= FD_SETSIZE ) {
+			closesocket( sock );
+			continue;
+		}
+#endif
+
+		SetNonBlocking( sock );
+
+		Client client;
+
+		client.sock = sock;
+		client.sent = 0;
+		client.openTime = std::time( NULL );
+
+		clients.push_back( client );
+	}
+}
+
+bool MetricsServer::Read( Client &client ) {
+	char buf[1024];
+	int len;
+
+	while ( ( len = recv( client.sock, buf, sizeof ( buf ) - 1, 0 ) ) > 0 ) {
+		buf[len] = 0;
+		client.request.append( buf );
+
+		if ( client.request.getLen() > MAX_REQUEST_BYTES ) {
+			return false;
+		}
+	}
+
+	if ( len == 0 ) {
+		return false; // closed before sending a whole request
+	}
+
+	if ( len < 0 && errno != EAGAIN && errno != EWOULDBLOCK ) {
+		return false; // errored, Ex: connection reset
+	}
+
+	// only the request line matters, headers are ignored
+	if ( strstr( client.request.c_str(), "\r\n\r\n" ) || strstr( client.request.c_str(), "\n\n" ) ) {
+		Respond( client );
+	}
+
+	return true;
+}
+
+void MetricsServer::Respond( Client &client ) {
+	const char *status = "200 OK";
+	String body;
+
+	if ( !strncmp( client.request.c_str(), "GET /metrics ", 13 ) ) {
+		MetricsWriter metrics;
+
+		ANGEL_IRC_WriteMetrics( metrics );
+		body = metrics.getText();
+	} else if ( !strncmp( client.request.c_str(), "GET ", 4 ) ) {
+		status = "404 Not Found";
+		body = "Not found, try /metrics\n";
+	} else {
+		status = "405 Method Not Allowed";
+		body = "Only GET is supported\n";
+	}
+
+	client.response.setValues( "HTTP/1.0 ", status, "\r\n"
+		"Content-Type: text/plain; version=0.0.4\r\n"
+		"Content-Length: ", body.getLen(), "\r\n"
+		"Connection: close\r\n"
+		"\r\n", body );
+}
+
+bool MetricsServer::Write( Client &client ) {
+	while ( client.sent < client.response.getLen() ) {
+		int len = send( client.sock, client.response.c_str() + client.sent, client.response.getLen() - client.sent, 0 );
+
+		if ( len <= 0 ) {
+			// try again when the socket is writable, unless it errored
+			return ( len < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) );
+		}
+
+		client.sent += len;
+	}
+
+	return false; // all sent
+}
+
+void MetricsServer::Update() {
+	if ( listenSock < 0 ) {
+		return;
+	}
+
+	Accept();
+
+	time_t now = std::time( NULL );
+
+	for ( size_t i = 0; i < clients.size(); ) {
+		Client &client = clients[i];
+		bool keep;
+
+		if ( client.response.isEmpty() ) {
+			keep = Read( client );
+		} else {
+			keep = true;
+		}
+
+		if ( keep && !client.response.isEmpty() ) {
+			keep = Write( client );
+		}
+
+		if ( keep && difftime( now, client.openTime ) >= CLIENT_TIMEOUT_SECONDS ) {
+			keep = false;
+		}
+
+		if ( !keep ) {
+			closesocket( client.sock );
+			clients.erase( clients.begin() + i );
+			continue;
+		}
+
+		i++;
+	}
+}
+
+// sockets are below FD_SETSIZE, others are closed by Listen() and Accept()
+void MetricsServer::AddSockets( fd_set *rfds, fd_set *wfds, int &highestSock ) const {
+	if ( listenSock < 0 ) {
+		return;
+	}
+
+	FD_SET( listenSock, rfds );
+	if ( listenSock+1 > highestSock ) {
+		highestSock = listenSock+1;
+	}
+
+	for ( size_t i = 0; i < clients.size(); i++ ) {
+		int sock = clients[i].sock;
+
+		FD_SET( sock, clients[i].response.isEmpty() ? rfds : wfds );
+		if ( sock+1 > highestSock ) {
+			highestSock = sock+1;
+		}
+	}
+}
+
+int MetricsServer::GetPort() const {
+	return port;
+}
@@ -0,0 +1,82 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef ANGEL_IRC_METRICS_INCLUDED
+#define ANGEL_IRC_METRICS_INCLUDED
+
+#include <ctime>
+#include <vector>
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/select.h>
+#endif
+
+#include "../framework/angel.h"
+
+// fill in the metrics for a scrape
+void ANGEL_IRC_WriteMetrics( AngelCommunication::MetricsWriter &metrics );
+
+/*
+	MetricsServer class
+	Serves "GET /metrics" in Prometheus text format on a loopback port. The
+	sockets are non-blocking and checked by the main loop, so a slow or
+	stuck scraper doesn't hold up the bots.
+*/
+class MetricsServer {
+	private:
+		class Client {
+			public:
+				int			sock;
+				AngelCommunication::String request;
+				AngelCommunication::String response;
+				unsigned int sent;	// bytes of response
+				time_t		openTime;
+		};
+
+		int listenSock;
+		int port;
+		std::vector<Client> clients;
+
+		void Accept();
+		bool Read( Client &client ); // false when done with client
+		bool Write( Client &client );
+		void Respond( Client &client );
+
+	public:
+		static const int CLIENT_TIMEOUT_SECONDS = 5;
+		static const unsigned int MAX_REQUEST_BYTES = 4096;
+		static const int MAX_CLIENTS = 8;
+
+		MetricsServer();
+		~MetricsServer();
+
+		bool Listen( int port ); // 127.0.0.1 only
+		void Close();
+		void Update();
+
+		// add sockets that need attention to select() sets
+		void AddSockets( fd_set *rfds, fd_set *wfds, int &highestSock ) const;
+		int GetPort() const;
+};
+
+#endif // ANGEL_IRC_METRICS_INCLUDED
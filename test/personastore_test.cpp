@@ -0,0 +1,263 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+/*
+	Checks that PersonaStore restores what was saved after reopening it: from
+	the log alone, with a record cut off or corrupted at the end of the log,
+	and from a snapshot followed by newer log records. Files are written to
+	the current directory.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "../framework/angel.h"
+
+using namespace AngelCommunication;
+
+#define STORE_PATH	"personastore_test"
+#define LOG_PATH	STORE_PATH ".log"
+#define SNAP_PATH	STORE_PATH ".snap"
+
+static int numChecks = 0;
+static int numFailed = 0;
+
+void ANGELC_PrintMessage( const AngelCommunication::Conversation *con, const AngelCommunication::Persona *speaker, const char *message ) {
+}
+
+void ANGELC_PersonaRename( const char *oldnick, const char *newnick ) {
+}
+
+static void Check( const char *test, bool okay, const char *what )
+{
+	numChecks++;
+
+	if ( okay ) {
+		return;
+	}
+
+	numFailed++;
+	printf( "FAILED: %s: %s\n", test, what );
+}
+
+static std::vector<char> ReadFile( const char *name )
+{
+	std::vector<char> data;
+	FILE *f = fopen( name, "rb" );
+	char buf[4096];
+	size_t len;
+
+	if ( !f ) {
+		return data;
+	}
+
+	while ( ( len = fread( buf, 1, sizeof ( buf ), f ) ) > 0 ) {
+		data.insert( data.end(), buf, buf + len );
+	}
+
+	fclose( f );
+	return data;
+}
+
+static void WriteFile( const char *name, const std::vector<char> &data )
+{
+	FILE *f = fopen( name, "wb" );
+
+	if ( !f ) {
+		return;
+	}
+
+	if ( !data.empty() ) {
+		fwrite( &data[0], 1, data.size(), f );
+	}
+
+	fclose( f );
+}
+
+/*
+	Restored
+	Open the store and attach a new persona to it. Returns false if the store
+	couldn't be opened. The persona must outlive the store, closing it clears
+	the persona's store pointer.
+*/
+static bool Restored( PersonaStore &store, Persona &persona )
+{
+	if ( !store.open( STORE_PATH ) ) {
+		return false;
+	}
+
+	store.attach( &persona, "Angel" );
+	return true;
+}
+
+// save a new full name, so the last record in the log is this one
+static void SaveFullName( const char *fullName )
+{
+	Persona persona;
+	PersonaStore store;
+
+	Restored( store, persona );
+	persona.setFullName( fullName );
+	store.close();
+}
+
+static void TestLog()
+{
+	Persona bot, user;
+	Conversation con;
+	PersonaStore store;
+
+	con.setName( "#test" );
+	user.updateNick( "Bob" );
+	con.addPersona( &bot );
+	con.addPersona( &user );
+
+	Check( "log", Restored( store, bot ), "open" );
+
+	bot.setFullName( "Angelica Anarchy" );
+	bot.setGender( GENDER_FEMALE );
+	store.update();
+
+	bot.addExpectation( &con, &user, WR_COMPLETE_LAST );
+	bot.addExpectation( &con, &user, WR_SPECIFIED, "yes" );
+	bot.addExpectation( &con, &user, WR_AM_I_RIGHT );
+	store.close();
+
+	Persona restored;
+	PersonaStore restoredStore;
+
+	Check( "log", Restored( restoredStore, restored ), "reopen" );
+	Check( "log", !restored.getFullName().compareTo( "Angelica Anarchy" ), "full name" );
+	Check( "log", restored.getNumExpectations() == 3, "expectations" );
+}
+
+static void TestTornRecord()
+{
+	std::vector<char> before, data;
+
+	before = ReadFile( LOG_PATH );
+	SaveFullName( "Torn" );
+
+	// cut off the middle of the last record, like a crash while writing it
+	data = ReadFile( LOG_PATH );
+	Check( "torn", data.size() > before.size() + 4, "record added" );
+	data.resize( data.size() - 4 );
+	WriteFile( LOG_PATH, data );
+
+	Persona persona;
+	PersonaStore store;
+
+	Check( "torn", Restored( store, persona ), "reopen" );
+	Check( "torn", !persona.getFullName().compareTo( "Angelica Anarchy" ), "full name from before the torn record" );
+	Check( "torn", persona.getNumExpectations() == 3, "expectations" );
+	store.close();
+
+	// the partial record is removed so new records follow the valid ones
+	Check( "torn", ReadFile( LOG_PATH ).size() == before.size(), "log truncated to valid records" );
+
+	SaveFullName( "After Torn" );
+
+	Persona after;
+	PersonaStore afterStore;
+
+	Restored( afterStore, after );
+	Check( "torn", !after.getFullName().compareTo( "After Torn" ), "record written after truncating" );
+}
+
+static void TestChecksum()
+{
+	std::vector<char> data;
+
+	SaveFullName( "Corrupt" );
+
+	// last bytes are the funReplies int in the last record's payload
+	data = ReadFile( LOG_PATH );
+	data[data.size() - 1] ^= 0x40;
+	WriteFile( LOG_PATH, data );
+
+	Persona persona;
+	PersonaStore store;
+
+	Check( "checksum", Restored( store, persona ), "reopen" );
+	Check( "checksum", !persona.getFullName().compareTo( "After Torn" ), "corrupted record ignored" );
+	Check( "checksum", persona.getNumExpectations() == 3, "expectations" );
+}
+
+static void TestSnapshot()
+{
+	{
+		Persona bot, user;
+		Conversation con;
+		PersonaStore store;
+		char fullName[32];
+
+		con.setName( "#test" );
+		user.updateNick( "Bob" );
+		con.addPersona( &bot );
+		con.addPersona( &user );
+
+		Restored( store, bot );
+
+		// records are over 50 bytes, enough that the writer thread replaces the log with a snapshot
+		for ( int i = 0; i < 10000; i++ ) {
+			snprintf( fullName, sizeof ( fullName ), "Snapshot %d", i );
+			bot.setFullName( fullName );
+			store.update();
+		}
+
+		bot.addExpectation( &con, &user, WR_LISTENING_TO_ME );
+		store.close();
+
+		Check( "snapshot", !ReadFile( SNAP_PATH ).empty(), "snapshot written" );
+		Check( "snapshot", ReadFile( LOG_PATH ).size() < PersonaStore::SNAPSHOT_LOG_SIZE, "log started over" );
+	}
+
+	// newer than the snapshot, only in the log
+	SaveFullName( "After Snapshot" );
+	Check( "snapshot", !ReadFile( LOG_PATH ).empty(), "log records after snapshot" );
+
+	Persona persona;
+	PersonaStore store;
+
+	Check( "snapshot", Restored( store, persona ), "reopen" );
+	Check( "snapshot", !persona.getFullName().compareTo( "After Snapshot" ), "full name from log" );
+	Check( "snapshot", persona.getNumExpectations() == 4, "expectations from snapshot and log" );
+}
+
+int main( int argc, char **argv )
+{
+	remove( LOG_PATH );
+	remove( SNAP_PATH );
+
+	TestLog();
+	TestTornRecord();
+	TestChecksum();
+	TestSnapshot();
+
+	remove( LOG_PATH );
+	remove( SNAP_PATH );
+
+	printf( "%d of %d PersonaStore checks failed\n", numFailed, numChecks );
+
+	return numFailed ? 1 : 0;
+}
@@ -0,0 +1,433 @@
+/*
+Angel Communication
+Copyright (C) 2013-2014 Zack Middleton <zturtleman@gmail.com>
+
+This software is provided 'as-is', without any express or implied
+warranty.  In no event will the authors be held liable for any damages
+arising from the use of this software.
+
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it
+freely, subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not
+   claim that you wrote the original software. If you use this software
+   in a product, an acknowledgment in the product documentation would be
+   appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be
+   misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+/*
+	Checks String's in place editing against a simple std::string version of
+	how it worked when it copied through subscript(), and replacing against
+	std::string. Every string up to MAX_LEN characters made of ' ', 'a', and
+	'b' is tried with every position. Formatting is checked against the C
+	library's snprintf. Case-insensitive compares are checked against
+	strncasecmp for every pair of bytes, and the cached hash used by
+	operator== is checked after each kind of edit.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <string>
+
+#include "../framework/string.h"
+
+using namespace AngelCommunication;
+
+#define MAX_LEN 7
+
+static const char testChars[] = { ' ', 'a', 'b' };
+#define NUM_TEST_CHARS ( sizeof ( testChars ) / sizeof ( testChars[0] ) )
+
+static int numChecks = 0;
+static int numFailed = 0;
+
+//
+// Reference versions
+//
+
+static std::string RefLtrim( std::string s )
+{
+	if ( s.size() < 2 )
+		return s;
+
+	size_t i = s.find_first_not_of( ' ' );
+
+	if ( i == std::string::npos )
+		return "";
+
+	return s.substr( i );
+}
+
+static std::string RefRtrim( std::string s )
+{
+	if ( s.size() < 2 )
+		return s;
+
+	size_t i = s.find_last_not_of( ' ' );
+
+	// NOTE: the subscript() version also removed the first character
+	//       when only it wasn't a space, "a " became "".
+	if ( i == std::string::npos )
+		return "";
+
+	return s.substr( 0, i + 1 );
+}
+
+static std::string RefInsert( std::string s, size_t where, char character )
+{
+	// inserting past the end pads with '\0's
+	if ( where > s.size() )
+		s.resize( where, '\0' );
+
+	s.insert( where, 1, character );
+	return s;
+}
+
+static std::string RefRemove( std::string s, size_t start, size_t len )
+{
+	if ( start >= s.size() || len == 0 )
+		return s;
+
+	return s.erase( start, len );
+}
+
+// finds are tried at each position, longest first
+static std::string RefReplace( const std::string &s, const char * const *finds, const char * const *news, int num )
+{
+	std::string out;
+
+	for ( size_t i = 0; i < s.size(); /* */ ) {
+		int match = -1;
+
+		for ( int n = 0; n < num; n++ ) {
+			size_t len = strlen( finds[n] );
+
+			if ( len && s.compare( i, len, finds[n] ) == 0 && ( match == -1 || len > strlen( finds[match] ) ) ) {
+				match = n;
+			}
+		}
+
+		if ( match == -1 ) {
+			out += s[i++];
+		} else {
+			out += news[match];
+			i += strlen( finds[match] );
+		}
+	}
+
+	return out;
+}
+
+//
+// Checking
+//
+
+static void Check( const char *op, const std::string &input, size_t a, size_t b, const String &result, const std::string &expected )
+{
+	numChecks++;
+
+	if ( result.getLen() == expected.size()
+		&& !memcmp( result.c_str(), expected.c_str(), expected.size() )
+		&& result.c_str()[result.getLen()] == '\0' ) {
+		return;
+	}
+
+	numFailed++;
+
+	if ( numFailed <= 20 ) {
+		printf( "FAILED: %s( \"%s\", %u, %u ) gave \"%s\" (%u) expected \"%s\" (%u)\n", op, input.c_str(), (unsigned)a, (unsigned)b,
+				result.c_str(), result.getLen(), expected.c_str(), (unsigned)expected.size() );
+	}
+}
+
+static void CheckTrue( const char *op, const std::string &input, size_t a, size_t b, bool okay )
+{
+	numChecks++;
+
+	if ( okay ) {
+		return;
+	}
+
+	numFailed++;
+
+	if ( numFailed <= 20 ) {
+		printf( "FAILED: %s( \"%s\", %u, %u )\n", op, input.c_str(), (unsigned)a, (unsigned)b );
+	}
+}
+
+static int Sign( int x )
+{
+	return ( x > 0 ) - ( x < 0 );
+}
+
+static void TestString( const std::string &input )
+{
+	String s;
+
+	s = input.c_str();
+	s.ltrim();
+	Check( "ltrim", input, 0, 0, s, RefLtrim( input ) );
+
+	s = input.c_str();
+	s.rtrim();
+	Check( "rtrim", input, 0, 0, s, RefRtrim( input ) );
+
+	s = input.c_str();
+	s.trim();
+	Check( "trim", input, 0, 0, s, RefLtrim( RefRtrim( input ) ) );
+
+	for ( size_t where = 0; where <= input.size() + 2; where++ ) {
+		for ( size_t c = 0; c < NUM_TEST_CHARS; c++ ) {
+			s = input.c_str();
+			s.insert( where, testChars[c] );
+			Check( "insert", input, where, testChars[c], s, RefInsert( input, where, testChars[c] ) );
+		}
+	}
+
+	for ( size_t start = 0; start <= input.size() + 1; start++ ) {
+		for ( size_t len = 0; len <= input.size() + 1; len++ ) {
+			s = input.c_str();
+			s.remove( start, len );
+			Check( "remove", input, start, len, s, RefRemove( input, start, len ) );
+		}
+	}
+
+	static const char *finds[] = { "a", "ab", "aa", " ", "b a", "" };
+	static const char *news[] = { "", "x", "yyy" };
+
+	for ( size_t f = 0; f < sizeof ( finds ) / sizeof ( finds[0] ); f++ ) {
+		for ( size_t n = 0; n < sizeof ( news ) / sizeof ( news[0] ); n++ ) {
+			s = input.c_str();
+			Check( "replaceString", input, f, n, s.replaceString( finds[f], news[n] ), RefReplace( input, &finds[f], &news[n], 1 ) );
+		}
+	}
+
+	static const char *multiFinds[] = { "a", "ab", " b" };
+	static const char *multiNews[] = { "1", "22", "" };
+
+	s = input.c_str();
+	Check( "replaceStrings", input, 0, 0, s.replaceStrings( multiFinds, multiNews, 3 ), RefReplace( input, multiFinds, multiNews, 3 ) );
+
+	// edits after shrinking in place still work
+	s = input.c_str();
+	s.trim();
+	s.append( "x" );
+	Check( "trim+append", input, 0, 0, s, RefLtrim( RefRtrim( input ) ) + "x" );
+}
+
+// lengths around the stack buffer used for short results
+static void TestFormat( void )
+{
+	static const size_t lengths[] = { 0, 1, 10, 254, 255, 256, 257, 600 };
+	static const size_t sizes[] = { 0, 1, 2, 11, 255, 256, 257, 258, 1024 };
+	char ref[2048];
+	String s;
+
+	for ( size_t l = 0; l < sizeof ( lengths ) / sizeof ( lengths[0] ); l++ ) {
+		std::string text( lengths[l], 'a' );
+
+		for ( size_t n = 0; n < sizeof ( sizes ) / sizeof ( sizes[0] ); n++ ) {
+			int refLen = ::snprintf( ref, sizes[n], "<%s>", text.c_str() );
+			std::string expected( ref, sizes[n] ? strlen( ref ) : 0 );
+
+			s = "old";
+			int len = s.snprintf( sizes[n], "<%s>", text.c_str() );
+			Check( "snprintf", text, sizes[n], len, s, expected );
+			Check( "snprintf return", text, sizes[n], len, String( len == refLen ? "" : "x" ), "" );
+
+			s = "old";
+			s.append_snprintf( sizes[n], "<%s>", text.c_str() );
+			Check( "append_snprintf", text, sizes[n], 0, s, "old" + expected );
+		}
+
+		// formatting the String into itself
+		s = text.c_str();
+		s.snprintf( 2048, "%s-%s", s.c_str(), s.c_str() );
+		Check( "snprintf self", text, 0, 0, s, text + "-" + text );
+
+		s = text.c_str();
+		s.append_snprintf( 2048, "%s", s.c_str() );
+		Check( "append_snprintf self", text, 0, 0, s, text + text );
+
+		s = text.c_str();
+		s.setValues( "[", s, "] ", 42, ' ', -7, ' ', 3000000000u, ' ', 1.5 );
+		Check( "setValues", text, 0, 0, s, "[" + text + "] 42 -7 3000000000 1.5" );
+
+		s = text.c_str();
+		s.appendValues( s, (const char *)NULL, 'x', (size_t)9 );
+		Check( "appendValues", text, 0, 0, s, text + text + "x9" );
+	}
+
+	s = "old";
+	s.setValues( "" );
+	Check( "setValues empty", "", 0, 0, s, "" );
+}
+
+// positions in and after the first 8 bytes, which are compared a word at a time
+static const size_t foldPositions[] = { 0, 5, 7, 8, 15, 18 };
+#define FOLD_LEN 19
+
+/*
+	TestFold
+	Put byte a and b at the same place in two strings and check the compare
+	functions give the same result as strncasecmp. Includes the bytes next
+	to the letters, like '@' and '`' and '[' and '{', and bytes with the high
+	bit set.
+*/
+static void TestFold( void )
+{
+	for ( size_t p = 0; p < sizeof ( foldPositions ) / sizeof ( foldPositions[0] ); p++ ) {
+		for ( int a = 1; a < 256; a++ ) {
+			for ( int b = 1; b < 256; b++ ) {
+				std::string textA( FOLD_LEN, 'q' ), textB( FOLD_LEN, 'Q' );
+
+				textA[foldPositions[p]] = (char)a;
+				textB[foldPositions[p]] = (char)b;
+
+				String sa( textA.c_str() ), sb( textB.c_str() );
+				int expected = Sign( strncasecmp( textA.c_str(), textB.c_str(), FOLD_LEN + 1 ) );
+
+				CheckTrue( "icompareTo", textA, a, b, Sign( sa.icompareTo( sb ) ) == expected );
+				CheckTrue( "FoldCompare", textA, a, b, Sign( String::FoldCompare( textA.c_str(), textB.c_str() ) ) == expected );
+				CheckTrue( "operator==", textA, a, b, ( sa == sb ) == ( expected == 0 ) );
+				CheckTrue( "operator== char", textA, a, b, ( sa == textB.c_str() ) == ( expected == 0 ) );
+
+				// same length, so only the hashes can tell them apart without comparing
+				CheckTrue( "FoldHash", textA, a, b, expected != 0 || sa.getFoldHash() == sb.getFoldHash() );
+				CheckTrue( "operator== hashed", textA, a, b, ( sa == sb ) == ( expected == 0 ) );
+			}
+		}
+	}
+
+	// compares stop at the end of the shorter string
+	static const char *prefixes[] = { "", "A", "abcdefg", "ABCDEFGH", "abcdefghi", "ABCDEFGHIJKLMNOP" };
+	const char *full = "abcdefghijklmnopq";
+
+	for ( size_t i = 0; i < sizeof ( prefixes ) / sizeof ( prefixes[0] ); i++ ) {
+		String prefix( prefixes[i] ), s( full );
+		int expected = Sign( strncasecmp( prefixes[i], full, strlen( full ) + 1 ) );
+
+		CheckTrue( "icompareTo prefix", prefixes[i], i, 0, Sign( prefix.icompareTo( s ) ) == expected );
+		CheckTrue( "icompareTo prefix", prefixes[i], i, 1, Sign( s.icompareTo( prefix ) ) == -expected );
+		CheckTrue( "icompareTo len", prefixes[i], i, 2, prefix.icompareTo( s, strlen( prefixes[i] ) ) == 0 );
+		CheckTrue( "operator== prefix", prefixes[i], i, 0, !( prefix == s ) && !( s == prefixes[i] ) );
+	}
+}
+
+/*
+	CheckHashed
+	The cached hash of s must be for its current text, or it isn't equal to
+	an unchanged String with the same text.
+*/
+static void CheckHashed( const char *op, const String &s, const char *expected )
+{
+	String same( expected );
+
+	same.getFoldHash();
+
+	CheckTrue( op, s.c_str(), 0, 0, s.getFoldHash() == String::FoldHash( expected ) );
+	CheckTrue( op, s.c_str(), 0, 1, s == same && same == s );
+}
+
+// each edit is made after the hash is cached
+static void TestFoldHash( void )
+{
+	String s, copy;
+	char *buffer;
+
+	s = "abcd"; s.getFoldHash(); s = "abce";
+	CheckHashed( "operator=", s, "abce" );
+
+	s = "abcd"; s.getFoldHash(); s.setData( "abce" );
+	CheckHashed( "setData", s, "abce" );
+
+	s = "abcd"; s.getFoldHash(); s[3] = 'e';
+	CheckHashed( "operator[]", s, "abce" );
+
+	s = "abcd"; s.getFoldHash(); s.charAtIndex( 0 ) = 'x';
+	CheckHashed( "charAtIndex", s, "xbcd" );
+
+	s = "abcd"; s.getFoldHash(); buffer = s.getBuffer( 4 ); buffer[3] = 'e';
+	CheckHashed( "getBuffer", s, "abce" );
+
+	s = "abcd"; s.getFoldHash(); s.setLen( 3 );
+	CheckHashed( "setLen", s, "abc" );
+
+	s = "abc"; s.getFoldHash(); s.append( 'd' );
+	CheckHashed( "append char", s, "abcd" );
+
+	s = "abc"; s.getFoldHash(); s.append( "de" );
+	CheckHashed( "append", s, "abcde" );
+
+	s = "abc"; s.getFoldHash(); s.append( String( "de" ) );
+	CheckHashed( "append String", s, "abcde" );
+
+	s = "abcd"; s.getFoldHash(); s.insert( 1, 'x' );
+	CheckHashed( "insert", s, "axbcd" );
+
+	s = "abcd"; s.getFoldHash(); s.remove( 1, 2 );
+	CheckHashed( "remove", s, "ad" );
+
+	s = " abc "; s.getFoldHash(); s.trim();
+	CheckHashed( "trim", s, "abc" );
+
+	s = "abcd"; s.getFoldHash(); s.snprintf( 16, "%s%d", "ab", 12 );
+	CheckHashed( "snprintf", s, "ab12" );
+
+	s = "ab"; s.getFoldHash(); s.append_snprintf( 16, "%d", 12 );
+	CheckHashed( "append_snprintf", s, "ab12" );
+
+	s = "abcd"; s.getFoldHash(); s.setValues( "ab", 12 );
+	CheckHashed( "setValues", s, "ab12" );
+
+	s = "ab"; s.getFoldHash(); s.appendValues( 12 );
+	CheckHashed( "appendValues", s, "ab12" );
+
+	s = "abcd"; s.getFoldHash(); copy = s; copy[0] = 'x';
+	CheckHashed( "copy", copy, "xbcd" );
+	CheckHashed( "copy", s, "abcd" );
+
+	// equal ignoring case, so the hashes must match
+	s = "Hello World"; copy = "hELLO wORLD";
+	s.getFoldHash(); copy.getFoldHash();
+	CheckTrue( "hashed case", s.c_str(), 0, 0, s == copy );
+
+	// same length, different text
+	copy = "Hello Worle";
+	copy.getFoldHash();
+	CheckTrue( "hashed different", s.c_str(), 0, 0, !( s == copy ) && !( copy == s ) );
+}
+
+static void TestAll( std::string &input, size_t maxLen )
+{
+	TestString( input );
+
+	if ( input.size() == maxLen )
+		return;
+
+	for ( size_t c = 0; c < NUM_TEST_CHARS; c++ ) {
+		input.push_back( testChars[c] );
+		TestAll( input, maxLen );
+		input.erase( input.size() - 1 );
+	}
+}
+
+int main( int argc, char **argv )
+{
+	std::string input;
+
+	TestAll( input, MAX_LEN );
+	TestFormat();
+	TestFold();
+	TestFoldHash();
+
+	printf( "%d of %d String checks failed\n", numFailed, numChecks );
+
+	return numFailed ? 1 : 0;
+}